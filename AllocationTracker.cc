@@ -0,0 +1,410 @@
+#include "AllocationTracker.h"
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(TRACK_ALLOCATIONS) && !defined(NDEBUG) && defined(__GLIBC__)
+#define TRACK_CALL_SITES
+#include <execinfo.h>
+#endif
+
+// Everything in here is reachable from operator new, possibly before main
+// and on any thread. State is constant initialized and nothing below
+// allocates through new.
+
+constexpr size_t kMaxScopes = 64;
+
+struct ScopeStats {
+  const char* name_ = nullptr;
+  std::atomic<uint64_t> allocations_ { 0 };
+  std::atomic<uint64_t> bytes_ { 0 };
+  std::atomic<uint64_t> violations_ { 0 };
+};
+
+struct ThreadState {
+  AllocationCounts counts_;
+  ScopeStats* scope_;
+  // Set while reporting a violation, so whatever the report allocates
+  // isn't reported again
+  bool reporting_;
+};
+
+static thread_local ThreadState Thread;
+
+static struct {
+  std::atomic<uint64_t> allocations_ { 0 };
+  std::atomic<uint64_t> frees_ { 0 };
+  std::atomic<uint64_t> bytes_ { 0 };
+  std::atomic<uint64_t> violations_ { 0 };
+  std::atomic<SteadyStateMode> mode_ { SteadyStateMode::kReport };
+  // Open steady-state scopes, across all threads
+  std::atomic<uint32_t> steady_depth_ { 0 };
+
+  ScopeStats scopes_[kMaxScopes];
+  std::atomic<size_t> scope_count_ { 0 };
+  std::mutex scope_mutex_;
+} Tracker;
+
+#if defined(TRACK_CALL_SITES)
+
+constexpr int32_t kCallSiteDepth = 6;
+constexpr size_t kMaxCallSites = 1024;
+
+// backtrace frames to drop, OnAllocate and operator new
+constexpr int32_t kSkippedFrames = 2;
+
+struct CallSite {
+  void* frames_[kCallSiteDepth];
+  int32_t depth_;
+  uint64_t allocations_;
+  uint64_t bytes_;
+};
+
+static struct {
+  CallSite sites_[kMaxCallSites] = {};
+  size_t count_ = 0;
+  uint64_t dropped_ = 0;
+  std::mutex mutex_;
+} CallSites;
+
+// Open addressed on a hash of the frames, full tables drop new sites
+static void RecordCallSite(void* const* frames, int32_t depth, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (int32_t i = 0; i < depth; ++i) {
+    hash = (hash ^ reinterpret_cast<uintptr_t>(frames[i])) * 1099511628211ull;
+  }
+
+  std::lock_guard<std::mutex> lock(CallSites.mutex_);
+  for (size_t probe = 0; probe < kMaxCallSites; ++probe) {
+    CallSite& site = CallSites.sites_[(hash + probe) % kMaxCallSites];
+    if (site.depth_ == 0) {
+      if (CallSites.count_ * 2 >= kMaxCallSites) {
+        break;
+      }
+      std::memcpy(site.frames_, frames, depth * sizeof(void*));
+      site.depth_ = depth;
+      ++CallSites.count_;
+    } else if (site.depth_ != depth || std::memcmp(site.frames_, frames, depth * sizeof(void*)) != 0) {
+      continue;
+    }
+    ++site.allocations_;
+    site.bytes_ += size;
+    return;
+  }
+  ++CallSites.dropped_;
+}
+
+#endif
+
+static ScopeStats* FindScope(const char* name) {
+  size_t count = Tracker.scope_count_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < count; ++i) {
+    if (std::strcmp(Tracker.scopes_[i].name_, name) == 0) {
+      return &Tracker.scopes_[i];
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(Tracker.scope_mutex_);
+  count = Tracker.scope_count_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < count; ++i) {
+    if (std::strcmp(Tracker.scopes_[i].name_, name) == 0) {
+      return &Tracker.scopes_[i];
+    }
+  }
+  if (count == kMaxScopes) {
+    return nullptr;
+  }
+
+  Tracker.scopes_[count].name_ = name;
+  Tracker.scope_count_.store(count + 1, std::memory_order_release);
+  return &Tracker.scopes_[count];
+}
+
+#if defined(TRACK_ALLOCATIONS)
+
+static void ReportViolation(size_t size, void* const* frames, int32_t depth) {
+  Thread.reporting_ = true;
+
+  const char* scope = Thread.scope_ ? Thread.scope_->name_ : "none";
+  std::cerr << "[allocations] " << size << " byte allocation in steady state, scope " << scope << std::endl;
+#if defined(TRACK_CALL_SITES)
+  backtrace_symbols_fd(frames, depth, 2);
+#endif
+
+  Thread.reporting_ = false;
+}
+
+#if defined(TRACK_CALL_SITES)
+__attribute__((noinline))
+#endif
+static void OnAllocate(size_t size) {
+  Thread.counts_.allocations_++;
+  Thread.counts_.bytes_ += size;
+  Tracker.allocations_.fetch_add(1, std::memory_order_relaxed);
+  Tracker.bytes_.fetch_add(size, std::memory_order_relaxed);
+
+  ScopeStats* scope = Thread.scope_;
+  if (scope != nullptr) {
+    scope->allocations_.fetch_add(1, std::memory_order_relaxed);
+    scope->bytes_.fetch_add(size, std::memory_order_relaxed);
+  }
+
+  void* const* frames = nullptr;
+  int32_t depth = 0;
+#if defined(TRACK_CALL_SITES)
+  void* trace[kCallSiteDepth + kSkippedFrames];
+  depth = backtrace(trace, kCallSiteDepth + kSkippedFrames) - kSkippedFrames;
+  frames = trace + kSkippedFrames;
+  if (depth > 0) {
+    RecordCallSite(frames, depth, size);
+  }
+#endif
+
+  if (Tracker.steady_depth_.load(std::memory_order_relaxed) == 0 || Thread.reporting_) {
+    return;
+  }
+
+  Tracker.violations_.fetch_add(1, std::memory_order_relaxed);
+  if (scope != nullptr) {
+    scope->violations_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  SteadyStateMode mode = Tracker.mode_.load(std::memory_order_relaxed);
+  if (mode != SteadyStateMode::kCount) {
+    ReportViolation(size, frames, depth);
+  }
+  if (mode == SteadyStateMode::kAbort) {
+    std::abort();
+  }
+}
+
+static void OnFree() {
+  Thread.counts_.frees_++;
+  Tracker.frees_.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void* AlignedAlloc(size_t size, size_t alignment) {
+#if defined(_WIN32)
+  return _aligned_malloc(size, alignment);
+#else
+  // aligned_alloc wants the size to be a multiple of the alignment
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void AlignedFree(void* pointer) {
+#if defined(_WIN32)
+  _aligned_free(pointer);
+#else
+  std::free(pointer);
+#endif
+}
+
+void* operator new(size_t size) {
+  OnAllocate(size);
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  OnAllocate(size);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  OnAllocate(size);
+  void* pointer = AlignedAlloc(size == 0 ? 1 : size, size_t(alignment));
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  OnAllocate(size);
+  return AlignedAlloc(size == 0 ? 1 : size, size_t(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept {
+  return operator new(size, alignment, tag);
+}
+
+void operator delete(void* pointer) noexcept {
+  if (pointer != nullptr) {
+    OnFree();
+  }
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+  operator delete(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+  if (pointer != nullptr) {
+    OnFree();
+  }
+  AlignedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept {
+  operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept {
+  operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t alignment) noexcept {
+  operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  operator delete(pointer, alignment);
+}
+
+#endif
+
+bool AllocationTracker::IsEnabled() {
+#if defined(TRACK_ALLOCATIONS)
+  return true;
+#else
+  return false;
+#endif
+}
+
+AllocationCounts AllocationTracker::GetThreadCounts() {
+  return Thread.counts_;
+}
+
+AllocationCounts AllocationTracker::GetTotalCounts() {
+  return AllocationCounts {
+    Tracker.allocations_.load(std::memory_order_relaxed),
+    Tracker.frees_.load(std::memory_order_relaxed),
+    Tracker.bytes_.load(std::memory_order_relaxed),
+  };
+}
+
+void AllocationTracker::SetSteadyStateMode(SteadyStateMode mode) {
+  Tracker.mode_.store(mode, std::memory_order_relaxed);
+}
+
+uint64_t AllocationTracker::GetSteadyStateViolations() {
+  return Tracker.violations_.load(std::memory_order_relaxed);
+}
+
+void AllocationTracker::Report() {
+  if (!IsEnabled()) {
+    std::cout << "[allocations] not tracked, configure with -DTRACK_ALLOCATIONS=ON" << std::endl;
+    return;
+  }
+
+  AllocationCounts totals = GetTotalCounts();
+  std::cout
+    << "[allocations] " << totals.allocations_ << " allocations, " << totals.frees_ << " frees, "
+    << totals.bytes_ / 1024 << " KB, " << GetSteadyStateViolations() << " in steady state" << std::endl;
+
+  size_t scope_count = Tracker.scope_count_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < scope_count; ++i) {
+    const ScopeStats& scope = Tracker.scopes_[i];
+    std::cout
+      << "  [" << scope.name_ << "] " << scope.allocations_.load() << " allocations, "
+      << scope.bytes_.load() / 1024 << " KB, " << scope.violations_.load() << " in steady state" << std::endl;
+  }
+
+#if defined(TRACK_CALL_SITES)
+  constexpr size_t kReportedSites = 10;
+
+  // Selection of the busiest sites, without allocating. Copied out so the
+  // lock isn't held while printing, which allocates and would record itself.
+  CallSite top[kReportedSites] = {};
+  size_t top_count = 0;
+  size_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(CallSites.mutex_);
+    for (const CallSite& site : CallSites.sites_) {
+      if (site.depth_ == 0) {
+        continue;
+      }
+      for (size_t i = 0; i < kReportedSites; ++i) {
+        if (i == top_count || site.allocations_ > top[i].allocations_) {
+          std::memmove(&top[i + 1], &top[i], (kReportedSites - i - 1) * sizeof(top[0]));
+          top[i] = site;
+          if (top_count < kReportedSites) {
+            ++top_count;
+          }
+          break;
+        }
+      }
+    }
+    dropped = CallSites.dropped_;
+  }
+
+  std::cout << "[allocations] busiest call sites, " << dropped << " allocations not recorded" << std::endl;
+  for (size_t i = 0; i < top_count; ++i) {
+    std::cout << "  " << top[i].allocations_ << " allocations, " << top[i].bytes_ << " bytes" << std::endl;
+    backtrace_symbols_fd(top[i].frames_, top[i].depth_, 1);
+  }
+#endif
+}
+
+AllocationScope::AllocationScope(const char* name, bool steady_state)
+  : stats_(nullptr), parent_(Thread.scope_), steady_state_(steady_state) {
+  if (!AllocationTracker::IsEnabled()) {
+    return;
+  }
+  stats_ = FindScope(name);
+  Thread.scope_ = stats_;
+  if (steady_state_) {
+    Tracker.steady_depth_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+AllocationScope::~AllocationScope() {
+  if (!AllocationTracker::IsEnabled()) {
+    return;
+  }
+  Thread.scope_ = parent_;
+  if (steady_state_) {
+    Tracker.steady_depth_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
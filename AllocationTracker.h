@@ -0,0 +1,65 @@
+#ifndef ALLOCATION_TRACKER_H_
+#define ALLOCATION_TRACKER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// Counts heap allocations made through global operator new. Opt in with
+// -DTRACK_ALLOCATIONS=ON; without it operator new is left alone, the counts
+// stay at zero and scopes cost nothing. Debug builds on glibc also record
+// the call stack of every allocation for Report.
+//
+// Allocations are attributed to the innermost AllocationScope on the
+// allocating thread. While a steady-state scope is open every allocation
+// is flagged, on any thread, so work handed to workers or the simulation
+// thread is held to it too. That's how frames are kept allocation free:
+//
+//   AllocationScope frame_scope("frame", true);
+
+struct AllocationCounts {
+  uint64_t allocations_;
+  uint64_t frees_;
+  uint64_t bytes_;
+};
+
+enum class SteadyStateMode {
+  // Only counted, see GetSteadyStateViolations
+  kCount,
+  // Printed with the scope name, and the call stack in debug builds
+  kReport,
+  // Printed, then abort
+  kAbort,
+};
+
+class AllocationTracker {
+public:
+  static bool IsEnabled();
+
+  // Calling thread only, since it started
+  static AllocationCounts GetThreadCounts();
+  // Every thread, since the process started
+  static AllocationCounts GetTotalCounts();
+
+  static void SetSteadyStateMode(SteadyStateMode mode);
+  static uint64_t GetSteadyStateViolations();
+
+  // Per-scope totals, then the most frequent call sites in debug builds
+  static void Report();
+};
+
+class AllocationScope {
+public:
+  // name has to outlive the program, scopes with the same name share totals.
+  // steady_state applies to the whole process for the scope's lifetime.
+  explicit AllocationScope(const char* name, bool steady_state = false);
+  ~AllocationScope();
+
+  AllocationScope(const AllocationScope&) = delete;
+  AllocationScope& operator=(const AllocationScope&) = delete;
+private:
+  struct ScopeStats* stats_;
+  struct ScopeStats* parent_;
+  bool steady_state_;
+};
+
+#endif
@@ -2,13 +2,11 @@
 
 #include <iostream>
 
-#include <glad/glad.h>
+#include "GLExtensions.h"
 #include <GLFW/glfw3.h>
 
-
 struct {
-  std::vector<KeyInt> updated_keys_;
-  std::unordered_map<KeyInt, ActionType> keys_;
+  InputEventQueue input_events_;
   int32_t screen_width_;
   int32_t screen_height_;
 } Global;
@@ -20,13 +18,19 @@ void WindowResize(GLFWwindow* window, int32_t width, int32_t height) {
   glViewport(0, 0, width, height);
 }
 
+static int64_t TimerNs() {
+  // Split to keep value * 1e9 from overflowing on high frequency timers
+  uint64_t value = glfwGetTimerValue();
+  uint64_t frequency = glfwGetTimerFrequency();
+  return static_cast<int64_t>((value / frequency) * 1'000'000'000 + (value % frequency) * 1'000'000'000 / frequency);
+}
+
 void KeyCallback(GLFWwindow* window, KeyInt key, int32_t scancode, int32_t action, int32_t mods) {
   ActionType state = ActionType::kRelease;
   if (action == GLFW_PRESS || action == GLFW_REPEAT) {
     state = ActionType::kPress;
   }
-  Global.keys_.insert_or_assign(key, state);
-  Global.updated_keys_.push_back(key);
+  Global.input_events_.Push(InputEvent { TimerNs(), key, state });
 }
 
 int32_t App::GetScreenWidth() const {
@@ -37,7 +41,8 @@ int32_t App::GetScreenHeight() const {
   return Global.screen_height_;
 }
 
-App::App(uint32_t width, uint32_t height, const char* title) : width_(width), height_(height), title_(title) {  
+App::App(uint32_t width, uint32_t height, const char* title) 
+  : frame_arena_("frame arena", 1 << 20), width_(width), height_(height), title_(title) {  
   if (glfwInit() == GLFW_FALSE) {
     std::cerr << "GLFW UNABLE TO INITIALIZE!" << std::endl;
     exit(-1);
@@ -63,15 +68,26 @@ App::App(uint32_t width, uint32_t height, const char* title) : width_(width), he
     exit(-1);
   }
 
+  if (!LoadGLExtensions((GLADloadproc)glfwGetProcAddress)) {
+    std::cerr << "UNABLE TO LOAD GL 3.3 ENTRY POINTS" << std::endl;
+    glfwDestroyWindow(window_);
+    glfwTerminate();
+    exit(-1);
+  }
+
   glViewport(0, 0, width_, height_);
 
   Global.screen_width_ = width_;
   Global.screen_height_ = height_;
 
+  frame_events_.reserve(InputEventQueue::GetCapacity());
+
   glfwSetWindowSizeCallback(window_, WindowResize);
   glfwSetKeyCallback(window_, KeyCallback);
 
-  current_time_ = GetTime();  
+  current_time_ = GetTimeNs();
+  previous_time_ = current_time_;
+  delta_ = 0;
 
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_BLEND);
@@ -84,22 +100,34 @@ App::~App() {
 }
 
 bool App::Update() {
-  glfwPollEvents();
+  frame_pacer_.WaitForFrameStart();
 
-  for (KeyInt updated_key: Global.updated_keys_) {
-    std::optional<std::string> action = input_manager_.GetAction(Key(updated_key));
-    if (action) {
-      std::string action_str = action.value();
-      ActionType action_type = Global.keys_.at(updated_key);
-      Action new_action = Action(action_str, action_type);
-      input_manager_.actions_.insert_or_assign(action_str, new_action);
-    }
-  }
-  Global.updated_keys_.clear();
+  input_manager_.NewFrame();
+  glfwPollEvents();
+  frame_pacer_.MarkInputSampled();
 
   previous_time_ = current_time_;
-  current_time_ = GetTime();
+  current_time_ = GetTimeNs();
   delta_ = current_time_ - previous_time_;
+
+  // Bounded so a producer on another thread can't keep this frame draining
+  frame_events_.clear();
+  InputEvent event;
+  while (frame_events_.size() < InputEventQueue::GetCapacity() && Global.input_events_.Pop(event)) {
+    frame_events_.push_back(event);
+  }
+
+  if (input_replay_.IsOpen() && !input_replay_.NextFrame(delta_, frame_events_)) {
+    input_replay_.Close();
+  }
+
+  for (const InputEvent& frame_event : frame_events_) {
+    input_manager_.SetKey(frame_event.key_, frame_event.type_);
+  }
+
+  if (input_recorder_.IsOpen()) {
+    input_recorder_.RecordFrame(delta_, frame_events_.data(), frame_events_.size());
+  }
   
   return !glfwWindowShouldClose(window_);
 }
@@ -108,22 +136,98 @@ double App::GetTime() const {
   return glfwGetTime();
 }
 
+int64_t App::GetTimeNs() const {
+  return TimerNs();
+}
+
 void App::BeginFrame() {  
+  frame_arena_.Reset();
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+LinearArena& App::GetFrameArena() {
+  return frame_arena_;
+}
+
 void App::EndFrame() {
+  // The pacer predicts when to start from work alone. In low latency mode
+  // that includes the GPU's share, everywhere else only submission.
+  bool low_latency = frame_pacer_.GetMode() == PacingMode::kLowLatency;
+  if (low_latency) {
+    glFinish();
+  }
+  frame_pacer_.MarkWorkDone();
+
   glfwSwapBuffers(window_);  
+
+  // Keeps the driver from queueing frames ahead, which would add latency
+  // the pacer cannot see
+  if (low_latency) {
+    glFinish();
+  }
+  frame_pacer_.MarkPresented();
+}
+
+void App::SetSwapMode(SwapMode mode) {
+  int32_t interval = 1;
+  if (mode == SwapMode::kImmediate) {
+    interval = 0;
+  } else if (mode == SwapMode::kAdaptive) {
+    bool tear_supported = 
+      glfwExtensionSupported("WGL_EXT_swap_control_tear") == GLFW_TRUE || 
+      glfwExtensionSupported("GLX_EXT_swap_control_tear") == GLFW_TRUE;
+    if (tear_supported) {
+      interval = -1;
+    }
+  }
+  glfwSwapInterval(interval);
+}
+
+void App::SetPacingMode(PacingMode mode, double target_hz) {
+  if (target_hz <= 0.0) {
+    const GLFWvidmode* video_mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    target_hz = video_mode ? video_mode->refreshRate : 60.0;
+  }
+  frame_pacer_.SetTargetFrameRate(target_hz);
+  frame_pacer_.SetMode(mode);
+}
+
+const FramePacer& App::GetFramePacer() const {
+  return frame_pacer_;
 }
 
 void App::CloseWindow() const {
   glfwSetWindowShouldClose(window_, GLFW_TRUE);
 }
 
-float App::GetDeltaTime() const {
+double App::GetDeltaTime() const {
+  return static_cast<double>(delta_) / 1'000'000'000.0;
+}
+
+int64_t App::GetDeltaTimeNs() const {
   return delta_;
 }
 
 InputManager& App::GetInputManager() {
   return input_manager_;
 }
+
+bool App::StartRecording(const std::string& filename, double timestep) {
+  return input_recorder_.Open(filename, static_cast<int64_t>(timestep * 1'000'000'000.0));
+}
+
+void App::StopRecording() {
+  input_recorder_.Close();
+}
+
+bool App::StartReplay(const std::string& filename) {
+  return input_replay_.Open(filename);
+}
+
+bool App::IsReplaying() const {
+  return input_replay_.IsOpen();
+}
+
+double App::GetReplayTimeStep() const {
+  return static_cast<double>(input_replay_.GetTimeStepNs()) / 1'000'000'000.0;
+}
@@ -2,9 +2,20 @@
 #define APP_H_
 
 #include <string>
+#include <vector>
 #include <cstdint>
 
 #include "InputManager.h"
+#include "FramePacer.h"
+#include "InputRecorder.h"
+#include "LinearArena.h"
+
+enum class SwapMode {
+  kImmediate,
+  kVsync,
+  // Falls back to kVsync when the driver has no swap_control_tear
+  kAdaptive,
+};
 
 class App {
 public:
@@ -16,6 +27,7 @@ public:
   void EndFrame();
 
   double GetTime() const;
+  int64_t GetTimeNs() const;
 
   void CloseWindow() const;
 
@@ -24,13 +36,39 @@ public:
 
   InputManager& GetInputManager();
 
-  float GetDeltaTime() const;
+  double GetDeltaTime() const;
+  int64_t GetDeltaTimeNs() const;
+
+  void SetSwapMode(SwapMode mode);
+  // A target_hz of 0 paces to the primary monitor's refresh rate
+  void SetPacingMode(PacingMode mode, double target_hz = 0.0);
+
+  const FramePacer& GetFramePacer() const;
+
+  // Reset in BeginFrame, for data that only lives for one frame
+  LinearArena& GetFrameArena();
+
+  bool StartRecording(const std::string& filename, double timestep);
+  void StopRecording();
+
+  // While replaying, live key events are ignored and frame deltas come from
+  // the recording
+  bool StartReplay(const std::string& filename);
+  bool IsReplaying() const;
+  double GetReplayTimeStep() const;
 private:
   InputManager input_manager_;
+  FramePacer frame_pacer_;
+
+  InputRecorder input_recorder_;
+  InputReplay input_replay_;
+  std::vector<InputEvent> frame_events_;
+
+  LinearArena frame_arena_;
 
-  float current_time_;
-  float previous_time_;
-  float delta_;
+  int64_t current_time_;
+  int64_t previous_time_;
+  int64_t delta_;
 private:
   uint32_t width_;
   uint32_t height_;
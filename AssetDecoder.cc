@@ -0,0 +1,1027 @@
+#include "AssetDecoder.h"
+#include "MeshoptDecoder.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <stb_image.h>
+#include <json.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cassert>
+#include <unordered_map>
+#include <filesystem>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <cmath>
+
+using Clock = std::chrono::steady_clock;
+
+static double ElapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double DecodeStats::TotalMs() const {
+  return parse_ms_ + decompress_ms_ + accessor_ms_ + vertex_ms_ + skin_ms_ + image_ms_;
+}
+
+constexpr uint32_t kGlbMagic = 0x46546C67;
+constexpr uint32_t kGlbJsonChunk = 0x4E4F534A;
+constexpr uint32_t kGlbBinChunk = 0x004E4942;
+
+// Stand-in for GLB buffers and images while tinygltf parses the JSON chunk.
+// One byte, tinygltf rejects data uris that decode to nothing.
+static const char* kPlaceholderUri = "data:application/octet-stream;base64,AA==";
+
+// Extensions we understand well enough to load files that require them
+static const char* kSupportedExtensions[] = {
+  "KHR_mesh_quantization",
+  "KHR_texture_transform",
+  "EXT_meshopt_compression",
+};
+
+static ModelBuffer StoreBuffer(ModelData& data, std::vector<uint8_t>&& bytes) {
+  ModelBuffer buffer;
+  buffer.data_ = bytes.data();
+  buffer.size_ = bytes.size();
+  buffer.storage_ = data.storage_.size();
+  // Moving the vector keeps its bytes where they are
+  data.storage_.push_back(std::move(bytes));
+  return buffer;
+}
+
+// Buffers the loader didn't already provide are moved out of the model
+static void AdoptBuffers(tinygltf::Model& model, ModelData& data) {
+  data.buffers_.resize(std::max(data.buffers_.size(), model.buffers.size()));
+  for (size_t i = 0; i < model.buffers.size(); ++i) {
+    if (data.buffers_[i].data_ == nullptr && !model.buffers[i].data.empty()) {
+      data.buffers_[i] = StoreBuffer(data, std::move(model.buffers[i].data));
+    }
+  }
+}
+
+// At least size bytes of buffer index that can be written, copied out of
+// the source first when the buffer isn't owned
+static uint8_t* GetWritableBuffer(ModelData& data, int32_t index, size_t size) {
+  ModelBuffer& buffer = data.buffers_[index];
+  if (buffer.storage_ < 0) {
+    buffer = StoreBuffer(data, std::vector<uint8_t>(buffer.data_, buffer.data_ + buffer.size_));
+  }
+
+  std::vector<uint8_t>& storage = data.storage_[buffer.storage_];
+  if (storage.size() < size) {
+    storage.resize(size);
+    buffer.data_ = storage.data();
+    buffer.size_ = storage.size();
+  }
+  return storage.data();
+}
+
+static const uint8_t* AccessorData(
+  const tinygltf::Model& model,
+  const std::vector<ModelBuffer>& buffers,
+  const tinygltf::Accessor& accessor
+) {
+  const tinygltf::BufferView& bv = model.bufferViews[accessor.bufferView];
+  return buffers[bv.buffer].data_ + bv.byteOffset + accessor.byteOffset;
+}
+
+static size_t AccessorStride(const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
+  return accessor.ByteStride(model.bufferViews[accessor.bufferView]);
+}
+
+// Normalized integers map to [0, 1] or [-1, 1] as the spec describes,
+// anything else (quantized positions and texcoords) converts as is
+template <typename T>
+static float ReadComponent(const uint8_t* data, bool normalized) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  if (!normalized) {
+    return float(value);
+  }
+
+  constexpr float kMax = float(std::numeric_limits<T>::max());
+  return std::max(float(value) / kMax, -1.0f);
+}
+
+static float ReadComponent(const uint8_t* data, int32_t component_type, bool normalized) {
+  switch (component_type) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      return ReadComponent<int8_t>(data, normalized);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      return ReadComponent<uint8_t>(data, normalized);
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+      return ReadComponent<int16_t>(data, normalized);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      return ReadComponent<uint16_t>(data, normalized);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      return ReadComponent<uint32_t>(data, false);
+    default: {
+      float value;
+      std::memcpy(&value, data, sizeof(float));
+      return value;
+    }
+  }
+}
+
+// T is a glm float vector, accessors with fewer components than T leave
+// the rest zeroed
+template <typename T>
+static void LoadAttribute(
+  const tinygltf::Model& model,
+  const std::vector<ModelBuffer>& buffers,
+  const tinygltf::Accessor& accessor,
+  ArenaVector<T>& out
+) {
+  out.assign(accessor.count, T(0.0));
+  // Without a buffer view the accessor is all zeros
+  if (accessor.bufferView < 0) {
+    return;
+  }
+
+  const uint8_t* data = AccessorData(model, buffers, accessor);
+  size_t stride = AccessorStride(model, accessor);
+
+  constexpr int32_t kComponents = sizeof(T) / sizeof(float);
+  int32_t components = std::min(tinygltf::GetNumComponentsInType(accessor.type), kComponents);
+
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && components == kComponents) {
+    for (size_t i = 0; i < accessor.count; ++i) {
+      std::memcpy(&out[i], data + stride * i, sizeof(T));
+    }
+    return;
+  }
+
+  size_t component_size = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  for (size_t i = 0; i < accessor.count; ++i) {
+    const uint8_t* element = data + stride * i;
+    for (int32_t c = 0; c < components; ++c) {
+      out[i][c] = ReadComponent(element + component_size * c, accessor.componentType, accessor.normalized);
+    }
+  }
+}
+
+// Joints are unsigned byte or short in the file and widened to int for the
+// CPU copy, the GPU reads them as stored
+static void LoadJoints(
+  const tinygltf::Model& model,
+  const std::vector<ModelBuffer>& buffers,
+  const tinygltf::Accessor& accessor,
+  ArenaVector<glm::ivec4>& out
+) {
+  out.assign(accessor.count, glm::ivec4(0));
+  if (accessor.bufferView < 0) {
+    return;
+  }
+
+  const uint8_t* data = AccessorData(model, buffers, accessor);
+  size_t stride = AccessorStride(model, accessor);
+
+  for (size_t i = 0; i < accessor.count; ++i) {
+    const uint8_t* element = data + stride * i;
+    for (int32_t c = 0; c < 4; ++c) {
+      if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+        uint16_t joint;
+        std::memcpy(&joint, element + c * sizeof(uint16_t), sizeof(uint16_t));
+        out[i][c] = joint;
+      } else {
+        out[i][c] = element[c];
+      }
+    }
+  }
+}
+
+// KHR_texture_transform on the base color texture. Quantized texcoords rely
+// on it to map back to [0, 1].
+static void ApplyTextureTransform(const tinygltf::TextureInfo& texture_info, ArenaVector<glm::vec2>& texcoords) {
+  auto it = texture_info.extensions.find("KHR_texture_transform");
+  if (it == texture_info.extensions.cend()) {
+    return;
+  }
+  const tinygltf::Value& transform = it->second;
+
+  glm::vec2 offset(0.0);
+  glm::vec2 scale(1.0);
+  float rotation = 0.0f;
+
+  if (transform.Has("offset")) {
+    const tinygltf::Value& value = transform.Get("offset");
+    offset = glm::vec2(value.Get(0).GetNumberAsDouble(), value.Get(1).GetNumberAsDouble());
+  }
+  if (transform.Has("scale")) {
+    const tinygltf::Value& value = transform.Get("scale");
+    scale = glm::vec2(value.Get(0).GetNumberAsDouble(), value.Get(1).GetNumberAsDouble());
+  }
+  if (transform.Has("rotation")) {
+    rotation = transform.Get("rotation").GetNumberAsDouble();
+  }
+
+  float c = std::cos(rotation);
+  float s = std::sin(rotation);
+  for (glm::vec2& uv : texcoords) {
+    glm::vec2 scaled = uv * scale;
+    uv = glm::vec2(c * scaled.x + s * scaled.y, -s * scaled.x + c * scaled.y) + offset;
+  }
+}
+
+static bool HasTextureTransform(const tinygltf::TextureInfo& texture_info) {
+  return texture_info.extensions.find("KHR_texture_transform") != texture_info.extensions.cend();
+}
+
+// Attributes go to the GPU as the file stores them, quantized ones are
+// converted by the vertex fetch instead of expanded here. Texcoords with a
+// transform are the exception and come from the transformed floats.
+static void BuildVertexStreams(
+  const tinygltf::Model& model,
+  const std::vector<ModelBuffer>& buffers,
+  const tinygltf::Accessor* const (&accessors)[kAttributeCount],
+  const ArenaVector<glm::vec2>* transformed_texcoords,
+  size_t vertex_count,
+  PrimitiveData& primitive
+) {
+  constexpr int32_t kMaxComponents[kAttributeCount] = { 3, 2, 3, 4, 4 };
+  constexpr uint32_t kStreams[kAttributeCount] = {
+    kStreamPosition, kStreamShading, kStreamShading, kStreamPosition, kStreamPosition
+  };
+
+  VertexLayout& layout = primitive.layout_;
+  for (uint32_t attribute = 0; attribute < kAttributeCount; ++attribute) {
+    const tinygltf::Accessor* accessor = accessors[attribute];
+    if (accessor == nullptr) {
+      continue;
+    }
+
+    VertexAttributeFormat& format = layout.attributes_[attribute];
+    if (attribute == kAttributeTexCoord && transformed_texcoords != nullptr) {
+      format.type_ = TINYGLTF_COMPONENT_TYPE_FLOAT;
+      format.components_ = 2;
+    } else {
+      format.type_ = accessor->componentType;
+      format.components_ = std::min(tinygltf::GetNumComponentsInType(accessor->type), kMaxComponents[attribute]);
+      format.normalized_ = accessor->normalized;
+    }
+
+    // Four byte aligned, which GL wants for every attribute
+    uint32_t size = format.components_ * tinygltf::GetComponentSizeInBytes(format.type_);
+    format.stream_ = kStreams[attribute];
+    format.offset_ = layout.strides_[format.stream_];
+    layout.strides_[format.stream_] += (size + 3) & ~3u;
+  }
+
+  for (uint32_t stream = 0; stream < kStreamCount; ++stream) {
+    primitive.streams_[stream].assign(vertex_count * layout.strides_[stream], 0);
+  }
+
+  for (uint32_t attribute = 0; attribute < kAttributeCount; ++attribute) {
+    const tinygltf::Accessor* accessor = accessors[attribute];
+    const VertexAttributeFormat& format = layout.attributes_[attribute];
+    if (accessor == nullptr) {
+      continue;
+    }
+
+    uint32_t stride = layout.strides_[format.stream_];
+    uint8_t* out = primitive.streams_[format.stream_].data() + format.offset_;
+
+    if (attribute == kAttributeTexCoord && transformed_texcoords != nullptr) {
+      for (size_t i = 0; i < vertex_count; ++i) {
+        std::memcpy(out + stride * i, &(*transformed_texcoords)[i], sizeof(glm::vec2));
+      }
+      continue;
+    }
+
+    // Without a buffer view the accessor is all zeros
+    if (accessor->bufferView < 0) {
+      continue;
+    }
+
+    const uint8_t* data = AccessorData(model, buffers, *accessor);
+    size_t accessor_stride = AccessorStride(model, *accessor);
+    size_t size = format.components_ * tinygltf::GetComponentSizeInBytes(format.type_);
+    size_t count = std::min(vertex_count, accessor->count);
+    for (size_t i = 0; i < count; ++i) {
+      std::memcpy(out + stride * i, data + accessor_stride * i, size);
+    }
+  }
+}
+
+static glm::mat4 NodeTransform(const tinygltf::Node& node) {
+  glm::mat4 local(1.0);
+
+  if (!node.translation.empty()) {
+    local = glm::translate(local, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
+  }
+  if (!node.rotation.empty()) {
+    glm::quat rot(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+
+    float angle = glm::angle(rot);
+    glm::vec3 axis = glm::axis(rot);
+
+    local = glm::rotate(local, angle, axis);
+  }
+  if (!node.scale.empty()) {
+    local = glm::scale(local, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+  }
+
+  return local;
+}
+
+// Installed as tinygltf's image loader so parsing leaves images compressed.
+// Images embedded through a buffer view are read from the buffer later,
+// anything else keeps its encoded bytes in image.image.
+static bool DeferImageDecode(
+  tinygltf::Image* image, 
+  const int image_idx, 
+  std::string* err, 
+  std::string* warn, 
+  int req_width, 
+  int req_height, 
+  const unsigned char* bytes, 
+  int size, 
+  void* user_data
+) {
+  if (image->bufferView < 0) {
+    image->image.assign(bytes, bytes + size);
+  }
+  image->as_is = true;
+  return true;
+}
+
+// -1 when the image can't be read, the material is drawn untextured then
+static int32_t GetTexture(
+  tinygltf::Model& model,
+  const tinygltf::Texture& texture,
+  std::unordered_map<std::string, int32_t>& texture_lookup,
+  ModelData& data
+) {
+  if (texture.source < 0 || size_t(texture.source) >= model.images.size()) {
+    return -1;
+  }
+  tinygltf::Image& image = model.images[texture.source];
+
+  auto it = texture_lookup.find(image.name);
+  if (it != texture_lookup.cend()) {
+    return it->second;
+  }
+
+  TextureData result;
+  result.name_ = image.name;
+
+  if (image.bufferView >= 0) {
+    if (size_t(image.bufferView) >= model.bufferViews.size()) {
+      std::cout << "[" << image.name << "] ERROR: image buffer view out of range" << std::endl;
+      texture_lookup[image.name] = -1;
+      return -1;
+    }
+    const tinygltf::BufferView& bv = model.bufferViews[image.bufferView];
+    bool in_range = 
+      bv.buffer >= 0 && size_t(bv.buffer) < data.buffers_.size() &&
+      bv.byteOffset <= data.buffers_[bv.buffer].size_ &&
+      bv.byteLength <= data.buffers_[bv.buffer].size_ - bv.byteOffset;
+    if (!in_range || data.buffers_[bv.buffer].data_ == nullptr) {
+      std::cout << "[" << image.name << "] ERROR: image buffer view outside its buffer" << std::endl;
+      texture_lookup[image.name] = -1;
+      return -1;
+    }
+    result.buffer_ = bv.buffer;
+    result.offset_ = bv.byteOffset;
+    result.size_ = bv.byteLength;
+  } else {
+    result.buffer_ = data.buffers_.size();
+    result.offset_ = 0;
+    result.size_ = image.image.size();
+    data.buffers_.push_back(StoreBuffer(data, std::move(image.image)));
+  }
+
+  // Only reads the header, the pixels are decoded later. Everything is
+  // expanded to RGBA on decode.
+  const uint8_t* encoded = data.buffers_[result.buffer_].data_ + result.offset_;
+  int32_t channels = 0;
+  if (!stbi_info_from_memory(encoded, result.size_, &result.width_, &result.height_, &channels)) {
+    std::cout << "[" << image.name << "] ERROR: " << stbi_failure_reason() << std::endl;
+    texture_lookup[image.name] = -1;
+    return -1;
+  }
+  result.component_ = 4;
+
+  tinygltf::Sampler sampler;
+  if (texture.sampler >= 0) {
+    sampler = model.samplers[texture.sampler];
+  }
+  result.wrap_s_ = sampler.wrapS;
+  result.wrap_t_ = sampler.wrapT;
+  result.min_filter_ = sampler.minFilter;
+  result.mag_filter_ = sampler.magFilter;
+
+  int32_t index = data.textures_.size();
+  data.textures_.push_back(std::move(result));
+  texture_lookup[image.name] = index;
+
+  return index;
+}
+
+static MeshData GetMesh(
+  tinygltf::Model& model,
+  const tinygltf::Mesh& mesh,
+  std::unordered_map<std::string, int32_t>& texture_lookup,
+  ModelData& data,
+  DecodeStats& stats,
+  LinearArena* scratch
+) {
+  MeshData result;
+
+  for (const tinygltf::Primitive& primitive : mesh.primitives) {
+    Clock::time_point accessor_start = Clock::now();
+
+    PrimitiveData primitive_data { 
+      ArenaVector<Vertex>(ArenaAllocator<Vertex>(scratch)), 
+      ArenaVector<uint8_t>(ArenaAllocator<uint8_t>(scratch)),
+      VertexLayout {},
+      {
+        ArenaVector<uint8_t>(ArenaAllocator<uint8_t>(scratch)),
+        ArenaVector<uint8_t>(ArenaAllocator<uint8_t>(scratch))
+      }
+    };
+
+    // Index data is tightly packed by the spec, only the accessor's range is copied
+    const tinygltf::Accessor& indices_accessor = model.accessors[primitive.indices];
+    const uint8_t* indices = AccessorData(model, data.buffers_, indices_accessor);
+    size_t indices_size = indices_accessor.count * tinygltf::GetComponentSizeInBytes(indices_accessor.componentType);
+
+    primitive_data.indices_.assign(indices, indices + indices_size);
+    primitive_data.index_type_ = indices_accessor.componentType;
+    primitive_data.index_count_ = indices_accessor.count;
+
+    ArenaVector<glm::vec3> positions { ArenaAllocator<glm::vec3>(scratch) };
+    ArenaVector<glm::vec2> texcoords { ArenaAllocator<glm::vec2>(scratch) };
+    ArenaVector<glm::vec3> normals { ArenaAllocator<glm::vec3>(scratch) };
+    ArenaVector<glm::ivec4> joints { ArenaAllocator<glm::ivec4>(scratch) };
+    ArenaVector<glm::vec4> weights { ArenaAllocator<glm::vec4>(scratch) };
+    const tinygltf::Accessor* accessors[kAttributeCount] = {};
+
+    for (auto& [name, index] : primitive.attributes) {
+      const tinygltf::Accessor& accessor = model.accessors[index];
+
+      if (name == "NORMAL") {
+        LoadAttribute(model, data.buffers_, accessor, normals);
+        accessors[kAttributeNormal] = &accessor;
+      } else if (name == "POSITION") {
+        LoadAttribute(model, data.buffers_, accessor, positions);
+        accessors[kAttributePosition] = &accessor;
+      } else if (name == "TEXCOORD_0") {
+        LoadAttribute(model, data.buffers_, accessor, texcoords);
+        accessors[kAttributeTexCoord] = &accessor;
+      } else if (name == "JOINTS_0") {
+        LoadJoints(model, data.buffers_, accessor, joints);
+        accessors[kAttributeJoints] = &accessor;
+      } else if (name == "WEIGHTS_0") {
+        LoadAttribute(model, data.buffers_, accessor, weights);
+        accessors[kAttributeWeights] = &accessor;
+      }
+    }
+
+    // Skinning takes both or neither
+    if (joints.empty() || weights.empty()) {
+      accessors[kAttributeJoints] = nullptr;
+      accessors[kAttributeWeights] = nullptr;
+    }
+
+    bool transformed = false;
+    if (primitive.material >= 0 && !texcoords.empty()) {
+      const tinygltf::Material& material = model.materials[primitive.material];
+      transformed = HasTextureTransform(material.pbrMetallicRoughness.baseColorTexture);
+      ApplyTextureTransform(material.pbrMetallicRoughness.baseColorTexture, texcoords);
+    }
+
+    stats.accessor_ms_ += ElapsedMs(accessor_start);
+    Clock::time_point vertex_start = Clock::now();
+
+    assert(positions.size() == normals.size() && positions.size() > 0);
+
+    ArenaVector<Vertex>& vertices = primitive_data.vertices_;
+    vertices.resize(positions.size());
+    primitive_data.bounds_ = Aabb { positions[0], positions[0] };
+    for (size_t i = 0; i < positions.size(); ++i) {
+      primitive_data.bounds_.min_ = glm::min(primitive_data.bounds_.min_, positions[i]);
+      primitive_data.bounds_.max_ = glm::max(primitive_data.bounds_.max_, positions[i]);
+
+      vertices[i].pos_ = positions[i];
+      vertices[i].normal_ = normals[i];
+      if (texcoords.size() > 0) {
+        vertices[i].tex_coords_ = texcoords[i];
+      } else {
+        vertices[i].tex_coords_ = glm::vec2(0.0);
+      }
+      vertices[i].joints_ = glm::ivec4(0);
+      vertices[i].weights_ = glm::vec4(0.0);
+    }
+
+    if (joints.size() > 0 && weights.size() > 0) {
+      assert(joints.size() == weights.size() && weights.size() == positions.size());
+      for (size_t i = 0; i < joints.size(); ++i) {
+        vertices[i].joints_ = joints[i];
+        vertices[i].weights_ = weights[i];
+      }
+    }
+
+    BuildVertexStreams(
+      model, data.buffers_, accessors, transformed ? &texcoords : nullptr, vertices.size(), primitive_data
+    );
+
+    stats.vertex_ms_ += ElapsedMs(vertex_start);
+    stats.vertex_count_ += vertices.size();
+
+    // TODO (HANDLE COLOR)
+    if (primitive.material >= 0) {
+      MaterialData material_data;
+      const tinygltf::Material& material = model.materials[primitive.material];
+      const tinygltf::TextureInfo& texture_info = material.pbrMetallicRoughness.baseColorTexture;
+      if (texture_info.index >= 0) {
+        const tinygltf::Texture& texture = model.textures[texture_info.index];
+        material_data.texture_ = GetTexture(model, texture, texture_lookup, data);
+      }
+
+      const std::vector<double>& color = material.pbrMetallicRoughness.baseColorFactor;
+      if (!color.empty()) {
+        material_data.color_ = glm::vec4(color[0], color[1], color[2], color[3]);
+      }
+
+      primitive_data.material_ = material_data;
+    }
+
+    if (joints.size() > 0 && weights.size() > 0) {
+      primitive_data.features_ |= kFeatureSkinned;
+    }
+    if (primitive_data.material_ && primitive_data.material_->texture_ >= 0 && texcoords.size() > 0) {
+      primitive_data.features_ |= kFeatureTextured;
+    }
+
+    result.primitives_.push_back(std::move(primitive_data));
+  }
+
+  return result;
+}
+
+static Joint ProcessJoint(const tinygltf::Model& model, const tinygltf::Node& joint) {
+  Joint curr;
+  curr.transform_ = NodeTransform(joint);
+
+  for (int32_t child_id : joint.children) {
+    curr.children_.emplace_back(ProcessJoint(model, model.nodes[child_id]));
+  }
+
+  return curr;
+}
+
+static Skin GetSkin(const tinygltf::Model& model, const std::vector<ModelBuffer>& buffers, const tinygltf::Skin& skin) {
+  Skin result;
+
+  const tinygltf::Accessor& inverse_bind_matrices = model.accessors[skin.inverseBindMatrices];
+  const uint8_t* data = AccessorData(model, buffers, inverse_bind_matrices);
+  size_t stride = AccessorStride(model, inverse_bind_matrices);
+
+  result.root_ = ProcessJoint(model, model.nodes[skin.joints[0]]);
+
+  result.inverse_bind_matrices_.resize(inverse_bind_matrices.count);
+  for (size_t i = 0; i < inverse_bind_matrices.count; ++i) {
+    std::memcpy(&result.inverse_bind_matrices_[i], data + stride * i, sizeof(glm::mat4));
+  }
+
+  return result;
+}
+
+void AssetDecoder::Decode(tinygltf::Model& model, ModelData& result, DecodeStats* stats, LinearArena* scratch) {
+  DecodeStats local_stats;
+  DecodeStats& current = stats ? *stats : local_stats;
+
+  AdoptBuffers(model, result);
+  std::unordered_map<std::string, int32_t> texture_lookup;
+
+  for (const tinygltf::Node& node : model.nodes) {
+    if (node.mesh < 0) {
+      continue;
+    }
+    MeshData mesh = GetMesh(model, model.meshes[node.mesh], texture_lookup, result, current, scratch);
+    mesh.local_transform_ = NodeTransform(node);
+    result.meshes_.push_back(std::move(mesh));
+  }
+
+  Clock::time_point skin_start = Clock::now();
+  for (const tinygltf::Skin& skin : model.skins) {
+    result.skins_.push_back(GetSkin(model, result.buffers_, skin));
+  }
+  current.skin_ms_ += ElapsedMs(skin_start);
+}
+
+static MeshoptMode ParseMeshoptMode(const std::string& mode) {
+  if (mode == "TRIANGLES") {
+    return MeshoptMode::kTriangles;
+  } else if (mode == "INDICES") {
+    return MeshoptMode::kIndices;
+  }
+  return MeshoptMode::kAttributes;
+}
+
+static MeshoptFilter ParseMeshoptFilter(const std::string& filter) {
+  if (filter == "OCTAHEDRAL") {
+    return MeshoptFilter::kOctahedral;
+  } else if (filter == "QUATERNION") {
+    return MeshoptFilter::kQuaternion;
+  } else if (filter == "EXPONENTIAL") {
+    return MeshoptFilter::kExponential;
+  }
+  return MeshoptFilter::kNone;
+}
+
+// Decodes every EXT_meshopt_compression buffer view into the view's own
+// buffer, which the file leaves empty as a fallback, so accessors can read
+// it like any other view afterwards
+static bool DecompressBufferViews(const tinygltf::Model& model, ModelData& data, std::string& err) {
+  for (const tinygltf::BufferView& bv : model.bufferViews) {
+    auto it = bv.extensions.find("EXT_meshopt_compression");
+    if (it == bv.extensions.cend()) {
+      continue;
+    }
+    const tinygltf::Value& ext = it->second;
+
+    int32_t source_index = ext.Get("buffer").GetNumberAsInt();
+    size_t source_offset = ext.Has("byteOffset") ? ext.Get("byteOffset").GetNumberAsInt() : 0;
+    size_t source_size = ext.Get("byteLength").GetNumberAsInt();
+    size_t stride = ext.Get("byteStride").GetNumberAsInt();
+    size_t count = ext.Get("count").GetNumberAsInt();
+
+    MeshoptMode mode = ParseMeshoptMode(ext.Get("mode").Get<std::string>());
+    MeshoptFilter filter = MeshoptFilter::kNone;
+    if (ext.Has("filter")) {
+      filter = ParseMeshoptFilter(ext.Get("filter").Get<std::string>());
+    }
+
+    if (source_index < 0 || size_t(source_index) >= data.buffers_.size() ||
+        source_offset + source_size > data.buffers_[source_index].size_) {
+      err = "meshopt source range is out of bounds";
+      return false;
+    }
+
+    // Before the source is looked up, growing the destination can move it
+    uint8_t* destination = GetWritableBuffer(data, bv.buffer, bv.byteOffset + count * stride);
+    const ModelBuffer& source = data.buffers_[source_index];
+
+    bool success = MeshoptDecoder::Decode(
+      destination + bv.byteOffset, count, stride,
+      source.data_ + source_offset, source_size,
+      mode, filter
+    );
+    if (!success) {
+      err = "malformed meshopt buffer view";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool CheckRequiredExtensions(const tinygltf::Model& model, std::string& err) {
+  for (const std::string& extension : model.extensionsRequired) {
+    bool supported = std::any_of(std::begin(kSupportedExtensions), std::end(kSupportedExtensions), 
+      [&](const char* name) { return extension == name; });
+    if (!supported) {
+      err = "unsupported required extension " + extension;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs between parsing and Decode, everything that can reject a file that parsed fine
+static bool Prepare(tinygltf::Model& model, ModelData& data, DecodeStats* stats, std::string& err) {
+  if (!CheckRequiredExtensions(model, err)) {
+    return false;
+  }
+  AdoptBuffers(model, data);
+
+  Clock::time_point decompress_start = Clock::now();
+  bool success = DecompressBufferViews(model, data, err);
+  if (stats) {
+    stats->decompress_ms_ += ElapsedMs(decompress_start);
+  }
+  return success;
+}
+
+static bool ReportErrors(const std::string& name, bool success, const std::string& err, const std::string& warn) {
+  if (!err.empty()) {
+    std::cout << "[" << name << "] ERROR: " << err << std::endl;
+  }
+  if (!warn.empty()) {
+    std::cout << "[" << name << "] WARN: " << warn << std::endl;
+  }
+  return success;
+}
+
+struct GlbChunks {
+  const char* json_ = nullptr;
+  size_t json_size_ = 0;
+  const uint8_t* bin_ = nullptr;
+  size_t bin_size_ = 0;
+};
+
+static uint32_t ReadU32(const uint8_t* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(uint32_t));
+  return value;
+}
+
+// The 12 byte header, then a JSON chunk and an optional BIN chunk, each
+// with an 8 byte header of its own
+static bool ReadGlbChunks(const uint8_t* data, size_t size, GlbChunks& chunks, std::string& err) {
+  if (size < 20 || ReadU32(data) != kGlbMagic) {
+    err = "not a GLB file";
+    return false;
+  }
+  if (ReadU32(data + 4) != 2) {
+    err = "unsupported GLB version";
+    return false;
+  }
+  size = std::min<size_t>(size, ReadU32(data + 8));
+  if (size < 20) {
+    err = "truncated GLB header";
+    return false;
+  }
+
+  size_t json_size = ReadU32(data + 12);
+  if (ReadU32(data + 16) != kGlbJsonChunk || json_size > size - 20) {
+    err = "malformed GLB JSON chunk";
+    return false;
+  }
+  chunks.json_ = reinterpret_cast<const char*>(data + 20);
+  chunks.json_size_ = json_size;
+
+  size_t bin_header = 20 + (json_size + 3) / 4 * 4;
+  if (bin_header + 8 <= size && ReadU32(data + bin_header + 4) == kGlbBinChunk) {
+    size_t bin_size = ReadU32(data + bin_header);
+    if (bin_size > size - bin_header - 8) {
+      err = "malformed GLB BIN chunk";
+      return false;
+    }
+    chunks.bin_ = data + bin_header + 8;
+    chunks.bin_size_ = bin_size;
+  }
+  return true;
+}
+
+// Parses only the JSON chunk of a GLB. tinygltf copies the BIN chunk into
+// every buffer that lives there, so those buffers are swapped for a one
+// byte placeholder before it sees the JSON and result points into the chunk
+// instead. Images in buffer views would make it read the placeholders, they
+// get one of their own. Both are put back the way they were afterwards.
+static bool ParseGlb(
+  tinygltf::TinyGLTF& loader,
+  const uint8_t* data,
+  size_t size,
+  const std::string& base_dir,
+  tinygltf::Model& model,
+  ModelData& result,
+  std::string& err,
+  std::string& warn
+) {
+  GlbChunks chunks;
+  if (!ReadGlbChunks(data, size, chunks, err)) {
+    return false;
+  }
+
+  nlohmann::json json = nlohmann::json::parse(chunks.json_, chunks.json_ + chunks.json_size_, nullptr, false);
+  if (json.is_discarded() || !json.is_object()) {
+    err = "malformed GLB JSON chunk";
+    return false;
+  }
+
+  std::vector<bool> placeholder_buffers;
+  auto buffers = json.find("buffers");
+  if (buffers != json.end() && buffers->is_array()) {
+    result.buffers_.resize(buffers->size());
+    placeholder_buffers.assign(buffers->size(), false);
+    for (size_t i = 0; i < buffers->size(); ++i) {
+      nlohmann::json& buffer = (*buffers)[i];
+      if (!buffer.is_object()) {
+        err = "malformed GLB buffer";
+        return false;
+      }
+      if (buffer.contains("uri")) {
+        continue;
+      }
+
+      // Only the first buffer can be the BIN chunk, others without a uri are
+      // meshopt fallbacks that decompression fills in
+      if (i == 0) {
+        auto length = buffer.find("byteLength");
+        if (length == buffer.end() || !length->is_number_unsigned()) {
+          err = "malformed GLB buffer";
+          return false;
+        }
+        uint64_t byte_length = length->get<uint64_t>();
+        if (byte_length > chunks.bin_size_) {
+          err = "GLB BIN chunk is missing or smaller than its buffer";
+          return false;
+        }
+        result.buffers_[0].data_ = chunks.bin_;
+        result.buffers_[0].size_ = byte_length;
+      }
+      buffer["uri"] = kPlaceholderUri;
+      buffer["byteLength"] = 1;
+      placeholder_buffers[i] = true;
+    }
+  }
+
+  auto views = json.find("bufferViews");
+  size_t view_count = views != json.end() && views->is_array() ? views->size() : 0;
+
+  std::vector<int32_t> image_views;
+  auto images = json.find("images");
+  if (images != json.end() && images->is_array()) {
+    image_views.assign(images->size(), -1);
+    for (size_t i = 0; i < images->size(); ++i) {
+      nlohmann::json& image = (*images)[i];
+      if (!image.is_object()) {
+        err = "malformed GLB image";
+        return false;
+      }
+      auto view = image.find("bufferView");
+      if (view == image.end()) {
+        continue;
+      }
+      if (!view->is_number_unsigned() || view->get<uint64_t>() >= view_count) {
+        err = "malformed GLB image";
+        return false;
+      }
+      image_views[i] = int32_t(view->get<uint64_t>());
+      image.erase("bufferView");
+      image["uri"] = kPlaceholderUri;
+    }
+  }
+
+  std::string text = json.dump();
+  if (!loader.LoadASCIIFromString(&model, &err, &warn, text.c_str(), text.size(), base_dir)) {
+    return false;
+  }
+
+  // Back to what tinygltf leaves behind for a GLB, minus the copies
+  for (size_t i = 0; i < image_views.size() && i < model.images.size(); ++i) {
+    if (image_views[i] >= 0) {
+      model.images[i].bufferView = image_views[i];
+      model.images[i].uri.clear();
+      model.images[i].image.clear();
+    }
+  }
+  for (size_t i = 0; i < placeholder_buffers.size() && i < model.buffers.size(); ++i) {
+    if (placeholder_buffers[i]) {
+      model.buffers[i].uri.clear();
+      model.buffers[i].data.clear();
+    }
+  }
+  return true;
+}
+
+static bool Load(
+  const std::string& name,
+  const uint8_t* data,
+  size_t size,
+  const std::string& base_dir,
+  ModelData& result,
+  DecodeStats* stats,
+  LinearArena* scratch
+) {
+  tinygltf::TinyGLTF loader;
+  loader.SetImageLoader(DeferImageDecode, nullptr);
+
+  tinygltf::Model model;
+  std::string err;
+  std::string warn;
+
+  Clock::time_point parse_start = Clock::now();
+  bool success = ParseGlb(loader, data, size, base_dir, model, result, err, warn);
+  if (stats) {
+    stats->parse_ms_ += ElapsedMs(parse_start);
+    stats->source_bytes_ += size;
+  }
+
+  if (success) {
+    success = Prepare(model, result, stats, err);
+  }
+
+  if (!ReportErrors(name, success, err, warn)) {
+    return false;
+  }
+
+  AssetDecoder::Decode(model, result, stats, scratch);
+  return true;
+}
+
+bool AssetDecoder::LoadFromFile(const std::string& filename, ModelData& result, DecodeStats* stats, LinearArena* scratch) {
+  MappedFile file;
+  if (!file.Open(filename)) {
+    std::cout << "[" << filename << "] ERROR: unable to map file" << std::endl;
+    return false;
+  }
+  // Everything but the images is read once, front to back, right away
+  file.Advise(0, file.GetSize(), MappedAccess::kSequential);
+  file.Advise(0, file.GetSize(), MappedAccess::kWillNeed);
+
+  ModelData data;
+  std::string base_dir = std::filesystem::path(filename).parent_path().string();
+  if (!Load(filename, file.GetData(), file.GetSize(), base_dir, data, stats, scratch)) {
+    return false;
+  }
+
+  data.source_ = std::move(file);
+  result = std::move(data);
+  return true;
+}
+
+bool AssetDecoder::LoadFromMemory(
+  const uint8_t* data, 
+  size_t size, 
+  ModelData& result, 
+  DecodeStats* stats, 
+  LinearArena* scratch
+) {
+  ModelData loaded;
+  if (!Load("memory", data, size, "", loaded, stats, scratch)) {
+    return false;
+  }
+
+  result = std::move(loaded);
+  return true;
+}
+
+const uint8_t* ModelData::GetEncodedImage(const TextureData& texture) const {
+  return buffers_[texture.buffer_].data_ + texture.offset_;
+}
+
+ImageDecodeQueue::ImageDecodeQueue(const ModelData& model, uint32_t thread_count) 
+  : model_(model), next_(0), returned_(0) {
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  thread_count = std::min<size_t>(thread_count, model_.textures_.size());
+
+  completed_.reserve(model_.textures_.size());
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    workers_.emplace_back(&ImageDecodeQueue::Work, this);
+  }
+}
+
+ImageDecodeQueue::~ImageDecodeQueue() {
+  next_ = model_.textures_.size();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+
+  for (size_t i = returned_; i < completed_.size(); ++i) {
+    Free(completed_[i]);
+  }
+}
+
+void ImageDecodeQueue::Work() {
+  size_t index = 0;
+  while ((index = next_.fetch_add(1)) < model_.textures_.size()) {
+    const TextureData& texture = model_.textures_[index];
+
+    DecodedImage image;
+    image.texture_ = index;
+    image.pixels_ = stbi_load_from_memory(
+      model_.GetEncodedImage(texture), 
+      texture.size_, 
+      &image.width_, 
+      &image.height_, 
+      &image.component_, 
+      texture.component_
+    );
+    image.component_ = texture.component_;
+
+    if (image.pixels_ == nullptr) {
+      std::cout << "[" << texture.name_ << "] ERROR: " << stbi_failure_reason() << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed_.push_back(image);
+    done_.notify_one();
+  }
+}
+
+bool ImageDecodeQueue::WaitNext(DecodedImage& image) {
+  if (returned_ == model_.textures_.size()) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]() { return completed_.size() > returned_; });
+  image = completed_[returned_++];
+  return true;
+}
+
+void ImageDecodeQueue::Free(DecodedImage& image) {
+  stbi_image_free(image.pixels_);
+  image.pixels_ = nullptr;
+}
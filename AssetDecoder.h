@@ -0,0 +1,242 @@
+#ifndef ASSET_DECODER_H_
+#define ASSET_DECODER_H_
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <vector>
+#include <string>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include <tiny_gltf.h>
+
+#include "LinearArena.h"
+#include "MappedFile.h"
+
+// CPU side of model loading. Nothing in here touches GL, so it can be
+// benchmarked and exercised without a context.
+
+// CPU copy of a vertex, for bounds, occluders and picking. Quantized and
+// normalized attributes are expanded to float here, the GPU gets them as
+// stored, see VertexLayout.
+struct Vertex {
+  glm::vec3 pos_;
+  glm::vec2 tex_coords_;
+  glm::vec3 normal_;
+  glm::ivec4 joints_;
+  glm::vec4 weights_;
+};
+
+// Attributes by shader location
+constexpr uint32_t kAttributePosition = 0;
+constexpr uint32_t kAttributeTexCoord = 1;
+constexpr uint32_t kAttributeNormal = 2;
+constexpr uint32_t kAttributeJoints = 3;
+constexpr uint32_t kAttributeWeights = 4;
+constexpr uint32_t kAttributeCount = 5;
+
+// Positions, joints and weights go in one stream so depth-only passes
+// fetch nothing else, texcoords and normals in the other
+constexpr uint32_t kStreamPosition = 0;
+constexpr uint32_t kStreamShading = 1;
+constexpr uint32_t kStreamCount = 2;
+
+struct VertexAttributeFormat {
+  // Component type, glTF uses the GL enums. 0 when the primitive has none.
+  uint32_t type_ = 0;
+  int32_t components_ = 0;
+  bool normalized_ = false;
+
+  uint32_t stream_ = kStreamPosition;
+  uint32_t offset_ = 0;
+};
+
+// Where each attribute sits in the interleaved vertex streams
+struct VertexLayout {
+  VertexAttributeFormat attributes_[kAttributeCount];
+  uint32_t strides_[kStreamCount] = {};
+};
+
+struct Aabb {
+  glm::vec3 min_;
+  glm::vec3 max_;
+};
+
+struct Joint {
+  glm::mat4 transform_;
+  std::vector<Joint> children_;
+};
+
+struct Skin {
+  Joint root_;
+  std::vector<glm::mat4> inverse_bind_matrices_;
+};
+
+// Images stay compressed until ImageDecodeQueue gets to them. The encoded
+// bytes are a view into ModelData::buffers_.
+struct TextureData {
+  std::string name_;
+
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+  int32_t component_ = 0;
+
+  int32_t buffer_ = -1;
+  size_t offset_ = 0;
+  size_t size_ = 0;
+
+  int32_t wrap_s_ = 0;
+  int32_t wrap_t_ = 0;
+  int32_t min_filter_ = 0;
+  int32_t mag_filter_ = 0;
+};
+
+// What drawing a primitive takes beyond positions and a base color. Each
+// bit is a shader variant define, see ShaderVariants.
+constexpr uint32_t kFeatureSkinned = 1 << 0;
+constexpr uint32_t kFeatureTextured = 1 << 1;
+constexpr uint32_t kFeatureCount = 2;
+
+struct MaterialData {
+  // Index into ModelData::textures_, -1 when untextured
+  int32_t texture_ = -1;
+  glm::vec4 color_ = glm::vec4(0.0, 0.0, 0.0, 1.0);
+};
+
+// Vertex and index data come from the scratch arena passed to the decoder,
+// they only need to live until upload
+struct PrimitiveData {
+  ArenaVector<Vertex> vertices_;
+  ArenaVector<uint8_t> indices_;
+
+  // What gets uploaded, attributes in the type the file stores them in
+  VertexLayout layout_;
+  ArenaVector<uint8_t> streams_[kStreamCount];
+
+  uint32_t index_count_;
+  uint32_t index_type_;
+
+  // Of the bind pose, in mesh space
+  Aabb bounds_;
+
+  std::optional<MaterialData> material_;
+  uint32_t features_ = 0;
+};
+
+struct MeshData {
+  std::vector<PrimitiveData> primitives_;
+  glm::mat4 local_transform_;
+};
+
+// Bytes of one glTF buffer, in ModelData::storage_ or in whatever the
+// model was loaded from
+struct ModelBuffer {
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  // Index into ModelData::storage_, -1 when the bytes aren't owned
+  int32_t storage_ = -1;
+};
+
+struct ModelData {
+  std::vector<MeshData> meshes_;
+  std::vector<Skin> skins_;
+  std::vector<TextureData> textures_;
+
+  std::vector<ModelBuffer> buffers_;
+  // Buffers that had to be copied or decompressed
+  std::vector<std::vector<uint8_t>> storage_;
+  // GLB files are mapped rather than read, the BIN chunk is used in place.
+  // Dropping the ModelData unmaps it.
+  MappedFile source_;
+
+  const uint8_t* GetEncodedImage(const TextureData& texture) const;
+};
+
+// Wall time spent in each decode stage, in milliseconds
+struct DecodeStats {
+  double parse_ms_ = 0.0;
+  // EXT_meshopt_compression buffer views
+  double decompress_ms_ = 0.0;
+  double accessor_ms_ = 0.0;
+  double vertex_ms_ = 0.0;
+  double skin_ms_ = 0.0;
+  // Filled by whoever drains the ImageDecodeQueue
+  double image_ms_ = 0.0;
+
+  size_t source_bytes_ = 0;
+  size_t vertex_count_ = 0;
+
+  double TotalMs() const;
+};
+
+class AssetDecoder {
+public:
+  // Transient decode data is taken from scratch when given, the heap otherwise.
+  // Only the JSON chunk of a GLB is parsed, buffers stored in the BIN chunk
+  // point into the file or into data and are never copied, so data has to
+  // outlive result.
+  static bool LoadFromFile(
+    const std::string& filename, 
+    ModelData& result, 
+    DecodeStats* stats = nullptr, 
+    LinearArena* scratch = nullptr
+  );
+  static bool LoadFromMemory(
+    const uint8_t* data, 
+    size_t size, 
+    ModelData& result, 
+    DecodeStats* stats = nullptr, 
+    LinearArena* scratch = nullptr
+  );
+
+  // Buffers already in result are read in place, the model's own are moved
+  // out of it rather than copied
+  static void Decode(
+    tinygltf::Model& model,
+    ModelData& result,
+    DecodeStats* stats = nullptr,
+    LinearArena* scratch = nullptr
+  );
+};
+
+struct DecodedImage {
+  int32_t texture_;
+  int32_t width_;
+  int32_t height_;
+  int32_t component_;
+  // Owned by stb_image, release with ImageDecodeQueue::Free
+  uint8_t* pixels_;
+};
+
+// Decodes every texture of a model on worker threads and hands the results
+// back in completion order, so uploads can start as soon as the first image
+// is ready. The model data must outlive the queue.
+class ImageDecodeQueue {
+public:
+  explicit ImageDecodeQueue(const ModelData& model, uint32_t thread_count = 0);
+  ~ImageDecodeQueue();
+
+  // Blocks until another image is done, false once every image was returned
+  bool WaitNext(DecodedImage& image);
+
+  static void Free(DecodedImage& image);
+private:
+  void Work();
+private:
+  const ModelData& model_;
+
+  std::vector<std::thread> workers_;
+  std::atomic<size_t> next_;
+
+  std::mutex mutex_;
+  std::condition_variable done_;
+  std::vector<DecodedImage> completed_;
+  size_t returned_;
+};
+
+#endif
@@ -0,0 +1,748 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <cassert>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+constexpr uint32_t kBinCount = 16;
+// Past this depth splits fall back to the median, which bounds the depth
+// traversal stacks have to handle
+constexpr uint32_t kMaxSahDepth = 64;
+constexpr uint32_t kStackSize = 128;
+// Subtrees smaller than this aren't worth a thread of their own
+constexpr uint32_t kMinParallelItems = 1024;
+
+static float SurfaceArea(const Aabb& box) {
+  glm::vec3 d = box.max_ - box.min_;
+  return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static Aabb EmptyAabb() {
+  return Aabb { glm::vec3(1e30f), glm::vec3(-1e30f) };
+}
+
+static void Grow(Aabb& box, const Aabb& other) {
+  box.min_ = glm::min(box.min_, other.min_);
+  box.max_ = glm::max(box.max_, other.max_);
+}
+
+static void Grow(Aabb& box, const glm::vec3& point) {
+  box.min_ = glm::min(box.min_, point);
+  box.max_ = glm::max(box.max_, point);
+}
+
+struct BuildInput {
+  const Aabb* bounds_;
+  std::vector<glm::vec3> centroids_;
+  uint32_t* order_;
+  uint32_t max_leaf_size_;
+};
+
+struct BuildTask {
+  uint32_t node_;
+  uint32_t begin_;
+  uint32_t end_;
+  uint32_t depth_;
+};
+
+static void SetBounds(BvhNode& node, const Aabb& box) {
+  for (int32_t axis = 0; axis < 3; ++axis) {
+    node.min_[axis] = box.min_[axis];
+    node.max_[axis] = box.max_[axis];
+  }
+}
+
+// Picks the cheapest of the binned SAH splits along every axis. Returns the
+// first item of the right half, or end when the range should be a leaf.
+static uint32_t Split(const BuildInput& input, uint32_t begin, uint32_t end, uint32_t depth, Aabb& node_bounds) {
+  uint32_t* order = input.order_;
+
+  node_bounds = EmptyAabb();
+  Aabb centroid_bounds = EmptyAabb();
+  for (uint32_t i = begin; i < end; ++i) {
+    Grow(node_bounds, input.bounds_[order[i]]);
+    Grow(centroid_bounds, input.centroids_[order[i]]);
+  }
+
+  uint32_t count = end - begin;
+  if (count <= 1) {
+    return end;
+  }
+
+  float best_cost = 1e30f;
+  int32_t best_axis = -1;
+  uint32_t best_bin = 0;
+
+  if (depth < kMaxSahDepth) {
+    for (int32_t axis = 0; axis < 3; ++axis) {
+      float extent = centroid_bounds.max_[axis] - centroid_bounds.min_[axis];
+      if (extent <= 0.0f) {
+        continue;
+      }
+      float scale = kBinCount / extent;
+
+      Aabb bins[kBinCount];
+      uint32_t counts[kBinCount] = {};
+      std::fill(bins, bins + kBinCount, EmptyAabb());
+
+      for (uint32_t i = begin; i < end; ++i) {
+        uint32_t bin = std::min(uint32_t((input.centroids_[order[i]][axis] - centroid_bounds.min_[axis]) * scale), kBinCount - 1);
+        Grow(bins[bin], input.bounds_[order[i]]);
+        ++counts[bin];
+      }
+
+      // Right-to-left sweep first, then evaluate every plane on the way back
+      float right_area[kBinCount];
+      uint32_t right_count[kBinCount];
+      Aabb right = EmptyAabb();
+      uint32_t right_total = 0;
+      for (uint32_t bin = kBinCount - 1; bin > 0; --bin) {
+        Grow(right, bins[bin]);
+        right_total += counts[bin];
+        right_area[bin] = right_total > 0 ? SurfaceArea(right) : 0.0f;
+        right_count[bin] = right_total;
+      }
+
+      Aabb left = EmptyAabb();
+      uint32_t left_total = 0;
+      for (uint32_t bin = 1; bin < kBinCount; ++bin) {
+        Grow(left, bins[bin - 1]);
+        left_total += counts[bin - 1];
+        if (left_total == 0 || right_count[bin] == 0) {
+          continue;
+        }
+        float cost = left_total * SurfaceArea(left) + right_count[bin] * right_area[bin];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = bin;
+        }
+      }
+    }
+  }
+
+  // Leaf cost is one intersection per item, traversal about as much as one
+  float parent_area = SurfaceArea(node_bounds);
+  float split_cost = parent_area > 0.0f ? 1.0f + best_cost / parent_area : 1e30f;
+  if (count <= input.max_leaf_size_ && (best_axis < 0 || split_cost >= float(count))) {
+    return end;
+  }
+
+  uint32_t mid = begin + count / 2;
+  if (best_axis >= 0) {
+    float min = centroid_bounds.min_[best_axis];
+    float scale = kBinCount / (centroid_bounds.max_[best_axis] - min);
+    uint32_t* split = std::partition(order + begin, order + end, [&](uint32_t item) {
+      return std::min(uint32_t((input.centroids_[item][best_axis] - min) * scale), kBinCount - 1) < best_bin;
+    });
+    mid = uint32_t(split - order);
+  }
+
+  if (mid == begin || mid == end) {
+    // Identical centroids, any split is as good as another
+    int32_t axis = 0;
+    glm::vec3 extent = centroid_bounds.max_ - centroid_bounds.min_;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    mid = begin + count / 2;
+    std::nth_element(order + begin, order + mid, order + end, [&](uint32_t a, uint32_t b) {
+      return input.centroids_[a][axis] < input.centroids_[b][axis];
+    });
+  }
+  return mid;
+}
+
+static void BuildRecursive(const BuildInput& input, std::vector<BvhNode>& nodes, const BuildTask& task) {
+  Aabb box;
+  uint32_t mid = Split(input, task.begin_, task.end_, task.depth_, box);
+  SetBounds(nodes[task.node_], box);
+
+  if (mid == task.end_) {
+    nodes[task.node_].first_ = task.begin_;
+    nodes[task.node_].count_ = task.end_ - task.begin_;
+    return;
+  }
+
+  uint32_t left = nodes.size();
+  nodes.resize(left + 2);
+  nodes[task.node_].first_ = left;
+  nodes[task.node_].count_ = 0;
+
+  BuildRecursive(input, nodes, BuildTask { left, task.begin_, mid, task.depth_ + 1 });
+  BuildRecursive(input, nodes, BuildTask { left + 1, mid, task.end_, task.depth_ + 1 });
+}
+
+void BvhBuilder::Build(
+  const Aabb* bounds,
+  size_t count,
+  uint32_t max_leaf_size,
+  uint32_t thread_count,
+  std::vector<BvhNode>& nodes,
+  std::vector<uint32_t>& order
+) {
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  order.resize(count);
+  std::iota(order.begin(), order.end(), 0);
+
+  BuildInput input { bounds, std::vector<glm::vec3>(count), order.data(), max_leaf_size };
+  for (size_t i = 0; i < count; ++i) {
+    input.centroids_[i] = (bounds[i].min_ + bounds[i].max_) * 0.5f;
+  }
+
+  nodes.clear();
+  nodes.reserve(count > 0 ? count * 2 - 1 : 1);
+  nodes.push_back(BvhNode {});
+
+  if (count == 0) {
+    SetBounds(nodes[0], EmptyAabb());
+    return;
+  }
+
+  // Top levels breadth first on this thread until every open range is
+  // small enough to hand out as a task of its own
+  std::vector<BuildTask> open { BuildTask { 0, 0, uint32_t(count), 0 } };
+  std::vector<BuildTask> pending;
+  uint32_t task_size = std::max<uint32_t>(count / (thread_count * 4), kMinParallelItems);
+
+  while (!open.empty() && thread_count > 1) {
+    BuildTask task = open.back();
+    open.pop_back();
+
+    if (task.end_ - task.begin_ <= task_size) {
+      pending.push_back(task);
+      continue;
+    }
+
+    Aabb box;
+    uint32_t mid = Split(input, task.begin_, task.end_, task.depth_, box);
+    SetBounds(nodes[task.node_], box);
+    if (mid == task.end_) {
+      nodes[task.node_].first_ = task.begin_;
+      nodes[task.node_].count_ = task.end_ - task.begin_;
+      continue;
+    }
+
+    uint32_t left = nodes.size();
+    nodes.resize(left + 2);
+    nodes[task.node_].first_ = left;
+    nodes[task.node_].count_ = 0;
+    open.push_back(BuildTask { left, task.begin_, mid, task.depth_ + 1 });
+    open.push_back(BuildTask { left + 1, mid, task.end_, task.depth_ + 1 });
+  }
+  pending.insert(pending.end(), open.begin(), open.end());
+
+  // Every task owns a disjoint range of order and builds into its own node
+  // list, with its root at index 0
+  std::vector<std::vector<BvhNode>> subtrees(pending.size());
+  std::atomic<size_t> next { 0 };
+  auto work = [&] {
+    for (size_t i = next++; i < pending.size(); i = next++) {
+      subtrees[i].push_back(BvhNode {});
+      BuildTask local = pending[i];
+      local.node_ = 0;
+      BuildRecursive(input, subtrees[i], local);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  uint32_t worker_count = std::min<size_t>(thread_count, pending.size());
+  for (uint32_t i = 1; i < worker_count; ++i) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  // Splice each subtree in: its root replaces the placeholder, the rest is
+  // appended and child indices shifted to match
+  for (size_t i = 0; i < pending.size(); ++i) {
+    const std::vector<BvhNode>& subtree = subtrees[i];
+    uint32_t base = nodes.size();
+    auto remap = [&](BvhNode node) {
+      if (node.count_ == 0) {
+        node.first_ = base + node.first_ - 1;
+      }
+      return node;
+    };
+
+    nodes[pending[i].node_] = remap(subtree[0]);
+    for (size_t n = 1; n < subtree.size(); ++n) {
+      nodes.push_back(remap(subtree[n]));
+    }
+  }
+}
+
+// Scalar tests, used by single rays and where SSE2 isn't available
+
+static bool IntersectBox(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverse, float max_distance, float& entry) {
+  float t_min = 0.0f;
+  float t_max = max_distance;
+  for (int32_t axis = 0; axis < 3; ++axis) {
+    float t0 = (node.min_[axis] - origin[axis]) * inverse[axis];
+    float t1 = (node.max_[axis] - origin[axis]) * inverse[axis];
+    t_min = std::max(t_min, std::min(t0, t1));
+    t_max = std::min(t_max, std::max(t0, t1));
+  }
+  entry = t_min;
+  return t_min <= t_max;
+}
+
+template <typename Triangle>
+static bool IntersectTriangle(const Triangle& triangle, const glm::vec3& origin, const glm::vec3& direction, float& t, float& u, float& v) {
+  glm::vec3 p = glm::cross(direction, triangle.edge2_);
+  float det = glm::dot(triangle.edge1_, p);
+  if (std::fabs(det) < 1e-12f) {
+    return false;
+  }
+  float inverse_det = 1.0f / det;
+
+  glm::vec3 s = origin - triangle.v0_;
+  u = glm::dot(s, p) * inverse_det;
+  if (u < 0.0f || u > 1.0f) {
+    return false;
+  }
+
+  glm::vec3 q = glm::cross(s, triangle.edge1_);
+  v = glm::dot(direction, q) * inverse_det;
+  if (v < 0.0f || u + v > 1.0f) {
+    return false;
+  }
+
+  t = glm::dot(triangle.edge2_, q) * inverse_det;
+  return t > 0.0f;
+}
+
+static glm::vec3 SafeInverse(const glm::vec3& direction) {
+  glm::vec3 inverse;
+  for (int32_t axis = 0; axis < 3; ++axis) {
+    inverse[axis] = direction[axis] != 0.0f ? 1.0f / direction[axis] : 1e30f;
+  }
+  return inverse;
+}
+
+// Visits leaves near to far, visit(node) returns the updated max distance
+template <typename Visit>
+static void Traverse(const std::vector<BvhNode>& nodes, const glm::vec3& origin, const glm::vec3& direction, float max_distance, Visit&& visit) {
+  glm::vec3 inverse = SafeInverse(direction);
+
+  float entry = 0.0f;
+  if (!IntersectBox(nodes[0], origin, inverse, max_distance, entry)) {
+    return;
+  }
+
+  uint32_t stack[kStackSize];
+  uint32_t size = 0;
+  uint32_t current = 0;
+  while (true) {
+    const BvhNode& node = nodes[current];
+    if (node.count_ > 0) {
+      max_distance = visit(node, max_distance);
+    } else {
+      float left_entry = 0.0f;
+      float right_entry = 0.0f;
+      bool left = IntersectBox(nodes[node.first_], origin, inverse, max_distance, left_entry);
+      bool right = IntersectBox(nodes[node.first_ + 1], origin, inverse, max_distance, right_entry);
+
+      if (left && right) {
+        bool left_first = left_entry <= right_entry;
+        stack[size++] = left_first ? node.first_ + 1 : node.first_;
+        current = left_first ? node.first_ : node.first_ + 1;
+        continue;
+      }
+      if (left || right) {
+        current = left ? node.first_ : node.first_ + 1;
+        continue;
+      }
+    }
+
+    if (size == 0) {
+      return;
+    }
+    current = stack[--size];
+  }
+}
+
+void TriangleBvh::Build(const glm::vec3* positions, const uint32_t* indices, size_t triangle_count, uint32_t thread_count) {
+  std::vector<Aabb> bounds(triangle_count);
+  for (size_t i = 0; i < triangle_count; ++i) {
+    bounds[i] = EmptyAabb();
+    for (int32_t corner = 0; corner < 3; ++corner) {
+      Grow(bounds[i], positions[indices[i * 3 + corner]]);
+    }
+  }
+
+  std::vector<uint32_t> order;
+  BvhBuilder::Build(bounds.data(), triangle_count, 4, thread_count, nodes_, order);
+
+  triangles_.resize(triangle_count);
+  for (size_t i = 0; i < triangle_count; ++i) {
+    uint32_t triangle = order[i];
+    glm::vec3 v0 = positions[indices[triangle * 3 + 0]];
+    glm::vec3 v1 = positions[indices[triangle * 3 + 1]];
+    glm::vec3 v2 = positions[indices[triangle * 3 + 2]];
+    triangles_[i] = Triangle { v0, v1 - v0, v2 - v0, triangle };
+  }
+}
+
+bool TriangleBvh::Intersect(const Ray& ray, RayHit& hit) const {
+  // An empty root is neither a leaf nor has children to visit
+  if (triangles_.empty()) {
+    return false;
+  }
+
+  bool found = false;
+  float max_distance = std::min(ray.max_distance_, hit.distance_);
+
+  Traverse(nodes_, ray.origin_, ray.direction_, max_distance, [&](const BvhNode& leaf, float closest) {
+    for (uint32_t i = leaf.first_; i < leaf.first_ + leaf.count_; ++i) {
+      float t = 0.0f;
+      float u = 0.0f;
+      float v = 0.0f;
+      if (IntersectTriangle(triangles_[i], ray.origin_, ray.direction_, t, u, v) && t < closest) {
+        closest = t;
+        hit.distance_ = t;
+        hit.triangle_ = triangles_[i].index_;
+        hit.u_ = u;
+        hit.v_ = v;
+        found = true;
+      }
+    }
+    return closest;
+  });
+  return found;
+}
+
+// Four rays in SoA form. Lanes past the end of a batch are masked off.
+struct TriangleBvh::Packet {
+  alignas(16) float origin_[3][4];
+  alignas(16) float direction_[3][4];
+  alignas(16) float inverse_[3][4];
+  alignas(16) float max_[4];
+  int32_t lanes_;
+};
+
+// Bit per lane whose ray enters the box before its current closest hit
+static int32_t IntersectBox(const TriangleBvh::Packet& packet, const BvhNode& node) {
+#if defined(__SSE2__)
+  __m128 t_min = _mm_setzero_ps();
+  __m128 t_max = _mm_load_ps(packet.max_);
+  for (int32_t axis = 0; axis < 3; ++axis) {
+    __m128 origin = _mm_load_ps(packet.origin_[axis]);
+    __m128 inverse = _mm_load_ps(packet.inverse_[axis]);
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min_[axis]), origin), inverse);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max_[axis]), origin), inverse);
+    t_min = _mm_max_ps(t_min, _mm_min_ps(t0, t1));
+    t_max = _mm_min_ps(t_max, _mm_max_ps(t0, t1));
+  }
+  return _mm_movemask_ps(_mm_cmple_ps(t_min, t_max)) & packet.lanes_;
+#else
+  int32_t mask = 0;
+  for (int32_t lane = 0; lane < 4; ++lane) {
+    float t_min = 0.0f;
+    float t_max = packet.max_[lane];
+    for (int32_t axis = 0; axis < 3; ++axis) {
+      float t0 = (node.min_[axis] - packet.origin_[axis][lane]) * packet.inverse_[axis][lane];
+      float t1 = (node.max_[axis] - packet.origin_[axis][lane]) * packet.inverse_[axis][lane];
+      t_min = std::max(t_min, std::min(t0, t1));
+      t_max = std::min(t_max, std::max(t0, t1));
+    }
+    mask |= t_min <= t_max ? 1 << lane : 0;
+  }
+  return mask & packet.lanes_;
+#endif
+}
+
+template <typename Triangle>
+static void IntersectTriangle(
+  TriangleBvh::Packet& packet,
+  const Triangle& triangle,
+  int32_t mask,
+  RayHit* hits,
+  uint32_t instance
+) {
+#if defined(__SSE2__)
+  __m128 dx = _mm_load_ps(packet.direction_[0]);
+  __m128 dy = _mm_load_ps(packet.direction_[1]);
+  __m128 dz = _mm_load_ps(packet.direction_[2]);
+
+  __m128 e1x = _mm_set1_ps(triangle.edge1_.x);
+  __m128 e1y = _mm_set1_ps(triangle.edge1_.y);
+  __m128 e1z = _mm_set1_ps(triangle.edge1_.z);
+  __m128 e2x = _mm_set1_ps(triangle.edge2_.x);
+  __m128 e2y = _mm_set1_ps(triangle.edge2_.y);
+  __m128 e2z = _mm_set1_ps(triangle.edge2_.z);
+
+  // p = d x e2
+  __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+  __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+  __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+  __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+  __m128 inverse_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+  // s = o - v0
+  __m128 sx = _mm_sub_ps(_mm_load_ps(packet.origin_[0]), _mm_set1_ps(triangle.v0_.x));
+  __m128 sy = _mm_sub_ps(_mm_load_ps(packet.origin_[1]), _mm_set1_ps(triangle.v0_.y));
+  __m128 sz = _mm_sub_ps(_mm_load_ps(packet.origin_[2]), _mm_set1_ps(triangle.v0_.z));
+  __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse_det);
+
+  // q = s x e1
+  __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+  __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+  __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+  __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse_det);
+  __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse_det);
+
+  __m128 zero = _mm_setzero_ps();
+  __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+  __m128 inside = _mm_and_ps(
+    _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)),
+    _mm_and_ps(_mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)), _mm_cmpge_ps(abs_det, _mm_set1_ps(1e-12f))));
+  inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, _mm_load_ps(packet.max_))));
+
+  int32_t hit_mask = _mm_movemask_ps(inside) & mask;
+  if (hit_mask == 0) {
+    return;
+  }
+
+  alignas(16) float ts[4];
+  alignas(16) float us[4];
+  alignas(16) float vs[4];
+  _mm_store_ps(ts, t);
+  _mm_store_ps(us, u);
+  _mm_store_ps(vs, v);
+  for (int32_t lane = 0; lane < 4; ++lane) {
+    if (hit_mask & (1 << lane)) {
+      packet.max_[lane] = ts[lane];
+      hits[lane] = RayHit { ts[lane], triangle.index_, us[lane], vs[lane], instance };
+    }
+  }
+#else
+  for (int32_t lane = 0; lane < 4; ++lane) {
+    if ((mask & (1 << lane)) == 0) {
+      continue;
+    }
+    glm::vec3 origin(packet.origin_[0][lane], packet.origin_[1][lane], packet.origin_[2][lane]);
+    glm::vec3 direction(packet.direction_[0][lane], packet.direction_[1][lane], packet.direction_[2][lane]);
+    float t = 0.0f;
+    float u = 0.0f;
+    float v = 0.0f;
+    if (IntersectTriangle(triangle, origin, direction, t, u, v) && t < packet.max_[lane]) {
+      packet.max_[lane] = t;
+      hits[lane] = RayHit { t, triangle.index_, u, v, instance };
+    }
+  }
+#endif
+}
+
+static void LoadPacket(TriangleBvh::Packet& packet, const Ray* rays, const RayHit* hits, size_t count) {
+  packet.lanes_ = 0;
+  for (size_t lane = 0; lane < 4; ++lane) {
+    // Unused lanes repeat the last ray and stay masked off
+    const Ray& ray = rays[std::min(lane, count - 1)];
+    glm::vec3 inverse = SafeInverse(ray.direction_);
+    for (int32_t axis = 0; axis < 3; ++axis) {
+      packet.origin_[axis][lane] = ray.origin_[axis];
+      packet.direction_[axis][lane] = ray.direction_[axis];
+      packet.inverse_[axis][lane] = inverse[axis];
+    }
+    packet.max_[lane] = std::min(ray.max_distance_, hits[std::min(lane, count - 1)].distance_);
+    packet.lanes_ |= lane < count ? 1 << lane : 0;
+  }
+}
+
+// Any-lane traversal: a node is entered when at least one ray still wants it
+void TriangleBvh::IntersectPacket(Packet& packet, RayHit* hits, uint32_t instance) const {
+  if (triangles_.empty() || IntersectBox(packet, nodes_[0]) == 0) {
+    return;
+  }
+
+  uint32_t stack[kStackSize];
+  uint32_t size = 0;
+  stack[size++] = 0;
+  while (size > 0) {
+    const BvhNode& node = nodes_[stack[--size]];
+    int32_t mask = IntersectBox(packet, node);
+    if (mask == 0) {
+      continue;
+    }
+
+    if (node.count_ > 0) {
+      for (uint32_t i = node.first_; i < node.first_ + node.count_; ++i) {
+        IntersectTriangle(packet, triangles_[i], mask, hits, instance);
+      }
+    } else {
+      stack[size++] = node.first_ + 1;
+      stack[size++] = node.first_;
+    }
+  }
+}
+
+void TriangleBvh::IntersectBatch(const Ray* rays, size_t count, RayHit* hits) const {
+  for (size_t first = 0; first < count; first += 4) {
+    size_t lanes = std::min<size_t>(count - first, 4);
+
+    Packet packet;
+    LoadPacket(packet, rays + first, hits + first, lanes);
+
+    RayHit packet_hits[4];
+    std::copy(hits + first, hits + first + lanes, packet_hits);
+    IntersectPacket(packet, packet_hits, RayHit::kNone);
+    std::copy(packet_hits, packet_hits + lanes, hits + first);
+  }
+}
+
+Aabb TriangleBvh::GetBounds() const {
+  if (triangles_.empty()) {
+    return EmptyAabb();
+  }
+
+  const BvhNode& root = nodes_[0];
+  return Aabb {
+    glm::vec3(root.min_[0], root.min_[1], root.min_[2]),
+    glm::vec3(root.max_[0], root.max_[1], root.max_[2]),
+  };
+}
+
+size_t TriangleBvh::GetNodeCount() const {
+  return nodes_.size();
+}
+
+size_t TriangleBvh::GetTriangleCount() const {
+  return triangles_.size();
+}
+
+static Aabb Transform(const Aabb& box, const glm::mat4& transform) {
+  Aabb result = EmptyAabb();
+  for (int32_t corner = 0; corner < 8; ++corner) {
+    glm::vec3 point(
+      corner & 1 ? box.max_.x : box.min_.x,
+      corner & 2 ? box.max_.y : box.min_.y,
+      corner & 4 ? box.max_.z : box.min_.z);
+    Grow(result, glm::vec3(transform * glm::vec4(point, 1.0f)));
+  }
+  return result;
+}
+
+void InstanceBvh::Build(const BvhInstance* instances, size_t count) {
+  // Instances of empty BVHs can't be hit and have no bounds to sort by
+  std::vector<uint32_t> sources;
+  std::vector<Aabb> bounds;
+  for (size_t i = 0; i < count; ++i) {
+    if (instances[i].bvh_->GetTriangleCount() > 0) {
+      sources.push_back(uint32_t(i));
+      bounds.push_back(Transform(instances[i].bvh_->GetBounds(), instances[i].transform_));
+    }
+  }
+
+  std::vector<uint32_t> order;
+  BvhBuilder::Build(bounds.data(), bounds.size(), 1, 1, nodes_, order);
+
+  instances_.resize(bounds.size());
+  for (size_t i = 0; i < bounds.size(); ++i) {
+    uint32_t source = sources[order[i]];
+    const BvhInstance& instance = instances[source];
+    instances_[i] = Instance { instance.bvh_, glm::inverse(instance.transform_), source };
+  }
+}
+
+bool InstanceBvh::Intersect(const Ray& ray, RayHit& hit) const {
+  if (instances_.empty()) {
+    return false;
+  }
+
+  bool found = false;
+  float max_distance = std::min(ray.max_distance_, hit.distance_);
+
+  Traverse(nodes_, ray.origin_, ray.direction_, max_distance, [&](const BvhNode& leaf, float closest) {
+    for (uint32_t i = leaf.first_; i < leaf.first_ + leaf.count_; ++i) {
+      const Instance& instance = instances_[i];
+
+      // The direction isn't renormalized, so distances stay in world units
+      Ray local;
+      local.origin_ = glm::vec3(instance.inverse_ * glm::vec4(ray.origin_, 1.0f));
+      local.direction_ = glm::vec3(instance.inverse_ * glm::vec4(ray.direction_, 0.0f));
+      local.max_distance_ = closest;
+
+      if (instance.bvh_->Intersect(local, hit)) {
+        closest = hit.distance_;
+        hit.instance_ = instance.index_;
+        found = true;
+      }
+    }
+    return closest;
+  });
+  return found;
+}
+
+void InstanceBvh::IntersectBatch(const Ray* rays, size_t count, RayHit* hits) const {
+  using Packet = TriangleBvh::Packet;
+
+  if (instances_.empty()) {
+    return;
+  }
+
+  for (size_t first = 0; first < count; first += 4) {
+    size_t lanes = std::min<size_t>(count - first, 4);
+
+    Packet packet;
+    LoadPacket(packet, rays + first, hits + first, lanes);
+
+    RayHit packet_hits[4];
+    std::copy(hits + first, hits + first + lanes, packet_hits);
+
+    uint32_t stack[kStackSize];
+    uint32_t size = 0;
+    stack[size++] = 0;
+    while (size > 0) {
+      const BvhNode& node = nodes_[stack[--size]];
+      if (IntersectBox(packet, node) == 0) {
+        continue;
+      }
+
+      if (node.count_ == 0) {
+        stack[size++] = node.first_ + 1;
+        stack[size++] = node.first_;
+        continue;
+      }
+
+      for (uint32_t i = node.first_; i < node.first_ + node.count_; ++i) {
+        const Instance& instance = instances_[i];
+
+        Packet local = packet;
+        for (int32_t lane = 0; lane < 4; ++lane) {
+          glm::vec3 origin(packet.origin_[0][lane], packet.origin_[1][lane], packet.origin_[2][lane]);
+          glm::vec3 direction(packet.direction_[0][lane], packet.direction_[1][lane], packet.direction_[2][lane]);
+          origin = glm::vec3(instance.inverse_ * glm::vec4(origin, 1.0f));
+          direction = glm::vec3(instance.inverse_ * glm::vec4(direction, 0.0f));
+          glm::vec3 inverse = SafeInverse(direction);
+          for (int32_t axis = 0; axis < 3; ++axis) {
+            local.origin_[axis][lane] = origin[axis];
+            local.direction_[axis][lane] = direction[axis];
+            local.inverse_[axis][lane] = inverse[axis];
+          }
+        }
+
+        instance.bvh_->IntersectPacket(local, packet_hits, instance.index_);
+        std::copy(local.max_, local.max_ + 4, packet.max_);
+      }
+    }
+
+    std::copy(packet_hits, packet_hits + lanes, hits + first);
+  }
+}
+
+size_t InstanceBvh::GetInstanceCount() const {
+  return instances_.size();
+}
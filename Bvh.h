@@ -0,0 +1,129 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "AssetDecoder.h"
+
+struct Ray {
+  glm::vec3 origin_;
+  // Doesn't need to be normalized, distances are in multiples of it
+  glm::vec3 direction_;
+  float max_distance_ = 1e30f;
+};
+
+struct RayHit {
+  constexpr static uint32_t kNone = ~0u;
+
+  float distance_ = 1e30f;
+  // Index into the source index list divided by three
+  uint32_t triangle_ = kNone;
+  // Barycentrics of vertices 1 and 2
+  float u_ = 0.0f;
+  float v_ = 0.0f;
+  // Set by InstanceBvh
+  uint32_t instance_ = kNone;
+
+  bool IsHit() const {
+    return triangle_ != kNone;
+  }
+};
+
+// Binary BVH node, 32 bytes. Children of an interior node are adjacent.
+struct BvhNode {
+  float min_[3];
+  // Leaf: first item, interior: left child
+  uint32_t first_;
+  float max_[3];
+  // Items in a leaf, 0 for interior nodes
+  uint32_t count_;
+};
+
+// Binned SAH builder shared by both levels. Fills nodes and the order the
+// items end up in the leaves. Subtrees below the top few splits are built
+// on threads once they hold enough items to be worth it.
+class BvhBuilder {
+public:
+  static void Build(
+    const Aabb* bounds,
+    size_t count,
+    uint32_t max_leaf_size,
+    uint32_t thread_count,
+    std::vector<BvhNode>& nodes,
+    std::vector<uint32_t>& order
+  );
+};
+
+// BVH over the triangles of one primitive, in the primitive's space.
+//
+// Intersect finds the closest hit of one ray. IntersectBatch traces four
+// rays at a time through the tree together, which pays off when the rays
+// are coherent (picking, shadow and visibility rays from one origin).
+class TriangleBvh {
+public:
+  // thread_count 0 uses every hardware thread
+  void Build(const glm::vec3* positions, const uint32_t* indices, size_t triangle_count, uint32_t thread_count = 0);
+
+  // Only replaces hit when it finds something closer
+  bool Intersect(const Ray& ray, RayHit& hit) const;
+  void IntersectBatch(const Ray* rays, size_t count, RayHit* hits) const;
+
+  Aabb GetBounds() const;
+  size_t GetNodeCount() const;
+  size_t GetTriangleCount() const;
+
+  // Four rays traced together, only defined in Bvh.cc
+  struct Packet;
+private:
+  friend class InstanceBvh;
+
+  // Precomputed for Moller-Trumbore, in leaf order
+  struct Triangle {
+    glm::vec3 v0_;
+    glm::vec3 edge1_;
+    glm::vec3 edge2_;
+    uint32_t index_;
+  };
+
+  void IntersectPacket(Packet& packet, RayHit* hits, uint32_t instance) const;
+private:
+  std::vector<BvhNode> nodes_;
+  std::vector<Triangle> triangles_;
+};
+
+struct BvhInstance {
+  const TriangleBvh* bvh_;
+  glm::mat4 transform_;
+};
+
+// Top level over instances of TriangleBvhs. Rays are moved into each
+// instance's space, so hits keep world space distances.
+class InstanceBvh {
+public:
+  // The TriangleBvhs have to outlive the InstanceBvh. Cheap enough to
+  // rebuild every frame for a few thousand instances. Instances of empty
+  // TriangleBvhs are left out.
+  void Build(const BvhInstance* instances, size_t count);
+
+  bool Intersect(const Ray& ray, RayHit& hit) const;
+  void IntersectBatch(const Ray* rays, size_t count, RayHit* hits) const;
+
+  size_t GetInstanceCount() const;
+private:
+  struct Instance {
+    const TriangleBvh* bvh_;
+    glm::mat4 inverse_;
+    // Position in the array passed to Build
+    uint32_t index_;
+  };
+private:
+  std::vector<BvhNode> nodes_;
+  std::vector<Instance> instances_;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "CommandList.h"
+
+#include "GLExtensions.h"
+
+#include <algorithm>
+#include <cassert>
+
+constexpr uint32_t kMaxTextureSlots = 16;
+constexpr uint32_t kMaxUniformBindings = 16;
+// Below this many items per part, waking the workers costs more than it saves
+constexpr size_t kMinItemsPerPart = 256;
+
+void CommandList::Reset() {
+  words_.clear();
+  command_count_ = 0;
+}
+
+void CommandList::Push(CommandType type, std::initializer_list<uint32_t> arguments) {
+  uint32_t length = 1 + arguments.size();
+  words_.push_back(uint32_t(type) | (length << 8));
+  words_.insert(words_.end(), arguments.begin(), arguments.end());
+  ++command_count_;
+}
+
+void CommandList::PushDraw(uint32_t vao, uint32_t index_count, uint32_t index_type, uint32_t vertex_count) {
+  if (index_count > 0) {
+    Push(CommandType::kDrawElements, { vao, index_count, index_type });
+  } else {
+    Push(CommandType::kDrawArrays, { vao, vertex_count });
+  }
+}
+
+void CommandList::BindProgram(const Shader& shader) {
+  Push(CommandType::kBindProgram, { shader.GetProgram() });
+}
+
+void CommandList::BindTextureArray(int32_t slot, const TextureArray& texture) {
+  assert(uint32_t(slot) < kMaxTextureSlots && "Texture slot out of range");
+  Push(CommandType::kBindTextureArray, { uint32_t(slot), texture.GetTextureID() });
+}
+
+void CommandList::BindUniformRange(uint32_t binding, uint32_t buffer, size_t offset, size_t size) {
+  assert(binding < kMaxUniformBindings && "Uniform binding out of range");
+  Push(CommandType::kBindUniformRange, { binding, buffer, uint32_t(offset), uint32_t(size) });
+}
+
+void CommandList::Draw(const Primitive& primitive) {
+  PushDraw(primitive.vao_, primitive.index_count_, primitive.index_type_, primitive.vertex_count_);
+}
+
+void CommandList::Draw(const SkinnedPrimitive& skinned) {
+  PushDraw(skinned.vao_, skinned.index_count_, skinned.index_type_, skinned.vertex_count_);
+}
+
+void CommandList::DrawDepth(const Primitive& primitive) {
+  PushDraw(primitive.depth_vao_, primitive.index_count_, primitive.index_type_, primitive.vertex_count_);
+}
+
+void CommandList::DrawDepth(const SkinnedPrimitive& skinned) {
+  PushDraw(skinned.depth_vao_, skinned.index_count_, skinned.index_type_, skinned.vertex_count_);
+}
+
+void CommandList::SetDepthState(DepthTest test, bool write) {
+  Push(CommandType::kDepthState, { uint32_t(test), write ? 1u : 0u });
+}
+
+void CommandList::SetColorWrite(bool write) {
+  Push(CommandType::kColorWrite, { write ? 1u : 0u });
+}
+
+size_t CommandList::GetCommandCount() const {
+  return command_count_;
+}
+
+size_t CommandList::GetSize() const {
+  return words_.size() * sizeof(uint32_t);
+}
+
+static GLenum DepthFunc(uint32_t test) {
+  switch (DepthTest(test)) {
+    case DepthTest::kLess: return GL_LESS;
+    case DepthTest::kEqual: return GL_EQUAL;
+    case DepthTest::kLessEqual: return GL_LEQUAL;
+  }
+  return GL_LESS;
+}
+
+void CommandList::Replay(const CommandList* lists, size_t count) {
+  // What the replay itself has bound, 0 until it binds something
+  uint32_t program = 0;
+  uint32_t vao = 0;
+  uint32_t textures[kMaxTextureSlots] = {};
+  uint32_t ranges[kMaxUniformBindings][3] = {};
+
+  for (size_t list = 0; list < count; ++list) {
+    const uint32_t* word = lists[list].words_.data();
+    const uint32_t* end = word + lists[list].words_.size();
+
+    while (word < end) {
+      uint32_t header = word[0];
+      const uint32_t* args = word + 1;
+      word += header >> 8;
+
+      switch (CommandType(header & 0xFF)) {
+        case CommandType::kBindProgram:
+          if (args[0] != program) {
+            program = args[0];
+            glUseProgram(program);
+          }
+          break;
+        case CommandType::kBindTextureArray:
+          if (textures[args[0]] != args[1]) {
+            textures[args[0]] = args[1];
+            glActiveTexture(GL_TEXTURE0 + args[0]);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, args[1]);
+          }
+          break;
+        case CommandType::kBindUniformRange: {
+          uint32_t* range = ranges[args[0]];
+          if (range[0] != args[1] || range[1] != args[2] || range[2] != args[3]) {
+            range[0] = args[1];
+            range[1] = args[2];
+            range[2] = args[3];
+            glBindBufferRange(GL_UNIFORM_BUFFER, args[0], args[1], args[2], args[3]);
+          }
+          break;
+        }
+        case CommandType::kDrawElements:
+          if (args[0] != vao) {
+            vao = args[0];
+            glBindVertexArray(vao);
+          }
+          glDrawElements(GL_TRIANGLES, args[1], args[2], nullptr);
+          break;
+        case CommandType::kDrawArrays:
+          if (args[0] != vao) {
+            vao = args[0];
+            glBindVertexArray(vao);
+          }
+          glDrawArrays(GL_TRIANGLES, 0, args[1]);
+          break;
+        case CommandType::kDepthState:
+          glDepthFunc(DepthFunc(args[0]));
+          glDepthMask(args[1] ? GL_TRUE : GL_FALSE);
+          break;
+        case CommandType::kColorWrite: {
+          GLboolean write = args[0] ? GL_TRUE : GL_FALSE;
+          glColorMask(write, write, write, write);
+          break;
+        }
+      }
+    }
+  }
+
+  if (vao != 0) {
+    glBindVertexArray(0);
+  }
+  if (program != 0) {
+    glUseProgram(0);
+  }
+}
+
+void CommandRecorder::Create(WorkerPool* pool) {
+  pool_ = pool;
+}
+
+void CommandRecorder::Destroy() {
+  pool_ = nullptr;
+}
+
+uint32_t CommandRecorder::GetPartCount() const {
+  return pool_ != nullptr ? pool_->GetThreadCount() : 1;
+}
+
+void CommandRecorder::Run(size_t count, PartFunction function, void* context) {
+  job_function_ = function;
+  job_context_ = context;
+  job_count_ = count;
+
+  // Every part still runs so its list gets reset, the small ones just
+  // aren't worth a wake up
+  if (GetPartCount() == 1 || count < kMinItemsPerPart * GetPartCount()) {
+    for (uint32_t part = 0; part < GetPartCount(); ++part) {
+      RecordPart(part);
+    }
+    return;
+  }
+
+  pool_->Run(GetPartCount(), [this](uint32_t part) {
+    RecordPart(part);
+  });
+}
+
+void CommandRecorder::RecordPart(uint32_t part) const {
+  size_t parts = GetPartCount();
+  size_t begin = job_count_ * part / parts;
+  size_t end = job_count_ * (part + 1) / parts;
+  job_function_(job_context_, part, begin, end);
+}
@@ -0,0 +1,106 @@
+#ifndef COMMAND_LIST_H_
+#define COMMAND_LIST_H_
+
+#include <vector>
+#include <type_traits>
+#include <initializer_list>
+#include <cstdint>
+#include <cstddef>
+
+#include "Graphics.h"
+#include "WorkerPool.h"
+
+enum class CommandType : uint8_t {
+  kBindProgram,
+  kBindTextureArray,
+  kBindUniformRange,
+  kDrawElements,
+  kDrawArrays,
+  kDepthState,
+  kColorWrite,
+};
+
+enum class DepthTest : uint8_t {
+  kLess,
+  kEqual,
+  kLessEqual,
+};
+
+// GL work recorded as plain data, so any thread can build it without a
+// context. Commands are packed into one array of 32-bit words: a header
+// word holding the type and length, then the arguments.
+//
+// Recording copies out the GL names it needs, the objects behind them have
+// to outlive the replay.
+class CommandList {
+public:
+  // Keeps the storage, lists recorded every frame stop allocating once warm
+  void Reset();
+
+  void BindProgram(const Shader& shader);
+  void BindTextureArray(int32_t slot, const TextureArray& texture);
+  void BindUniformRange(uint32_t binding, uint32_t buffer, size_t offset, size_t size);
+
+  void Draw(const Primitive& primitive);
+  void Draw(const SkinnedPrimitive& skinned);
+  // Through the position-only vertex arrays
+  void DrawDepth(const Primitive& primitive);
+  void DrawDepth(const SkinnedPrimitive& skinned);
+
+  void SetDepthState(DepthTest test, bool write);
+  void SetColorWrite(bool write);
+
+  size_t GetCommandCount() const;
+  size_t GetSize() const;
+
+  // Context thread only. Lists are replayed in order with binds that
+  // repeat the current state skipped, also across list boundaries. Leaves
+  // the last textures bound. A program or vertex array it bound is unbound
+  // again, lists without BindProgram draw with whatever was bound before.
+  static void Replay(const CommandList* lists, size_t count);
+private:
+  void Push(CommandType type, std::initializer_list<uint32_t> arguments);
+  void PushDraw(uint32_t vao, uint32_t index_count, uint32_t index_type, uint32_t vertex_count);
+private:
+  std::vector<uint32_t> words_;
+  size_t command_count_ = 0;
+};
+
+// Records command lists for disjoint slices of a frame's draws on a
+// WorkerPool.
+//
+// Record splits [0, count) into one contiguous slice per part and runs
+// record(part, begin, end) for every part at once, the calling thread
+// taking part 0. Replaying the parts' lists in part order gives the same
+// order a serial loop would.
+class CommandRecorder {
+public:
+  // Without a pool there is a single part, recorded on the calling thread
+  void Create(WorkerPool* pool = nullptr);
+  void Destroy();
+
+  // Parts every Record is split into, one per pool thread
+  uint32_t GetPartCount() const;
+
+  template <typename F>
+  void Record(size_t count, F&& record) {
+    using Function = std::remove_reference_t<F>;
+    Run(count, [](void* context, uint32_t part, size_t begin, size_t end) {
+      (*static_cast<Function*>(context))(part, begin, end);
+    }, (void*)&record);
+  }
+private:
+  using PartFunction = void (*)(void* context, uint32_t part, size_t begin, size_t end);
+
+  void Run(size_t count, PartFunction function, void* context);
+  void RecordPart(uint32_t part) const;
+private:
+  WorkerPool* pool_ = nullptr;
+
+  // Current Record
+  PartFunction job_function_ = nullptr;
+  void* job_context_ = nullptr;
+  size_t job_count_ = 0;
+};
+
+#endif
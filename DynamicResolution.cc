@@ -0,0 +1,138 @@
+#include "DynamicResolution.h"
+
+#include "GLExtensions.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+void DynamicResolution::Create(const DynamicResolutionSettings& settings) {
+  assert(settings.budget_ms_ > 0.0f && settings.headroom_ < 1.0f && "Budget leaves no time to target");
+  assert(settings.min_scale_ > 0.0f && settings.min_scale_ <= settings.max_scale_ && "Bad scale bounds");
+
+  settings_ = settings;
+  glGenQueries(kQueryCount, queries_);
+  for (bool& pending : pending_) {
+    pending = false;
+  }
+  next_ = 0;
+  timing_ = false;
+
+  area_ = settings_.max_scale_ * settings_.max_scale_;
+  scale_ = settings_.max_scale_;
+  error_ = 0.0f;
+  previous_error_ = 0.0f;
+  min_seen_scale_ = scale_;
+}
+
+void DynamicResolution::Destroy() {
+  glDeleteQueries(kQueryCount, queries_);
+  for (uint32_t& query : queries_) {
+    query = 0;
+  }
+}
+
+void DynamicResolution::SetEnabled(bool enabled) {
+  enabled_ = enabled;
+  if (!enabled_) {
+    area_ = settings_.max_scale_ * settings_.max_scale_;
+    scale_ = settings_.max_scale_;
+    error_ = 0.0f;
+    previous_error_ = 0.0f;
+  }
+}
+
+bool DynamicResolution::IsEnabled() const {
+  return enabled_;
+}
+
+void DynamicResolution::BeginFrame() {
+  // Oldest first, a query that isn't done means the later ones aren't either
+  for (uint32_t i = 0; i < kQueryCount; ++i) {
+    uint32_t slot = (next_ + i) % kQueryCount;
+    if (!pending_[slot]) {
+      continue;
+    }
+
+    GLint available = 0;
+    glGetQueryObjectiv(queries_[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      break;
+    }
+
+    GLuint64 elapsed_ns = 0;
+    glGetQueryObjectui64v(queries_[slot], GL_QUERY_RESULT, &elapsed_ns);
+    pending_[slot] = false;
+    Update(float(double(elapsed_ns) / 1'000'000.0));
+  }
+
+  // The GPU is more than kQueryCount frames behind, this frame goes untimed
+  timing_ = !pending_[next_];
+  if (!timing_) {
+    ++skipped_count_;
+    return;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, queries_[next_]);
+}
+
+void DynamicResolution::EndFrame() {
+  if (!timing_) {
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  pending_[next_] = true;
+  next_ = (next_ + 1) % kQueryCount;
+  timing_ = false;
+}
+
+void DynamicResolution::Update(float gpu_ms) {
+  gpu_ms_ = gpu_ms;
+  ++measured_count_;
+  total_gpu_ms_ += gpu_ms;
+  max_gpu_ms_ = std::max(max_gpu_ms_, gpu_ms);
+  over_budget_count_ += gpu_ms > settings_.budget_ms_ ? 1 : 0;
+
+  if (enabled_) {
+    // Limited so one hitch can't throw the scale to its bound
+    float target_ms = settings_.budget_ms_ * (1.0f - settings_.headroom_);
+    float error = std::clamp((target_ms - gpu_ms) / target_ms, -1.0f, 1.0f);
+
+    float delta =
+      settings_.kp_ * (error - error_) +
+      settings_.ki_ * error +
+      settings_.kd_ * (error - 2.0f * error_ + previous_error_);
+    previous_error_ = error_;
+    error_ = error;
+
+    float min_area = settings_.min_scale_ * settings_.min_scale_;
+    float max_area = settings_.max_scale_ * settings_.max_scale_;
+    area_ = std::clamp(area_ + delta, min_area, max_area);
+    scale_ = std::sqrt(area_);
+  }
+
+  total_scale_ += scale_;
+  min_seen_scale_ = std::min(min_seen_scale_, scale_);
+}
+
+float DynamicResolution::GetScale() const {
+  return scale_;
+}
+
+float DynamicResolution::GetGpuMs() const {
+  return gpu_ms_;
+}
+
+void DynamicResolution::Report() const {
+  if (measured_count_ == 0) {
+    return;
+  }
+  std::cout
+    << "[dynamic resolution] " << measured_count_ << " frames timed, "
+    << total_gpu_ms_ / measured_count_ << " ms average, " << max_gpu_ms_ << " ms worst, "
+    << over_budget_count_ << " over the " << settings_.budget_ms_ << " ms budget, "
+    << skipped_count_ << " untimed" << std::endl;
+  std::cout
+    << "[dynamic resolution] scale " << total_scale_ / measured_count_ << " average, "
+    << min_seen_scale_ << " lowest" << (enabled_ ? "" : ", disabled") << std::endl;
+}
@@ -0,0 +1,79 @@
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+#include <cstdint>
+#include <cstddef>
+
+struct DynamicResolutionSettings {
+  // GPU time a frame may take, in milliseconds
+  float budget_ms_ = 16.6f;
+  // Part of the budget kept free, the measurements trail by a few frames
+  float headroom_ = 0.1f;
+
+  // Bounds on the scale of each axis
+  float min_scale_ = 0.5f;
+  float max_scale_ = 1.0f;
+
+  // Gains on the error relative to the target, the controller output is
+  // the change in rendered area per frame
+  float kp_ = 0.2f;
+  float ki_ = 0.1f;
+  float kd_ = 0.05f;
+};
+
+// Picks the render scale each frame from GPU frame times. Everything between
+// BeginFrame and EndFrame is timed with GL_TIME_ELAPSED queries kept in a
+// ring, results are only read once available so nothing waits on the GPU.
+//
+// The controller is a PID in velocity form over the rendered area, which
+// GPU time roughly follows, and the scale is its square root. Clamping the
+// area is all the anti-windup it needs.
+class DynamicResolution {
+public:
+  void Create(const DynamicResolutionSettings& settings);
+  void Destroy();
+
+  // Fixed at max_scale_ while disabled, frames are still timed
+  void SetEnabled(bool enabled);
+  bool IsEnabled() const;
+
+  // Context thread only, queries can't nest with other GL_TIME_ELAPSED ones
+  void BeginFrame();
+  void EndFrame();
+
+  float GetScale() const;
+  // Most recent measurement, 0 before the first one arrives
+  float GetGpuMs() const;
+
+  // Frame times against the budget and how the scale moved
+  void Report() const;
+private:
+  void Update(float gpu_ms);
+private:
+  constexpr static uint32_t kQueryCount = 4;
+
+  DynamicResolutionSettings settings_;
+  bool enabled_ = true;
+
+  uint32_t queries_[kQueryCount] = {};
+  bool pending_[kQueryCount] = {};
+  // Slot the next frame is timed with, the oldest pending one after that
+  uint32_t next_ = 0;
+  bool timing_ = false;
+
+  float area_ = 1.0f;
+  float scale_ = 1.0f;
+  float error_ = 0.0f;
+  float previous_error_ = 0.0f;
+  float gpu_ms_ = 0.0f;
+
+  size_t measured_count_ = 0;
+  size_t over_budget_count_ = 0;
+  size_t skipped_count_ = 0;
+  double total_gpu_ms_ = 0.0;
+  double total_scale_ = 0.0;
+  float max_gpu_ms_ = 0.0f;
+  float min_seen_scale_ = 1.0f;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "FramePacer.h"
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// OS sleeps routinely overshoot by a millisecond or more, so the last stretch
+// before the deadline is spun instead
+constexpr int64_t kSpinThresholdNs = 2'000'000;
+constexpr int64_t kSafetyMarginNs = 500'000;
+
+FramePacer::FramePacer() 
+  : mode_(PacingMode::kDefault), 
+    frame_period_ns_(1'000'000'000 / 60), 
+    next_present_ns_(0), 
+    predicted_work_ns_(0),
+    input_time_ns_(0),
+    latency_ns_(0),
+    max_latency_ns_(0) {}
+
+int64_t FramePacer::NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+void FramePacer::SetMode(PacingMode mode) {
+  mode_ = mode;
+  next_present_ns_ = 0;
+}
+
+void FramePacer::SetTargetFrameRate(double hz) {
+  if (hz > 0.0) {
+    frame_period_ns_ = static_cast<int64_t>(1'000'000'000.0 / hz);
+  }
+}
+
+PacingMode FramePacer::GetMode() const {
+  return mode_;
+}
+
+double FramePacer::GetFramePeriodMs() const {
+  return frame_period_ns_ / 1'000'000.0;
+}
+
+void FramePacer::WaitForFrameStart() {
+  if (mode_ != PacingMode::kLowLatency || next_present_ns_ == 0) {
+    return;
+  }
+
+  int64_t start = next_present_ns_ - predicted_work_ns_ - kSafetyMarginNs;
+  int64_t now = NowNs();
+
+  if (start - now > kSpinThresholdNs) {
+    std::this_thread::sleep_for(std::chrono::nanoseconds(start - now - kSpinThresholdNs));
+  }
+  while (NowNs() < start) {
+  }
+}
+
+void FramePacer::MarkInputSampled() {
+  input_time_ns_ = NowNs();
+}
+
+// Exponential moving averages, weighted 1/8 towards the newest frame
+void FramePacer::MarkWorkDone() {
+  int64_t work = NowNs() - input_time_ns_;
+  predicted_work_ns_ += (work - predicted_work_ns_) / 8;
+  predicted_work_ns_ = std::min(predicted_work_ns_, frame_period_ns_);
+}
+
+void FramePacer::MarkPresented() {
+  int64_t now = NowNs();
+  int64_t latency = now - input_time_ns_;
+  latency_ns_ += (latency - latency_ns_) / 8;
+  max_latency_ns_ = std::max(max_latency_ns_, latency);
+
+  next_present_ns_ += frame_period_ns_;
+  if (next_present_ns_ < now) {
+    next_present_ns_ = now + frame_period_ns_;
+  }
+}
+
+double FramePacer::GetWorkMs() const {
+  return static_cast<double>(predicted_work_ns_) / 1'000'000.0;
+}
+
+double FramePacer::GetLatencyMs() const {
+  return static_cast<double>(latency_ns_) / 1'000'000.0;
+}
+
+double FramePacer::GetMaxLatencyMs() const {
+  return static_cast<double>(max_latency_ns_) / 1'000'000.0;
+}
@@ -0,0 +1,51 @@
+#ifndef FRAME_PACER_H_
+#define FRAME_PACER_H_
+
+#include <cstdint>
+
+enum class PacingMode {
+  kDefault,
+  kLowLatency,
+};
+
+// Schedules the start of each frame so that input is sampled as late as
+// possible before the predicted present time, and measures the resulting
+// input-to-present latency. The prediction only learns from the frame's
+// work, not from the wait for vsync after it, or it would grow to the whole
+// period. All timing is in int64 nanoseconds.
+class FramePacer {
+public:
+  FramePacer();
+
+  static int64_t NowNs();
+
+  void SetMode(PacingMode mode);
+  void SetTargetFrameRate(double hz);
+
+  PacingMode GetMode() const;
+  double GetFramePeriodMs() const;
+
+  // Sleeps, then spins, until the frame has to start to make its deadline
+  void WaitForFrameStart();
+
+  void MarkInputSampled();
+  // CPU and GPU work done, right before the swap
+  void MarkWorkDone();
+  void MarkPresented();
+
+  double GetWorkMs() const;
+  double GetLatencyMs() const;
+  double GetMaxLatencyMs() const;
+private:
+  PacingMode mode_;
+
+  int64_t frame_period_ns_;
+  int64_t next_present_ns_;
+  int64_t predicted_work_ns_;
+
+  int64_t input_time_ns_;
+  int64_t latency_ns_;
+  int64_t max_latency_ns_;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "GLExtensions.h"
+
+#include <cstring>
+
+PFNGLGETUNIFORMBLOCKINDEXPROC glext_glGetUniformBlockIndex = nullptr;
+PFNGLUNIFORMBLOCKBINDINGPROC glext_glUniformBlockBinding = nullptr;
+
+PFNGLFENCESYNCPROC glext_glFenceSync = nullptr;
+PFNGLCLIENTWAITSYNCPROC glext_glClientWaitSync = nullptr;
+PFNGLDELETESYNCPROC glext_glDeleteSync = nullptr;
+
+PFNGLQUERYCOUNTERPROC glext_glQueryCounter = nullptr;
+PFNGLGETQUERYOBJECTUI64VPROC glext_glGetQueryObjectui64v = nullptr;
+
+PFNGLBUFFERSTORAGEPROC glext_glBufferStorage = nullptr;
+
+int GLEXT_ARB_buffer_storage = 0;
+
+bool HasGLExtension(const char* name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (extension != nullptr && std::strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LoadGLExtensions(GLADloadproc load) {
+  glext_glGetUniformBlockIndex = (PFNGLGETUNIFORMBLOCKINDEXPROC)load("glGetUniformBlockIndex");
+  glext_glUniformBlockBinding = (PFNGLUNIFORMBLOCKBINDINGPROC)load("glUniformBlockBinding");
+
+  glext_glFenceSync = (PFNGLFENCESYNCPROC)load("glFenceSync");
+  glext_glClientWaitSync = (PFNGLCLIENTWAITSYNCPROC)load("glClientWaitSync");
+  glext_glDeleteSync = (PFNGLDELETESYNCPROC)load("glDeleteSync");
+
+  glext_glQueryCounter = (PFNGLQUERYCOUNTERPROC)load("glQueryCounter");
+  glext_glGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)load("glGetQueryObjectui64v");
+
+  GLint major = 0;
+  GLint minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+  if ((major > 4 || (major == 4 && minor >= 4)) || HasGLExtension("GL_ARB_buffer_storage")) {
+    glext_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+    GLEXT_ARB_buffer_storage = glext_glBufferStorage != nullptr;
+  }
+
+  return 
+    glext_glGetUniformBlockIndex != nullptr && 
+    glext_glUniformBlockBinding != nullptr &&
+    glext_glFenceSync != nullptr && 
+    glext_glClientWaitSync != nullptr && 
+    glext_glDeleteSync != nullptr &&
+    glext_glQueryCounter != nullptr &&
+    glext_glGetQueryObjectui64v != nullptr;
+}
@@ -0,0 +1,78 @@
+#ifndef GL_EXTENSIONS_H_
+#define GL_EXTENSIONS_H_
+
+#include <glad/glad.h>
+
+// The vendored glad only covers GL 3.0. Entry points from later core
+// versions and extensions are loaded here, after the context exists, and
+// exposed under their usual names the same way glad does.
+
+#ifndef GL_VERSION_3_1
+#define GL_UNIFORM_BUFFER 0x8A11
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#define GL_MAX_UNIFORM_BLOCK_SIZE 0x8A30
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+
+typedef GLuint (APIENTRYP PFNGLGETUNIFORMBLOCKINDEXPROC)(GLuint program, const GLchar* uniformBlockName);
+typedef void (APIENTRYP PFNGLUNIFORMBLOCKBINDINGPROC)(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding);
+#endif
+
+#ifndef GL_VERSION_3_2
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+
+typedef GLsync (APIENTRYP PFNGLFENCESYNCPROC)(GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRYP PFNGLCLIENTWAITSYNCPROC)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void (APIENTRYP PFNGLDELETESYNCPROC)(GLsync sync);
+#endif
+
+#ifndef GL_VERSION_3_3
+#define GL_TIME_ELAPSED 0x88BF
+#define GL_TIMESTAMP 0x8E28
+
+typedef void (APIENTRYP PFNGLQUERYCOUNTERPROC)(GLuint id, GLenum target);
+typedef void (APIENTRYP PFNGLGETQUERYOBJECTUI64VPROC)(GLuint id, GLenum pname, GLuint64* params);
+#endif
+
+#ifndef GL_ARB_buffer_storage
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+#endif
+
+extern PFNGLGETUNIFORMBLOCKINDEXPROC glext_glGetUniformBlockIndex;
+#define glGetUniformBlockIndex glext_glGetUniformBlockIndex
+extern PFNGLUNIFORMBLOCKBINDINGPROC glext_glUniformBlockBinding;
+#define glUniformBlockBinding glext_glUniformBlockBinding
+
+extern PFNGLFENCESYNCPROC glext_glFenceSync;
+#define glFenceSync glext_glFenceSync
+extern PFNGLCLIENTWAITSYNCPROC glext_glClientWaitSync;
+#define glClientWaitSync glext_glClientWaitSync
+extern PFNGLDELETESYNCPROC glext_glDeleteSync;
+#define glDeleteSync glext_glDeleteSync
+
+extern PFNGLQUERYCOUNTERPROC glext_glQueryCounter;
+#define glQueryCounter glext_glQueryCounter
+extern PFNGLGETQUERYOBJECTUI64VPROC glext_glGetQueryObjectui64v;
+#define glGetQueryObjectui64v glext_glGetQueryObjectui64v
+
+extern PFNGLBUFFERSTORAGEPROC glext_glBufferStorage;
+#define glBufferStorage glext_glBufferStorage
+
+// Set by LoadGLExtensions, non zero when usable on the current context
+extern int GLEXT_ARB_buffer_storage;
+
+bool HasGLExtension(const char* name);
+
+// Must run after gladLoadGLLoader, returns false if a required core 3.3
+// entry point is missing
+bool LoadGLExtensions(GLADloadproc load);
+
+#endif
@@ -1,12 +1,17 @@
 #include "Graphics.h"
 
-#include <glad/glad.h>
+#include "GLExtensions.h"
+#include "Resources.h"
 
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <algorithm>
 #include <fstream>
 #include <cstddef>
+#include <cassert>
+#include <cstring>
+#include <numeric>
 
 #include <stb_image.h>
 
@@ -25,10 +30,21 @@ void Shader::UnloadShader() {
 }
 
 
+uint32_t Shader::GetProgram() const {
+  return program_;
+}
+
 int32_t Shader::GetUniformLocation(const char* uniform) const {
   return glGetUniformLocation(program_, uniform);
 }
 
+void Shader::SetUniformBlockBinding(const char* block, uint32_t binding) const {
+  uint32_t index = glGetUniformBlockIndex(program_, block);
+  if (index != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program_, index, binding);
+  }
+}
+
 void Shader::SetUniformInt(int32_t location, int32_t value) const {
   glUniform1i(location, value);
 }
@@ -59,16 +75,70 @@ static void CheckShaderError(uint32_t shader) {
   }
 }
 
-void Shader::LoadShader(const std::string& filename) {
+static std::string ReadShaderFile(const std::string& filename) {
   std::fstream file(filename);
-  std::string file_contents = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Indexed by feature bit
+static const char* kFeatureDefines[kFeatureCount] = {
+  "SKINNED",
+  "TEXTURED",
+};
+
+// Sits next to the shader that includes it
+static std::string ReadSkinningSource(const std::string& filename) {
+  size_t slash = filename.find_last_of('/');
+  std::string directory = slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+  return ReadShaderFile(directory + "skinning.glsl");
+}
+
+// #version has to stay first, the defines and any shared source go on the
+// lines after it. #line numbers the shared source as string 1 and puts the
+// stage's numbering back for the compile log.
+static std::string InjectDefines(const std::string& source, uint32_t features, const std::string& shared = "") {
+  if (features == 0 && shared.empty()) {
+    return source;
+  }
+
+  std::string defines;
+  for (uint32_t bit = 0; bit < kFeatureCount; ++bit) {
+    if (features & (1u << bit)) {
+      defines += "#define ";
+      defines += kFeatureDefines[bit];
+      defines += "\n";
+    }
+  }
+  if (!shared.empty()) {
+    defines += "#line 1 1\n";
+    defines += shared;
+    if (shared.back() != '\n') {
+      defines += "\n";
+    }
+  }
+
+  size_t version = source.find("#version");
+  size_t line_end = version == std::string::npos ? std::string::npos : source.find('\n', version);
+  if (line_end == std::string::npos) {
+    return defines + source;
+  }
+
+  size_t line = std::count(source.begin(), source.begin() + line_end, '\n') + 2;
+  defines += "#line " + std::to_string(line) + " 0\n";
+  return source.substr(0, line_end + 1) + defines + source.substr(line_end + 1);
+}
+
+void Shader::LoadShader(const std::string& filename, uint32_t features) {
+  std::string file_contents = ReadShaderFile(filename);
 
   const std::string identifier = "#SPLIT";
   
   size_t split_location = file_contents.find(identifier);
-  
-  std::string vertex_str = file_contents.substr(0, split_location);
-  std::string fragment_str = file_contents.substr(split_location + identifier.size());
+
+  // Only vertex stages skin
+  std::string skinning = features & kFeatureSkinned ? ReadSkinningSource(filename) : "";
+  std::string vertex_str = InjectDefines(file_contents.substr(0, split_location), features, skinning);
+  std::string fragment_str = InjectDefines(file_contents.substr(split_location + identifier.size()), features);
 
   program_ = glCreateProgram();
   vertex_shader_ = glCreateShader(GL_VERTEX_SHADER);
@@ -92,6 +162,104 @@ void Shader::LoadShader(const std::string& filename) {
   glLinkProgram(program_);
 }
 
+void Shader::LoadFeedbackShader(
+  const std::string& filename, const char* const* varyings, int32_t varying_count, uint32_t features
+) {
+  std::string skinning = features & kFeatureSkinned ? ReadSkinningSource(filename) : "";
+  std::string vertex_str = InjectDefines(ReadShaderFile(filename), features, skinning);
+
+  program_ = glCreateProgram();
+  vertex_shader_ = glCreateShader(GL_VERTEX_SHADER);
+  fragment_shader_ = 0;
+
+  const char* vertex_c_str = vertex_str.c_str();
+  glShaderSource(vertex_shader_, 1, &vertex_c_str, nullptr);
+
+  glCompileShader(vertex_shader_);
+  CheckShaderError(vertex_shader_);
+
+  glAttachShader(program_, vertex_shader_);
+
+  // Has to be set before linking, each varying goes to its own buffer binding
+  glTransformFeedbackVaryings(program_, varying_count, varyings, GL_SEPARATE_ATTRIBS);
+  glLinkProgram(program_);
+}
+
+void ShaderVariants::Create(const std::string& filename) {
+  filename_ = filename;
+}
+
+void ShaderVariants::Destroy() {
+  for (ShaderHandle& variant : variants_) {
+    if (!variant.IsNull()) {
+      Resources::Destroy(variant);
+    }
+    variant = ShaderHandle {};
+  }
+  block_bindings_.clear();
+  samplers_.clear();
+}
+
+void ShaderVariants::SetUniformBlockBinding(const char* block, uint32_t binding) {
+  block_bindings_.emplace_back(block, binding);
+  for (ShaderHandle variant : variants_) {
+    if (!variant.IsNull()) {
+      Resources::Get(variant)->SetUniformBlockBinding(block, binding);
+    }
+  }
+}
+
+void ShaderVariants::SetSampler(const char* sampler, int32_t slot) {
+  samplers_.emplace_back(sampler, slot);
+  for (ShaderHandle variant : variants_) {
+    if (!variant.IsNull()) {
+      const Shader& shader = *Resources::Get(variant);
+      shader.Enable();
+      shader.SetUniformInt(shader.GetUniformLocation(sampler), slot);
+      shader.Disable();
+    }
+  }
+}
+
+const Shader& ShaderVariants::Require(uint32_t features) {
+  assert(features < kShaderVariantCount && "Unknown shader feature");
+  ShaderHandle& variant = variants_[features];
+  if (variant.IsNull()) {
+    variant = Resources::LoadShader(filename_, features);
+    Configure(*Resources::Get(variant));
+  }
+  return *Resources::Get(variant);
+}
+
+const Shader& ShaderVariants::Get(uint32_t features) const {
+  assert(features < kShaderVariantCount && !variants_[features].IsNull() && "Shader variant was never required");
+  return *Resources::Get(variants_[features]);
+}
+
+uint32_t ShaderVariants::GetVariantCount() const {
+  uint32_t count = 0;
+  for (ShaderHandle variant : variants_) {
+    count += variant.IsNull() ? 0 : 1;
+  }
+  return count;
+}
+
+void ShaderVariants::Configure(const Shader& shader) const {
+  for (const auto& [block, binding] : block_bindings_) {
+    shader.SetUniformBlockBinding(block.c_str(), binding);
+  }
+
+  if (samplers_.empty()) {
+    return;
+  }
+  // Samplers a variant compiled out come back as -1, which GL ignores
+  shader.Enable();
+  for (const auto& [sampler, slot] : samplers_) {
+    shader.SetUniformInt(shader.GetUniformLocation(sampler.c_str()), slot);
+  }
+  shader.Disable();
+}
+
 void Graphics::ClearColor(Color color) {
   float red = static_cast<float>(color.r) / 255.f;
   float green = static_cast<float>(color.g) / 255.f;
@@ -102,47 +270,94 @@ void Graphics::ClearColor(Color color) {
 }
 
 Primitive Graphics::CreatePrimitive(
-  const std::vector<Vertex>& vertices, 
+  const Vertex* vertices, 
+  size_t vertex_count,
   uint32_t index_count,
   uint32_t index_type,
   uint32_t joint_type,
-  const std::vector<uint8_t>& indices
+  PrimitiveBuffers& buffers,
+  const uint8_t* indices,
+  size_t indices_size
+) {
+  VertexLayout layout;
+  layout.attributes_[kAttributePosition] = 
+    VertexAttributeFormat { GL_FLOAT, 3, false, kStreamPosition, uint32_t(offsetof(PositionVertex, pos_)) };
+  layout.attributes_[kAttributeJoints] = 
+    VertexAttributeFormat { joint_type, 4, false, kStreamPosition, uint32_t(offsetof(PositionVertex, joints_)) };
+  layout.attributes_[kAttributeWeights] = 
+    VertexAttributeFormat { GL_FLOAT, 4, false, kStreamPosition, uint32_t(offsetof(PositionVertex, weights_)) };
+  layout.attributes_[kAttributeTexCoord] = 
+    VertexAttributeFormat { GL_FLOAT, 2, false, kStreamShading, uint32_t(offsetof(ShadingVertex, tex_coords_)) };
+  layout.attributes_[kAttributeNormal] = 
+    VertexAttributeFormat { GL_FLOAT, 3, false, kStreamShading, uint32_t(offsetof(ShadingVertex, normal_)) };
+  layout.strides_[kStreamPosition] = sizeof(PositionVertex);
+  layout.strides_[kStreamShading] = sizeof(ShadingVertex);
+
+  std::vector<PositionVertex> positions(vertex_count);
+  std::vector<ShadingVertex> shading(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    positions[i] = PositionVertex { vertices[i].pos_, vertices[i].joints_, vertices[i].weights_ };
+    shading[i] = ShadingVertex { vertices[i].tex_coords_, vertices[i].normal_ };
+  }
+
+  const uint8_t* streams[kStreamCount] = {
+    reinterpret_cast<const uint8_t*>(positions.data()),
+    reinterpret_cast<const uint8_t*>(shading.data())
+  };
+  return CreatePrimitive(layout, streams, vertex_count, index_count, index_type, buffers, indices, indices_size);
+}
+
+Primitive Graphics::CreatePrimitive(
+  const VertexLayout& layout,
+  const uint8_t* const (&streams)[kStreamCount],
+  size_t vertex_count,
+  uint32_t index_count,
+  uint32_t index_type,
+  PrimitiveBuffers& buffers,
+  const uint8_t* indices,
+  size_t indices_size
 ) {
   Primitive primitive;
-  primitive.vertices_ = vertices;
+  primitive.vertex_count_ = vertex_count;
   primitive.index_count_ = index_count;
   primitive.index_type_ = index_type;
-  primitive.joint_type_ = joint_type; 
+  buffers.layout_ = layout;
 
   glGenVertexArrays(1, &primitive.vao_);
+  glGenVertexArrays(1, &primitive.depth_vao_);
   
-  glGenBuffers(1, &primitive.vbo_);
-  glGenBuffers(1, &primitive.ebo_);
+  glGenBuffers(1, &buffers.position_vbo_);
+  glGenBuffers(1, &buffers.vbo_);
+  glGenBuffers(1, &buffers.ebo_);
 
-  glBindVertexArray(primitive.vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.position_vbo_);
+  glBufferData(GL_ARRAY_BUFFER, vertex_count * layout.strides_[kStreamPosition], streams[kStreamPosition], GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo_);
+  glBufferData(GL_ARRAY_BUFFER, vertex_count * layout.strides_[kStreamShading], streams[kStreamShading], GL_STATIC_DRAW);
 
-  glBindBuffer(GL_ARRAY_BUFFER, primitive.vbo_);
-  glBufferData(GL_ARRAY_BUFFER, primitive.vertices_.size() * sizeof(Vertex), &primitive.vertices_[0], GL_STATIC_DRAW);
-  
   if (index_count > 0) {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive.ebo_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), &indices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, indices, GL_STATIC_DRAW);
   }
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos_));
-  glEnableVertexAttribArray(0);
-  
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coords_));
-  glEnableVertexAttribArray(1);
-  
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal_));
-  glEnableVertexAttribArray(2);
-  
-  glVertexAttribIPointer(3, 4, primitive.joint_type_, sizeof(Vertex), (void*)offsetof(Vertex, joints_));
-  glEnableVertexAttribArray(3);
-  
-  glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, weights_));
-  glEnableVertexAttribArray(4);
+  for (uint32_t vao : { primitive.vao_, primitive.depth_vao_ }) {
+    glBindVertexArray(vao);
+
+    if (index_count > 0) {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo_);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.position_vbo_);
+    SetVertexAttribute(layout, kAttributePosition);
+    SetVertexAttribute(layout, kAttributeJoints);
+    SetVertexAttribute(layout, kAttributeWeights);
+  }
+
+  glBindVertexArray(primitive.vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo_);
+  SetVertexAttribute(layout, kAttributeTexCoord);
+  SetVertexAttribute(layout, kAttributeNormal);
 
   glBindVertexArray(0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -151,19 +366,38 @@ Primitive Graphics::CreatePrimitive(
   return primitive;
 }
 
+void Graphics::SetVertexAttribute(const VertexLayout& layout, uint32_t attribute) {
+  const VertexAttributeFormat& format = layout.attributes_[attribute];
+  if (format.type_ == 0) {
+    return;
+  }
 
-void Graphics::DestroyPrimitive(Primitive& primitive) {
+  uint32_t stride = layout.strides_[format.stream_];
+  const void* offset = reinterpret_cast<const void*>(uintptr_t(format.offset_));
+  // Joint indices are integers in the shader, everything else is converted
+  // to float, normalized when the file says so
+  if (attribute == kAttributeJoints) {
+    glVertexAttribIPointer(attribute, format.components_, format.type_, stride, offset);
+  } else {
+    glVertexAttribPointer(attribute, format.components_, format.type_, format.normalized_ ? GL_TRUE : GL_FALSE, stride, offset);
+  }
+  glEnableVertexAttribArray(attribute);
+}
+
+void Graphics::DestroyPrimitive(Primitive& primitive, PrimitiveBuffers& buffers) {
   if (primitive.index_count_ > 0) {
-    glDeleteBuffers(1, &primitive.ebo_);
+    glDeleteBuffers(1, &buffers.ebo_);
   }
   
-  glDeleteBuffers(1, &primitive.vbo_);
+  glDeleteBuffers(1, &buffers.position_vbo_);
+  glDeleteBuffers(1, &buffers.vbo_);
   glDeleteVertexArrays(1, &primitive.vao_);
+  glDeleteVertexArrays(1, &primitive.depth_vao_);
 }
 
 void Graphics::RenderPrimitive(const Primitive& primitive) {
   glBindVertexArray(primitive.vao_);
-  glDrawArrays(GL_TRIANGLES, 0, primitive.vertices_.size());
+  glDrawArrays(GL_TRIANGLES, 0, primitive.vertex_count_);
   glBindVertexArray(0);
 }
 
@@ -173,6 +407,52 @@ void Graphics::RenderPrimitiveIndexed(const Primitive& primitive) {
   glBindVertexArray(0);
 }
 
+void Graphics::RenderSkinned(const SkinnedPrimitive& skinned) {
+  glBindVertexArray(skinned.vao_);
+  if (skinned.index_count_ > 0) {
+    glDrawElements(GL_TRIANGLES, skinned.index_count_, skinned.index_type_, nullptr);
+  } else {
+    glDrawArrays(GL_TRIANGLES, 0, skinned.vertex_count_);
+  }
+  glBindVertexArray(0);
+}
+
+void Graphics::BeginDepthPrepass() {
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+}
+
+void Graphics::EndDepthPrepass() {
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthFunc(GL_EQUAL);
+  glDepthMask(GL_FALSE);
+}
+
+// glClear skips the depth buffer while depth writes are off
+void Graphics::ResetDepthState() {
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+}
+
+void Graphics::RenderPrimitiveDepth(const Primitive& primitive) {
+  glBindVertexArray(primitive.depth_vao_);
+  if (primitive.index_count_ > 0) {
+    glDrawElements(GL_TRIANGLES, primitive.index_count_, primitive.index_type_, nullptr);
+  } else {
+    glDrawArrays(GL_TRIANGLES, 0, primitive.vertex_count_);
+  }
+  glBindVertexArray(0);
+}
+
+void Graphics::RenderSkinnedDepth(const SkinnedPrimitive& skinned) {
+  glBindVertexArray(skinned.depth_vao_);
+  if (skinned.index_count_ > 0) {
+    glDrawElements(GL_TRIANGLES, skinned.index_count_, skinned.index_type_, nullptr);
+  } else {
+    glDrawArrays(GL_TRIANGLES, 0, skinned.vertex_count_);
+  }
+  glBindVertexArray(0);
+}
+
 void Texture::LoadFromFile(const std::string& file, bool flip) {
   int32_t width = 0;
   int32_t height = 0;
@@ -228,308 +508,288 @@ uint32_t Texture::GetTextureID() const {
   return id_;
 }
 
-Model::~Model() {
-  if (!is_loaded_) {
-    return;
-  }
-  
+void Model::Unload() {
   for (Mesh& mesh : meshes_) {
     for (MeshPrimitive& primitive : mesh.mesh_primitives_) {
-      Graphics::DestroyPrimitive(primitive.primitive_);
+      Resources::Destroy(primitive.primitive_);
     }
   }
   
-  for (auto& [_, texture] : texture_cache_) {
-    texture.UnloadTexture();
+  for (TextureHandle texture : textures_) {
+    Resources::Destroy(texture);
   }
+
+  meshes_.clear();
+  skins_.clear();
+  textures_.clear();
+  occluders_.clear();
+  bvhs_.clear();
 }
 
 const std::vector<Mesh>& Model::GetMeshes() const {
   return meshes_;
 }
 
-uint32_t LoadGLTF_Texture(const tinygltf::Sampler& sampler, const tinygltf::Image& image) {
-  uint32_t id = 0;
+TextureArray::TextureArray(uint32_t id) : id_(id) {}
 
-  std::vector<uint8_t> data = image.image;
+void TextureArray::Create(const TextureArrayDesc& desc) {
+  glGenTextures(1, &id_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id_);
 
-  glGenTextures(1, &id);
-  glBindTexture(GL_TEXTURE_2D, id);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, desc.wrap_s_);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, desc.wrap_t_);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, desc.min_filter_);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, desc.mag_filter_);
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+  GLenum format = GL_RGBA;
+  if (desc.component_ == 1) {
+    format = GL_RED;
+  } else if (desc.component_ == 2) {
+    format = GL_RG;
+  } else if (desc.component_ == 3) {
+    format = GL_RGB;
+  }
+
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, desc.width_, desc.height_, desc.layers_, 0, format, GL_UNSIGNED_BYTE, nullptr);
+
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureArray::UnloadTexture() {
+  glDeleteTextures(1, &id_);
+}
+
+// The image with padding texels on every side, each a copy of the nearest
+// edge texel
+static std::vector<uint8_t> PadImage(const DecodedImage& image, int32_t padding) {
+  int32_t width = image.width_ + padding * 2;
+  int32_t height = image.height_ + padding * 2;
+  size_t texel_size = image.component_;
+
+  std::vector<uint8_t> padded(size_t(width) * height * texel_size);
+  for (int32_t y = 0; y < height; ++y) {
+    int32_t source_y = std::clamp(y - padding, 0, image.height_ - 1);
+    const uint8_t* source_row = image.pixels_ + size_t(source_y) * image.width_ * texel_size;
+    uint8_t* row = padded.data() + size_t(y) * width * texel_size;
+
+    for (int32_t x = 0; x < padding; ++x) {
+      std::memcpy(row + x * texel_size, source_row, texel_size);
+      std::memcpy(row + (width - 1 - x) * texel_size, source_row + (image.width_ - 1) * texel_size, texel_size);
+    }
+    std::memcpy(row + padding * texel_size, source_row, image.width_ * texel_size);
+  }
+  return padded;
+}
 
+void TextureArray::Upload(const TexturePlacement& placement, const DecodedImage& image) {
   GLenum format = GL_RGBA;
-  if (image.component == 1) {
+  if (image.component_ == 1) {
     format = GL_RED;
-  } else if (image.component == 2) {
+  } else if (image.component_ == 2) {
     format = GL_RG;
-  } else if (image.component == 3) {
+  } else if (image.component_ == 3) {
     format = GL_RGB;
   }
 
-  glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, data.data());
-  glGenerateMipmap(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id_);
+  if (placement.padding_ > 0) {
+    // The page starts out undefined, the gutter is written with the texture
+    std::vector<uint8_t> padded = PadImage(image, placement.padding_);
+    glTexSubImage3D(
+      GL_TEXTURE_2D_ARRAY, 0, 
+      placement.x_ - placement.padding_, placement.y_ - placement.padding_, placement.layer_, 
+      image.width_ + placement.padding_ * 2, image.height_ + placement.padding_ * 2, 1, 
+      format, GL_UNSIGNED_BYTE, padded.data()
+    );
+  } else {
+    glTexSubImage3D(
+      GL_TEXTURE_2D_ARRAY, 0, 
+      placement.x_, placement.y_, placement.layer_, 
+      image.width_, image.height_, 1, 
+      format, GL_UNSIGNED_BYTE, image.pixels_
+    );
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
 
-  glBindTexture(GL_TEXTURE_2D, 0);
-  
-  return id;
+void TextureArray::GenerateMipmaps() {
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id_);
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 }
 
-glm::ivec4 LoadAttributeIVec4(uint8_t* slice) {
-  return glm::make_vec4(reinterpret_cast<const uint32_t*>(slice));
+void TextureArray::Bind(int32_t slot) const {
+  glActiveTexture(GL_TEXTURE0 + slot);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id_);
 }
 
-glm::vec4 LoadAttributeVec4(uint8_t* slice) {
-  return glm::make_vec4(reinterpret_cast<const float*>(slice));
+void TextureArray::Unbind() const {
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 }
 
-glm::vec3 LoadAttributeVec3(uint8_t* slice) {
-  return glm::make_vec3(reinterpret_cast<const float*>(slice));
+uint32_t TextureArray::GetTextureID() const {
+  return id_;
 }
 
-glm::vec2 LoadAttributeVec2(uint8_t* slice) {
-  return glm::make_vec2(reinterpret_cast<const float*>(slice));
+static LinearArena& LoadScratch() {
+  static LinearArena scratch("load scratch", 16 << 20);
+  return scratch;
 }
 
-Mesh GetMesh(const tinygltf::Model& model, const tinygltf::Mesh& mesh, std::unordered_map<std::string, Texture>& texture_cache) {
-  Mesh result;
+const LinearArena& Model::GetScratchArena() {
+  return LoadScratch();
+}
 
-  for (const tinygltf::Primitive& primitive : mesh.primitives) {    
-    
-    const tinygltf::Accessor& indices_accessor = model.accessors[primitive.indices];
-    const tinygltf::BufferView& indices_bv = model.bufferViews[indices_accessor.bufferView];
-    const tinygltf::Buffer& indices_b = model.buffers[indices_bv.buffer];
+void Model::Load(const std::string& filename, bool keep_occluders) {
+  LinearArena& scratch = LoadScratch();
 
-    std::vector<uint8_t> indices_data(      
-      indices_b.data.cbegin() + indices_bv.byteOffset, 
-      indices_b.data.cbegin() + indices_bv.byteOffset + indices_bv.byteLength
-    );
-    
-    uint32_t index_type = indices_accessor.componentType;
-    uint32_t index_count = indices_accessor.count;
-
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec2> texcoords;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::ivec4> joints; 
-    std::vector<glm::vec4> weights;
-
-    uint32_t joint_type = 0;
-
-    for (auto& [name, index] : primitive.attributes) {
-      const tinygltf::Accessor& accessor = model.accessors[index];
-      const tinygltf::BufferView& accessor_bv = model.bufferViews[accessor.bufferView];
-      const tinygltf::Buffer& accessor_b = model.buffers[accessor_bv.buffer];      
-
-      constexpr size_t kVec3Size = 12;
-      constexpr size_t kVec2Size = 8;
-      constexpr size_t kVec4Size = 16;
-      constexpr size_t kIVec4Size = 4;
-      
-      std::vector<uint8_t> data(          
-        accessor_b.data.cbegin() + accessor_bv.byteOffset, 
-        accessor_b.data.cbegin() + accessor_bv.byteOffset + accessor_bv.byteLength
-      );
-      
-      if (name == "NORMAL") {
-        for (int32_t i = 0; i < data.size() / kVec3Size; ++i) {
-          normals.emplace_back(LoadAttributeVec3(data.data() + accessor.ByteStride(accessor_bv) * i));
-        }
-      }
-      if (name == "POSITION") {
-        for (int32_t i = 0; i < data.size() / kVec3Size; ++i) {
-          positions.emplace_back(LoadAttributeVec3(data.data() + accessor.ByteStride(accessor_bv) * i));
-        }
-      }
-      if (name == "TEXCOORD_0") {
-        for (int32_t i = 0; i < data.size() / kVec2Size; ++i) {
-          texcoords.emplace_back(LoadAttributeVec2(data.data() + accessor.ByteStride(accessor_bv) * i));
-        }
-      }
-      if (name == "JOINTS_0") {
-        joint_type = accessor.componentType;
-        for (int32_t i = 0; i < data.size() / kIVec4Size; ++i) {
-          joints.emplace_back(LoadAttributeIVec4(data.data() + accessor.ByteStride(accessor_bv) * i));
-        }
-      }
-      if (name == "WEIGHTS_0") {        
-        for (int32_t i = 0; i < data.size() / kVec4Size; ++i) {
-          weights.emplace_back(LoadAttributeVec4(data.data() + accessor.ByteStride(accessor_bv) * i));
-        }
-      }
-    }
-        
-    assert(positions.size() == normals.size() && positions.size() > 0);
-
-    std::vector<Vertex> vertices;
-    for (int32_t i = 0; i < positions.size(); ++i) {
-      Vertex vertex;
-      vertex.pos_ = positions[i];
-      vertex.normal_ = normals[i];
-      if (texcoords.size() > 0) {
-        vertex.tex_coords_ = texcoords[i];
-      } else {
-        vertex.tex_coords_ = glm::vec2(0.0);
-      }
-      vertices.push_back(vertex);
-    }  
-    
-    if (joints.size() > 0 && weights.size() > 0) {
-      assert(joints.size() == weights.size() && weights.size() == positions.size());
-      for (int32_t i = 0; i < joints.size(); ++i) {
-        vertices[i].joints_ = joints[i];
-        vertices[i].weights_ = weights[i];
-      }
-    }
+  ModelData data;
+  bool success = AssetDecoder::LoadFromFile(filename, data, nullptr, &scratch);
+  assert(success && "Failed to parse GLTF");
+
+  Upload(data);
+  if (keep_occluders) {
+    KeepOccluders(data);
+  }
+
+  // Nothing may point into the arena once it's reset. This also unmaps the
+  // file, the uploads were the last reads of it. Loads are rare, so a big
+  // model's peak isn't kept around for the rest of the run.
+  data = ModelData();
+  scratch.Shrink();
+}
+
+void Model::Upload(ModelData& data) {
+  // Layers are allocated up front from the image headers so materials can
+  // reference them while the images are still decoding on the worker threads
+  TextureLayout layout = TexturePacker::Pack(data.textures_);
+  for (const TextureArrayDesc& desc : layout.arrays_) {
+    textures_.push_back(Resources::CreateTexture(desc));
+  }
 
-    MeshPrimitive mesh_p;
-    
-    // TODO (HANDLE COLOR)
-    if (primitive.material >= 0) {      
-      Material p_material;
-      const tinygltf::Material& material = model.materials[primitive.material];
-      const tinygltf::TextureInfo& texture_info = material.pbrMetallicRoughness.baseColorTexture;
-      if (texture_info.index >= 0) {
-        const tinygltf::Texture& texture = model.textures[texture_info.index];
-        const tinygltf::Image& image = model.images[texture.source];
-        
-        if (texture_cache.find(image.name) != texture_cache.cend()) {
-          p_material = Material { texture_cache.at(image.name).GetTextureID(), true };
-        } else {
-          texture_cache[image.name] = LoadGLTF_Texture(model.samplers[texture.sampler], image);
-          p_material = Material { texture_cache.at(image.name).GetTextureID(), true };
+  ImageDecodeQueue decode_queue(data);
+
+  for (const MeshData& mesh_data : data.meshes_) {
+    Mesh mesh;
+    mesh.local_transform_ = mesh_data.local_transform_;
+
+    for (const PrimitiveData& primitive : mesh_data.primitives_) {
+      MeshPrimitive mesh_p;
+
+      if (primitive.material_) {
+        const MaterialData& material_data = primitive.material_.value();
+
+        Material material;
+        if (material_data.texture_ >= 0) {
+          const TexturePlacement& placement = layout.placements_[material_data.texture_];
+          material.array_ = placement.array_;
+          material.layer_ = placement.layer_;
+          material.uv_rect_ = placement.uv_rect_;
         }
-      }
+        material.color_ = material_data.color_;
 
-      std::vector<double> color = material.pbrMetallicRoughness.baseColorFactor;
-      if (!color.empty()) {
-        p_material.color_ = glm::vec4(color[0], color[1], color[2], color[3]);
+        mesh_p.material_ = material;
       }
 
-      mesh_p.material_ = p_material;
+      mesh_p.bounds_ = primitive.bounds_;
+      mesh_p.features_ = primitive.features_;
+      if (!mesh_p.material_ || mesh_p.material_->array_ < 0) {
+        mesh_p.features_ &= ~kFeatureTextured;
+      }
+      const uint8_t* streams[kStreamCount] = {
+        primitive.streams_[kStreamPosition].data(),
+        primitive.streams_[kStreamShading].data()
+      };
+      mesh_p.primitive_ = Resources::CreatePrimitive(
+        primitive.layout_,
+        streams,
+        primitive.vertices_.size(),
+        primitive.index_count_, 
+        primitive.index_type_, 
+        primitive.indices_.data(),
+        primitive.indices_.size()
+      );
+      mesh.mesh_primitives_.push_back(mesh_p);
     }
-    
-    mesh_p.primitive_ = Graphics::CreatePrimitive(
-      vertices, 
-      index_count, 
-      index_type, 
-      joint_type, 
-      indices_data
-    );
-    result.mesh_primitives_.push_back(mesh_p);
-  }
-  
-  return result;
-}
 
-Joint ProcessJoint(const tinygltf::Model& model, const tinygltf::Node& joint) {
-  Joint curr;
-  curr.transform_ = glm::mat4(1.0);
-  
-  if (!joint.translation.empty()) {
-    curr.transform_ = glm::translate(
-      curr.transform_, 
-      glm::vec3(joint.translation[0], joint.translation[1], joint.translation[2])
-    );
+    meshes_.push_back(mesh);
   }
-  if (!joint.rotation.empty()) {
-    glm::quat rot(joint.rotation[3], joint.rotation[0], joint.rotation[1], joint.rotation[2]);
-    
-    float angle = glm::angle(rot);
-    glm::vec3 axis = glm::axis(rot);
-    
-    curr.transform_ = glm::rotate(curr.transform_, angle, axis);
-  }
-  if (!joint.scale.empty()) {
-    curr.transform_ = glm::scale(
-      curr.transform_, glm::vec3(joint.scale[0], joint.scale[1], joint.scale[2])
-    );
+
+  DecodedImage image;
+  while (decode_queue.WaitNext(image)) {
+    const TexturePlacement& placement = layout.placements_[image.texture_];
+    if (image.pixels_ != nullptr && placement.array_ >= 0) {
+      Resources::Get(textures_[placement.array_])->Upload(placement, image);
+    }
+    ImageDecodeQueue::Free(image);
   }
 
-  for (int32_t child_id : joint.children) {
-    curr.children_.emplace_back(ProcessJoint(model, model.nodes[child_id]));
+  for (TextureHandle texture : textures_) {
+    Resources::Get(texture)->GenerateMipmaps();
   }
-  
-  return curr;
+
+  skins_ = std::move(data.skins_);
 }
 
-void Model::Load(const std::string& filename) {
-  tinygltf::TinyGLTF loader;
+const std::vector<Skin>& Model::GetSkins() const {
+  return skins_;
+}
 
-  tinygltf::Model model;
-  std::string err;
-  std::string warn;
-  
-  bool success = loader.LoadBinaryFromFile(&model, &err, &warn, filename);
-  if (!err.empty()) {
-    std::cout << "[" << filename << "] ERROR: " << err << std::endl;
-  }
-  if (!warn.empty()) {
-    std::cout << "[" << filename << "] WARN: " << warn << std::endl;
-  }
-  assert(success && "Failed to parse GLTF");
+const std::vector<TextureHandle>& Model::GetTextures() const {
+  return textures_;
+}
 
-  for (const tinygltf::Node& node : model.nodes) {
-    if (node.mesh < 0) {
-      continue;
-    }
-    Mesh mesh = GetMesh(model, model.meshes[node.mesh], texture_cache_);
+const std::vector<OccluderMesh>& Model::GetOccluders() const {
+  return occluders_;
+}
 
-    glm::mat4 local(1.0);
-    
-    if (!node.translation.empty()) {
-      local = glm::translate(local, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
-    }
-    if (!node.rotation.empty()) {
-      glm::quat rot(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-      
-      float angle = glm::angle(rot);
-      glm::vec3 axis = glm::axis(rot);
-      
-      local = glm::rotate(local, angle, axis);
-    }
-    if (!node.scale.empty()) {
-      local = glm::scale(local, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
-    }
+const std::vector<TriangleBvh>& Model::GetBvhs() const {
+  return bvhs_;
+}
 
-    mesh.local_transform_ = local;
-    
-    meshes_.push_back(mesh);
+static uint32_t ReadIndex(const uint8_t* indices, uint32_t index_type, size_t i) {
+  if (index_type == GL_UNSIGNED_BYTE) {
+    return indices[i];
+  } else if (index_type == GL_UNSIGNED_SHORT) {
+    uint16_t index;
+    std::memcpy(&index, indices + i * sizeof(uint16_t), sizeof(uint16_t));
+    return index;
   }
+  uint32_t index;
+  std::memcpy(&index, indices + i * sizeof(uint32_t), sizeof(uint32_t));
+  return index;
+}
 
-  for (const tinygltf::Skin& skin : model.skins) {
-      Skin loaded_skin;
-      
-      const tinygltf::Accessor& inverse_bind_matrices = model.accessors[skin.inverseBindMatrices];
-      const tinygltf::BufferView& ibm_bv = model.bufferViews[inverse_bind_matrices.bufferView];
-      const tinygltf::Buffer& ibm_b = model.buffers[ibm_bv.buffer];
-
-      std::vector<uint8_t> data(
-        ibm_b.data.cbegin() + ibm_bv.byteOffset,
-        ibm_b.data.cbegin() + ibm_bv.byteOffset + ibm_bv.byteLength
-      );
+void Model::KeepOccluders(const ModelData& data) {
+  for (const MeshData& mesh_data : data.meshes_) {
+    for (const PrimitiveData& primitive : mesh_data.primitives_) {
+      if (primitive.features_ & kFeatureSkinned) {
+        continue;
+      }
 
-      constexpr size_t kMatrixSize = 64;
+      OccluderMesh occluder;
+      occluder.local_transform_ = mesh_data.local_transform_;
 
-      loaded_skin.root_ = ProcessJoint(model, model.nodes[skin.joints[0]]);
-      
-      for (int32_t i = 0; i < data.size() / kMatrixSize; ++i) {  
-        loaded_skin.inverse_bind_matrices_.emplace_back(
-          glm::make_mat4(
-            reinterpret_cast<float*>(data.data() + inverse_bind_matrices.ByteStride(ibm_bv) * i)
-          )
-        );
+      occluder.positions_.reserve(primitive.vertices_.size());
+      for (const Vertex& vertex : primitive.vertices_) {
+        occluder.positions_.push_back(vertex.pos_);
       }
 
-      skins_.push_back(loaded_skin);
-  }
+      // Non-indexed primitives draw their vertices in order
+      if (primitive.index_count_ > 0) {
+        occluder.indices_.reserve(primitive.index_count_);
+        for (size_t i = 0; i < primitive.index_count_; ++i) {
+          occluder.indices_.push_back(ReadIndex(primitive.indices_.data(), primitive.index_type_, i));
+        }
+      } else {
+        occluder.indices_.resize(primitive.vertices_.size());
+        std::iota(occluder.indices_.begin(), occluder.indices_.end(), 0);
+      }
 
-  is_loaded_ = true;
-}
+      bvhs_.emplace_back();
+      bvhs_.back().Build(occluder.positions_.data(), occluder.indices_.data(), occluder.indices_.size() / 3);
 
-const std::vector<Skin>& Model::GetSkins() const {
-  return skins_;
+      occluders_.push_back(std::move(occluder));
+    }
+  }
 }
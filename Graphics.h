@@ -6,9 +6,41 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include <vector>
+#include <string>
+#include <optional>
+#include <unordered_map>
 #include <cstdint>
 
-#include <tiny_gltf.h>
+#include "AssetDecoder.h"
+#include "TexturePacker.h"
+#include "ResourcePool.h"
+#include "OcclusionCuller.h"
+#include "SkinPalette.h"
+#include "Bvh.h"
+
+constexpr int32_t kMaxBones = 100;
+
+constexpr uint32_t kFrameUniformBinding = 0;
+constexpr uint32_t kDrawUniformBinding = 1;
+constexpr uint32_t kSkinUniformBinding = 2;
+
+// Mirror the std140 uniform blocks in shaders/model.glsl and shaders/skinning.glsl
+struct FrameUniforms {
+  glm::mat4 view_projection_;
+  SkinningMode skinning_;
+  int32_t padding_[3];
+};
+
+// SkinUniforms holds a SkinPalette, sized for the largest layout
+constexpr size_t kSkinUniformsSize = kMaxBones * 3 * sizeof(glm::vec4);
+
+struct DrawUniforms {
+  glm::mat4 model_;
+  glm::vec4 base_color_;
+  glm::vec4 uv_rect_;
+  int32_t layer_;
+  int32_t padding_[3];
+};
 
 struct Color {
   uint8_t r;
@@ -17,35 +49,78 @@ struct Color {
   uint8_t a;
 };
 
-struct Vertex {
+// Vertices are uploaded as two streams so depth-only passes fetch what
+// positions need and nothing else
+struct PositionVertex {
   glm::vec3 pos_;
-  glm::vec2 tex_coords_;
-  glm::vec3 normal_;
   glm::ivec4 joints_;
   glm::vec4 weights_;
 };
 
+struct ShadingVertex {
+  glm::vec2 tex_coords_;
+  glm::vec3 normal_;
+};
+
+// What drawing a primitive reads
 struct Primitive {
-  std::vector<Vertex> vertices_;
-  
+  uint32_t vertex_count_;
   uint32_t index_count_;
   uint32_t index_type_;
-  uint32_t joint_type_;
 
+  // Every attribute, for shading
+  uint32_t vao_;
+  // Positions, joints and weights only
+  uint32_t depth_vao_;
+};
+
+// The rest, only needed to build other vertex arrays over the same data
+// and to delete it. Kept apart from Primitive in the resource pool.
+struct PrimitiveBuffers {
+  VertexLayout layout_;
+
+  uint32_t position_vbo_;
   uint32_t vbo_;
   uint32_t ebo_;
+};
+
+using PrimitiveHandle = Handle<Primitive>;
+
+// Skinned copy of a primitive's vertices, positions and normals in separate
+// buffers written by SkinCache through transform feedback. Drawn with a
+// static vertex shader, texcoords and indices still come from the source
+// primitive.
+struct SkinnedPrimitive {
+  uint32_t position_buffer_;
+  uint32_t normal_buffer_;
   uint32_t vao_;
+  uint32_t depth_vao_;
+
+  uint32_t vertex_count_;
+  uint32_t index_count_;
+  uint32_t index_type_;
 };
 
+constexpr uint32_t kShaderVariantCount = 1 << kFeatureCount;
+
 class Shader {
 public:
-  void LoadShader(const std::string& filename);
+  // Vertex and fragment stage separated by #SPLIT. Each feature bit set
+  // defines its name (SKINNED, TEXTURED) in both stages, SKINNED also adds
+  // skinning.glsl from the same directory to the vertex stage.
+  void LoadShader(const std::string& filename, uint32_t features = 0);
+  // Vertex stage only, varying i is captured into transform feedback binding i
+  void LoadFeedbackShader(
+    const std::string& filename, const char* const* varyings, int32_t varying_count, uint32_t features = 0
+  );
   void UnloadShader();
   
   void Enable() const;
   void Disable() const;  
 
+  uint32_t GetProgram() const;
   int32_t GetUniformLocation(const char* uniform) const;
+  void SetUniformBlockBinding(const char* block, uint32_t binding) const;
 
   void SetUniformInt(int32_t location, int32_t value) const;
   void SetUniformFloat(int32_t location, float value) const;
@@ -58,6 +133,34 @@ private:
   uint32_t fragment_shader_;
 };
 
+using ShaderHandle = Handle<Shader>;
+
+// The variants of one shader file, compiled as they are asked for.
+// Require compiles on the context thread. Get only looks one up, so
+// recording threads can use it once every variant they need exists.
+class ShaderVariants {
+public:
+  void Create(const std::string& filename);
+  void Destroy();
+
+  // Kept and applied to variants compiled later too
+  void SetUniformBlockBinding(const char* block, uint32_t binding);
+  void SetSampler(const char* sampler, int32_t slot);
+
+  const Shader& Require(uint32_t features);
+  const Shader& Get(uint32_t features) const;
+
+  uint32_t GetVariantCount() const;
+private:
+  void Configure(const Shader& shader) const;
+private:
+  std::string filename_;
+  ShaderHandle variants_[kShaderVariantCount];
+
+  std::vector<std::pair<std::string, uint32_t>> block_bindings_;
+  std::vector<std::pair<std::string, int32_t>> samplers_;
+};
+
 class Texture {
 public:
   Texture() = default;
@@ -74,16 +177,42 @@ private:
   uint32_t id_;
 };
 
+class TextureArray {
+public:
+  TextureArray() = default;
+  TextureArray(uint32_t id);
+
+  void Create(const TextureArrayDesc& desc);
+  void UnloadTexture();
+
+  void Upload(const TexturePlacement& placement, const DecodedImage& image);
+  void GenerateMipmaps();
+
+  void Bind(int32_t slot) const;
+  void Unbind() const;
+
+  uint32_t GetTextureID() const;
+private:
+  uint32_t id_;
+};
+
+using TextureHandle = Handle<TextureArray>;
+
 struct Material {
-  uint32_t texture_id_;
-  bool has_texture_;
+  // Index into Model::GetTextures(), -1 when untextured
+  int32_t array_ = -1;
+  int32_t layer_ = 0;
+  glm::vec4 uv_rect_ = glm::vec4(1.0, 1.0, 0.0, 0.0);
 
   glm::vec4 color_ = glm::vec4(0.0, 0.0, 0.0, 1.0);
 };
 
 struct MeshPrimitive {
-  Primitive primitive_;
+  PrimitiveHandle primitive_;
   std::optional<Material> material_;
+  Aabb bounds_;
+  // kFeature bits, textured only once the texture made it into an array
+  uint32_t features_;
 };
 
 struct Mesh {
@@ -91,50 +220,86 @@ struct Mesh {
   glm::mat4 local_transform_;
 };
 
-struct Joint {
-  glm::mat4 transform_;
-  std::vector<Joint> children_;
-};
-
-struct Skin {
-  Joint root_;
-  std::vector<glm::mat4> inverse_bind_matrices_;
-};
-
+// Plain data once loaded, the GL objects it references belong to Resources
 class Model {
 public:
-  Model() = default;
-  ~Model();
-  
-  void Load(const std::string& filename);
+  // Occluders keep a CPU copy of every unskinned primitive's positions and
+  // indices. Skinned primitives are left out since their bind pose doesn't
+  // match what gets drawn.
+  void Load(const std::string& filename, bool keep_occluders = false);
+  // Hands the model's primitives and textures back to Resources for deferred destruction
+  void Unload();
 
   const std::vector<Mesh>& GetMeshes() const;
   const std::vector<Skin>& GetSkins() const;
+  const std::vector<TextureHandle>& GetTextures() const;
+  // Empty unless loaded with keep_occluders
+  const std::vector<OccluderMesh>& GetOccluders() const;
+  // One per occluder in the same order, also only with keep_occluders
+  const std::vector<TriangleBvh>& GetBvhs() const;
+
+  // Shared by every Load, reset once a model's data is on the GPU
+  static const LinearArena& GetScratchArena();
 private:    
   std::vector<Mesh> meshes_;
   std::vector<Skin> skins_;
-  std::unordered_map<std::string, Texture> texture_cache_;
+  std::vector<TextureHandle> textures_;
+  std::vector<OccluderMesh> occluders_;
+  std::vector<TriangleBvh> bvhs_;
 private:
-  bool is_loaded_;
+  void Upload(ModelData& data);
+  void KeepOccluders(const ModelData& data);
 };
 
+using ModelHandle = Handle<Model>;
+
 class Graphics {
 public:  
   static void ClearColor(Color color);
   
   static void RenderPrimitive(const Primitive& primitive);
   static void RenderPrimitiveIndexed(const Primitive& primitive);
+  static void RenderSkinned(const SkinnedPrimitive& skinned);
+
+  // Position stream only, for depth prepasses
+  static void RenderPrimitiveDepth(const Primitive& primitive);
+  static void RenderSkinnedDepth(const SkinnedPrimitive& skinned);
+
+  // Color writes off for the prepass, then GL_EQUAL without depth writes
+  // for the passes that follow it until ResetDepthState
+  static void BeginDepthPrepass();
+  static void EndDepthPrepass();
+  static void ResetDepthState();
   
+  // Uploads float vertices, joints are read as joint_type
   static Primitive CreatePrimitive(
-    const std::vector<Vertex>& vertices, 
+    const Vertex* vertices, 
+    size_t vertex_count,
     uint32_t index_count,
     uint32_t index_type,
     uint32_t joint_type,
-    const std::vector<uint8_t>& raw_indices = {}
+    PrimitiveBuffers& buffers,
+    const uint8_t* raw_indices = nullptr,
+    size_t raw_indices_size = 0
   );
+  // Uploads streams laid out as layout describes, one per kStream
+  static Primitive CreatePrimitive(
+    const VertexLayout& layout,
+    const uint8_t* const (&streams)[kStreamCount],
+    size_t vertex_count,
+    uint32_t index_count,
+    uint32_t index_type,
+    PrimitiveBuffers& buffers,
+    const uint8_t* raw_indices = nullptr,
+    size_t raw_indices_size = 0
+  );
+
+  // Points an attribute at the buffer bound to GL_ARRAY_BUFFER, which has to
+  // hold its stream. Attributes the layout lacks are left disabled.
+  static void SetVertexAttribute(const VertexLayout& layout, uint32_t attribute);
 
   //Assumes that attributes have been set
-  static void DestroyPrimitive(Primitive& primitive);
+  static void DestroyPrimitive(Primitive& primitive, PrimitiveBuffers& buffers);
   
 public:
   constexpr static Color kRed { 255, 0, 0, 255 };
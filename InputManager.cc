@@ -1,43 +1,86 @@
 #include "InputManager.h"
 
+#include <cassert>
 
-InputManager::InputManager() {
-  
+InputManager::InputManager() : action_count_(0) {
+  table_ids_.fill(0);
+  table_slots_.fill(kNoSlot);
+  key_slots_.fill(kNoSlot);
+  held_.fill(0);
 }
 
-std::optional<std::string> InputManager::GetAction(Key key) const {
-  if (action_map_.find(KeyInt(key)) == action_map_.cend()) {
-    return {};
+uint8_t InputManager::FindSlot(ActionId action) const {
+  size_t i = action & kTableMask;
+  while (table_slots_[i] != kNoSlot && table_ids_[i] != action) {
+    i = (i + 1) & kTableMask;
   }
-  return action_map_.at(KeyInt(key));
+  return table_slots_[i];
 }
 
-void InputManager::AddAction(Key key, const std::string& action) {
-  action_map_[KeyInt(key)] = action;
+void InputManager::AddAction(Key key, ActionId action) {
+  uint8_t slot = FindSlot(action);
+  if (slot == kNoSlot) {
+    assert(action_count_ < kMaxActions && "Too many input actions");
+
+    size_t i = action & kTableMask;
+    while (table_slots_[i] != kNoSlot) {
+      i = (i + 1) & kTableMask;
+    }
+    slot = action_count_++;
+    table_ids_[i] = action;
+    table_slots_[i] = slot;
+    registered_.set(slot);
+  }
+  key_slots_[size_t(key)] = slot;
 }
 
-bool InputManager::ActionExists(const std::string& action) const {
-  return actions_.find(action) != actions_.cend();
+bool InputManager::ActionExists(ActionId action) const {
+  return registered_[FindSlot(action)];
 }
 
-bool InputManager::IsActionUp(const std::string& action) const {
-  if (!ActionExists(action)) {
-    return false;
-  }
-  ActionType type = actions_.at(action).type_;
-  return type == ActionType::kRelease;
+bool InputManager::IsActionUp(ActionId action) const {
+  uint8_t slot = FindSlot(action);
+  return registered_[slot] && !down_[slot];
 }
 
-bool InputManager::IsActionDown(const std::string& action) const {
-  if (!ActionExists(action)) {
-    return false;
-  }
-  ActionType type = actions_.at(action).type_;
-  return type == ActionType::kPress;
+bool InputManager::IsActionDown(ActionId action) const {
+  return down_[FindSlot(action)];
+}
+
+bool InputManager::IsActionPressed(ActionId action) const {
+  return pressed_[FindSlot(action)];
+}
+
+bool InputManager::IsActionReleased(ActionId action) const {
+  return released_[FindSlot(action)];
 }
 
-void InputManager::RegisterInputs() {
-  for (auto& [_, action] : action_map_) {
-    actions_.insert(std::make_pair(action, Action(action, ActionType::kRelease)));
+void InputManager::NewFrame() {
+  pressed_.reset();
+  released_.reset();
+}
+
+void InputManager::SetKey(KeyInt key, ActionType type) {
+  if (key < 0 || size_t(key) >= kKeyCount) {
+    return;
+  }
+
+  bool down = type == ActionType::kPress;
+  if (keys_down_[key] == down) {
+    return;
   }
+  keys_down_[key] = down;
+
+  uint8_t slot = key_slots_[key];
+  if (slot == kNoSlot) {
+    return;
+  }
+
+  bool was_down = held_[slot] != 0;
+  held_[slot] += down ? 1 : -1;
+  bool is_down = held_[slot] != 0;
+
+  down_[slot] = is_down;
+  pressed_[slot] = pressed_[slot] || (is_down && !was_down);
+  released_[slot] = released_[slot] || (was_down && !is_down);
 }
@@ -2,9 +2,10 @@
 #define INPUT_MANAGER_H_
 
 #include <cstdint>
-#include <string>
-#include <optional>
-#include <unordered_map>
+#include <cstddef>
+#include <string_view>
+#include <array>
+#include <bitset>
 
 enum class Key : uint16_t {
   kKeySpace = 32,
@@ -129,38 +130,78 @@ enum class Key : uint16_t {
 };
 
 using KeyInt = int32_t;
+using ActionId = uint32_t;
 
 enum class ActionType {
   kRelease,
   kPress,
 };
 
-struct Action {
-  std::string name_;
+struct InputEvent {
+  int64_t timestamp_ns_;
+  KeyInt key_;
   ActionType type_;
-
-  Action() = default;
-  Action(const std::string& name, ActionType type) : name_(name), type_(type) {}
 };
 
+// FNV-1a, so action names can be turned into IDs at compile time:
+//   constexpr ActionId kQuit = HashAction("Quit");
+constexpr ActionId HashAction(std::string_view name) {
+  ActionId hash = 2166136261u;
+  for (char c : name) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  return hash;
+}
+
 class InputManager {
 public:
+  constexpr static size_t kMaxActions = 64;
+  constexpr static size_t kKeyCount = size_t(Key::kKeyMenu) + 1;
+
   InputManager();
   
-  void AddAction(Key key, const std::string& action);
-  
-  bool IsActionUp(const std::string& action) const;
-  bool IsActionDown(const std::string& action) const;
+  void AddAction(Key key, ActionId action);
   
-  void RegisterInputs();
+  bool IsActionUp(ActionId action) const;
+  bool IsActionDown(ActionId action) const;
 
-  std::optional<std::string> GetAction(Key key) const;
+  // Edges, only true during the frame the action changed state
+  bool IsActionPressed(ActionId action) const;
+  bool IsActionReleased(ActionId action) const;
 
-  bool ActionExists(const std::string& action) const;
+  bool ActionExists(ActionId action) const;
 private:
   friend class App;
-  std::unordered_map<std::string, Action> actions_;
-  std::unordered_map<KeyInt, std::string> action_map_;
+
+  void NewFrame();
+  void SetKey(KeyInt key, ActionType type);
+
+  uint8_t FindSlot(ActionId action) const;
+private:
+  // Open addressed ActionId -> slot table, kept at most half full
+  constexpr static size_t kTableSize = kMaxActions * 2;
+  constexpr static size_t kTableMask = kTableSize - 1;
+
+  // Slot that is never bound, so lookups of unknown actions read a zero bit
+  // instead of branching
+  constexpr static uint8_t kNoSlot = kMaxActions;
+
+  using ActionBits = std::bitset<kMaxActions + 1>;
+
+  std::array<ActionId, kTableSize> table_ids_;
+  std::array<uint8_t, kTableSize> table_slots_;
+  uint8_t action_count_;
+
+  std::array<uint8_t, kKeyCount> key_slots_;
+  std::bitset<kKeyCount> keys_down_;
+
+  // Number of bound keys currently held per action
+  std::array<uint8_t, kMaxActions + 1> held_;
+
+  ActionBits registered_;
+  ActionBits down_;
+  ActionBits pressed_;
+  ActionBits released_;
 };
 
 
@@ -0,0 +1,95 @@
+#include "InputRecorder.h"
+
+#include <iostream>
+
+constexpr uint32_t kMagic = 0x43524e49; // "INRC"
+constexpr uint32_t kVersion = 1;
+
+struct RecordingHeader {
+  uint32_t magic_;
+  uint32_t version_;
+  int64_t timestep_ns_;
+};
+
+struct FrameHeader {
+  int64_t delta_ns_;
+  uint32_t event_count_;
+};
+
+bool InputRecorder::Open(const std::string& filename, int64_t timestep_ns) {
+  file_.open(filename, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    std::cerr << "[" << filename << "] UNABLE TO OPEN INPUT RECORDING" << std::endl;
+    return false;
+  }
+
+  RecordingHeader header { kMagic, kVersion, timestep_ns };
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  return true;
+}
+
+void InputRecorder::Close() {
+  file_.close();
+}
+
+bool InputRecorder::IsOpen() const {
+  return file_.is_open();
+}
+
+void InputRecorder::RecordFrame(int64_t delta_ns, const InputEvent* events, size_t count) {
+  // Value initialized so the padding isn't written out as stack garbage
+  FrameHeader frame {};
+  frame.delta_ns_ = delta_ns;
+  frame.event_count_ = static_cast<uint32_t>(count);
+  file_.write(reinterpret_cast<const char*>(&frame), sizeof(frame));
+  file_.write(reinterpret_cast<const char*>(events), sizeof(InputEvent) * count);
+}
+
+bool InputReplay::Open(const std::string& filename) {
+  file_.open(filename, std::ios::binary);
+  if (!file_.is_open()) {
+    std::cerr << "[" << filename << "] UNABLE TO OPEN INPUT RECORDING" << std::endl;
+    return false;
+  }
+
+  RecordingHeader header;
+  file_.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file_ || header.magic_ != kMagic || header.version_ != kVersion) {
+    std::cerr << "[" << filename << "] NOT A VALID INPUT RECORDING" << std::endl;
+    file_.close();
+    return false;
+  }
+
+  timestep_ns_ = header.timestep_ns_;
+  return true;
+}
+
+void InputReplay::Close() {
+  file_.close();
+}
+
+bool InputReplay::IsOpen() const {
+  return file_.is_open();
+}
+
+bool InputReplay::NextFrame(int64_t& delta_ns, std::vector<InputEvent>& events) {
+  FrameHeader frame {};
+  if (!file_.read(reinterpret_cast<char*>(&frame), sizeof(frame)) || frame.event_count_ > InputEventQueue::GetCapacity()) {
+    events.clear();
+    return false;
+  }
+
+  events.resize(frame.event_count_);
+  file_.read(reinterpret_cast<char*>(events.data()), sizeof(InputEvent) * frame.event_count_);
+  if (!file_) {
+    events.clear();
+    return false;
+  }
+
+  delta_ns = frame.delta_ns_;
+  return true;
+}
+
+int64_t InputReplay::GetTimeStepNs() const {
+  return timestep_ns_;
+}
@@ -0,0 +1,49 @@
+#ifndef INPUT_RECORDER_H_
+#define INPUT_RECORDER_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "InputManager.h"
+#include "RingBuffer.h"
+
+// Key events on their way from the window callback to the frame. No more
+// than one queue's worth is applied per frame, recorded or not.
+using InputEventQueue = RingBuffer<InputEvent, 1024>;
+
+// Serializes a session's input as a sequence of frames, each holding the
+// frame delta and the events applied that frame, so it can be fed back
+// frame for frame on another build.
+class InputRecorder {
+public:
+  bool Open(const std::string& filename, int64_t timestep_ns);
+  void Close();
+
+  bool IsOpen() const;
+
+  void RecordFrame(int64_t delta_ns, const InputEvent* events, size_t count);
+private:
+  std::ofstream file_;
+};
+
+class InputReplay {
+public:
+  bool Open(const std::string& filename);
+  void Close();
+
+  bool IsOpen() const;
+
+  // Replaces events with the next recorded frame. False once exhausted or
+  // when the frame is damaged, events is left empty then.
+  bool NextFrame(int64_t& delta_ns, std::vector<InputEvent>& events);
+
+  // The simulation timestep the session was recorded with
+  int64_t GetTimeStepNs() const;
+private:
+  std::ifstream file_;
+  int64_t timestep_ns_ = 0;
+};
+
+#endif
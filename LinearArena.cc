@@ -0,0 +1,110 @@
+#include "LinearArena.h"
+
+#include <iostream>
+#include <algorithm>
+
+static size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+LinearArena::LinearArena(const char* name, size_t capacity) 
+  : name_(name), initial_capacity_(capacity), capacity_(capacity), retired_(0), offset_(0), high_water_(0), overflow_count_(0) {}
+
+LinearArena::~LinearArena() {
+  for (Block& block : blocks_) {
+    delete[] block.data_;
+  }
+}
+
+void LinearArena::AddBlock(size_t size) {
+  if (!blocks_.empty()) {
+    retired_ += offset_;
+  }
+  blocks_.push_back(Block { new uint8_t[size], size });
+  offset_ = 0;
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+  // Blocks are allocated lazily so unused arenas cost nothing
+  if (blocks_.empty()) {
+    AddBlock(capacity_);
+  }
+
+  Block* block = &blocks_.back();
+  uintptr_t base = reinterpret_cast<uintptr_t>(block->data_);
+  size_t start = AlignUp(base + offset_, alignment) - base;
+
+  if (start + size > block->size_) {
+    ++overflow_count_;
+    AddBlock(std::max(capacity_, size + alignment));
+
+    block = &blocks_.back();
+    base = reinterpret_cast<uintptr_t>(block->data_);
+    start = AlignUp(base, alignment) - base;
+  }
+
+  offset_ = start + size;
+  return block->data_ + start;
+}
+
+void LinearArena::Reset() {
+  high_water_ = std::max(high_water_, GetUsed());
+
+  if (blocks_.size() > 1) {
+    size_t total = 0;
+    for (Block& block : blocks_) {
+      total += block.size_;
+      delete[] block.data_;
+    }
+    blocks_.clear();
+
+    capacity_ = total;
+    AddBlock(capacity_);
+  }
+
+  retired_ = 0;
+  offset_ = 0;
+}
+
+void LinearArena::Shrink() {
+  if (blocks_.size() <= 1 && capacity_ <= initial_capacity_) {
+    Reset();
+    return;
+  }
+
+  high_water_ = std::max(high_water_, GetUsed());
+  for (Block& block : blocks_) {
+    delete[] block.data_;
+  }
+  blocks_.clear();
+
+  capacity_ = initial_capacity_;
+  retired_ = 0;
+  offset_ = 0;
+}
+
+size_t LinearArena::GetUsed() const {
+  return retired_ + offset_;
+}
+
+size_t LinearArena::GetHighWater() const {
+  return std::max(high_water_, GetUsed());
+}
+
+size_t LinearArena::GetCapacity() const {
+  return capacity_;
+}
+
+size_t LinearArena::GetOverflowCount() const {
+  return overflow_count_;
+}
+
+const char* LinearArena::GetName() const {
+  return name_;
+}
+
+void LinearArena::Report() const {
+  std::cout 
+    << "[" << name_ << "] high water " << GetHighWater() / 1024 << " KB of " 
+    << capacity_ / 1024 << " KB, " << overflow_count_ << " overflows" << std::endl;
+}
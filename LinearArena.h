@@ -0,0 +1,105 @@
+#ifndef LINEAR_ARENA_H_
+#define LINEAR_ARENA_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// Bump allocator whose allocations are all released together by Reset.
+// Running out of space chains another block instead of failing, and the
+// next Reset folds everything into one block sized to the total, so steady
+// state usage settles into a single block with no further heap traffic.
+class LinearArena {
+public:
+  LinearArena(const char* name, size_t capacity);
+  ~LinearArena();
+
+  LinearArena(const LinearArena&) = delete;
+  LinearArena& operator=(const LinearArena&) = delete;
+
+  void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  void Reset();
+  // Reset, but anything grown past the constructed capacity is freed instead
+  // of folded into one block. For arenas whose peaks are rare, like loading.
+  void Shrink();
+
+  size_t GetUsed() const;
+  size_t GetHighWater() const;
+  size_t GetCapacity() const;
+  // Number of times a block had to be chained since construction
+  size_t GetOverflowCount() const;
+  const char* GetName() const;
+
+  void Report() const;
+private:
+  struct Block {
+    uint8_t* data_;
+    size_t size_;
+  };
+
+  void AddBlock(size_t size);
+private:
+  const char* name_;
+  size_t initial_capacity_;
+  size_t capacity_;
+
+  std::vector<Block> blocks_;
+  // Bytes used in every block before the current one
+  size_t retired_;
+  size_t offset_;
+
+  size_t high_water_;
+  size_t overflow_count_;
+};
+
+// Lets std containers allocate from a LinearArena. deallocate is a no-op,
+// memory comes back on Reset. A null arena falls back to the heap.
+template <typename T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() = default;
+  ArenaAllocator(LinearArena* arena) : arena_(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.GetArena()) {}
+
+  T* allocate(size_t count) {
+    if (arena_ == nullptr) {
+      return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+    return static_cast<T*>(arena_->Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* pointer, size_t count) {
+    if (arena_ == nullptr) {
+      ::operator delete(pointer);
+    }
+  }
+
+  LinearArena* GetArena() const {
+    return arena_;
+  }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return arena_ == other.GetArena();
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const {
+    return arena_ != other.GetArena();
+  }
+private:
+  LinearArena* arena_ = nullptr;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+enum class MappedAccess {
+  kSequential,
+  kRandom,
+  kWillNeed,
+  // The range won't be read again, its pages can be dropped
+  kDontNeed,
+};
+
+// Read-only view of a whole file through the page cache. Pages are only
+// read in as they are touched and stay reclaimable, so large files cost far
+// less than reading them into a heap buffer.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  bool Open(const std::string& filename);
+  void Close();
+
+  // A hint only, ranges are widened to whole pages
+  void Advise(size_t offset, size_t size, MappedAccess access) const;
+
+  const uint8_t* GetData() const;
+  size_t GetSize() const;
+  bool IsOpen() const;
+private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,697 @@
+// Ported from meshoptimizer's vertexcodec.cpp, indexcodec.cpp and
+// vertexfilter.cpp (https://github.com/zeux/meshoptimizer), under its license:
+//
+// MIT License
+//
+// Copyright (c) 2016-2024 Arseny Kapoulkine
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "MeshoptDecoder.h"
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// SSSE3 is picked at runtime, the rest of the build doesn't need -mssse3
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MESHOPT_SSSE3
+#include <tmmintrin.h>
+#endif
+
+constexpr uint8_t kVertexHeader = 0xa0;
+constexpr uint8_t kIndexHeader = 0xe0;
+constexpr uint8_t kSequenceHeader = 0xd0;
+
+constexpr size_t kByteGroupSize = 16;
+// Worst case for one group: 16 raw bytes, or a packed group plus escapes
+constexpr size_t kByteGroupDecodeLimit = 24;
+constexpr size_t kVertexBlockSizeBytes = 8192;
+constexpr size_t kVertexBlockMaxSize = 256;
+constexpr size_t kTailMinSize = 32;
+constexpr size_t kMaxVertexSize = 256;
+
+static size_t VertexBlockSize(size_t stride) {
+  size_t result = kVertexBlockSizeBytes / stride;
+  result &= ~(kByteGroupSize - 1);
+  return std::min(result, kVertexBlockMaxSize);
+}
+
+// Each group of 16 bytes is stored with 0, 2, 4 or 8 bits per byte. Packed
+// values with every bit set are escapes, their byte follows the packed data.
+template <int32_t Bits>
+static const uint8_t* DecodePackedGroup(const uint8_t* data, uint8_t* out) {
+  constexpr int32_t kPerByte = 8 / Bits;
+  constexpr uint8_t kEscape = (1 << Bits) - 1;
+
+  const uint8_t* escapes = data + kByteGroupSize / kPerByte;
+  for (size_t i = 0; i < kByteGroupSize / kPerByte; ++i) {
+    uint8_t byte = data[i];
+    for (int32_t j = 0; j < kPerByte; ++j) {
+      uint8_t value = byte >> (8 - Bits);
+      byte <<= Bits;
+
+      bool escaped = value == kEscape;
+      *out++ = escaped ? *escapes : value;
+      escapes += escaped;
+    }
+  }
+  return escapes;
+}
+
+static const uint8_t* DecodeBytesGroup(const uint8_t* data, uint8_t* out, int32_t bitslog2) {
+  switch (bitslog2) {
+    case 0:
+      std::memset(out, 0, kByteGroupSize);
+      return data;
+    case 1:
+      return DecodePackedGroup<2>(data, out);
+    case 2:
+      return DecodePackedGroup<4>(data, out);
+    default:
+      std::memcpy(out, data, kByteGroupSize);
+      return data + kByteGroupSize;
+  }
+}
+
+static const uint8_t* DecodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* out, size_t size) {
+  // Two bits of mode per group
+  size_t header_size = (size / kByteGroupSize + 3) / 4;
+  if (size_t(end - data) < header_size) {
+    return nullptr;
+  }
+
+  const uint8_t* header = data;
+  data += header_size;
+
+  for (size_t i = 0; i < size; i += kByteGroupSize) {
+    if (size_t(end - data) < kByteGroupDecodeLimit) {
+      return nullptr;
+    }
+
+    size_t group = i / kByteGroupSize;
+    int32_t bitslog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+    data = DecodeBytesGroup(data, out + i, bitslog2);
+  }
+
+  return data;
+}
+
+// Bytes are stored one channel at a time as zigzag deltas from the previous
+// vertex, so the block is decoded per byte lane and transposed back
+static const uint8_t* DecodeVertexBlock(
+  const uint8_t* data,
+  const uint8_t* end,
+  uint8_t* vertices,
+  size_t count,
+  size_t stride,
+  uint8_t* last_vertex
+) {
+  uint8_t lane[kVertexBlockMaxSize];
+  uint8_t transposed[kVertexBlockSizeBytes];
+
+  size_t count_aligned = (count + kByteGroupSize - 1) & ~(kByteGroupSize - 1);
+
+  for (size_t k = 0; k < stride; ++k) {
+    data = DecodeBytes(data, end, lane, count_aligned);
+    if (data == nullptr) {
+      return nullptr;
+    }
+
+    uint8_t previous = last_vertex[k];
+    for (size_t i = 0; i < count; ++i) {
+      uint8_t delta = uint8_t(-(lane[i] & 1) ^ (lane[i] >> 1));
+      previous = uint8_t(previous + delta);
+      transposed[i * stride + k] = previous;
+    }
+  }
+
+  std::memcpy(vertices, transposed, count * stride);
+  std::memcpy(last_vertex, &transposed[stride * (count - 1)], stride);
+
+  return data;
+}
+
+#ifdef MESHOPT_SSSE3
+
+// For the 8 values of half a group, which of them are escapes: where each
+// takes its byte from, 0x80 for none, and how many bytes they take
+struct EscapeTables {
+  uint8_t shuffle_[256][8];
+  uint8_t count_[256];
+};
+
+static constexpr EscapeTables BuildEscapeTables() {
+  EscapeTables tables {};
+  for (int32_t mask = 0; mask < 256; ++mask) {
+    uint8_t count = 0;
+    for (int32_t i = 0; i < 8; ++i) {
+      tables.shuffle_[mask][i] = (mask & (1 << i)) ? count++ : 0x80;
+    }
+    tables.count_[mask] = count;
+  }
+  return tables;
+}
+
+static constexpr EscapeTables kEscapeTables = BuildEscapeTables();
+
+// Values equal to escape are replaced by the bytes that follow the packed
+// data, in order. Reads 16 bytes from rest, which DecodeBytes guarantees.
+__attribute__((target("ssse3")))
+static const uint8_t* ExpandEscapesSsse3(__m128i values, __m128i escape, const uint8_t* rest, uint8_t* out) {
+  __m128i mask = _mm_cmpeq_epi8(values, escape);
+  int32_t mask16 = _mm_movemask_epi8(mask);
+  uint8_t mask0 = uint8_t(mask16 & 255);
+  uint8_t mask1 = uint8_t(mask16 >> 8);
+
+  // The upper half continues after the bytes the lower half used
+  __m128i shuffle0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(kEscapeTables.shuffle_[mask0]));
+  __m128i shuffle1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(kEscapeTables.shuffle_[mask1]));
+  shuffle1 = _mm_add_epi8(shuffle1, _mm_set1_epi8(char(kEscapeTables.count_[mask0])));
+  __m128i shuffle = _mm_unpacklo_epi64(shuffle0, shuffle1);
+
+  __m128i escaped = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rest)), shuffle);
+  __m128i result = _mm_or_si128(escaped, _mm_andnot_si128(mask, values));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), result);
+
+  return rest + kEscapeTables.count_[mask0] + kEscapeTables.count_[mask1];
+}
+
+// Same output as DecodeBytesGroup. The packed values are spread to one per
+// byte with shifts and unpacks, high bits first.
+__attribute__((target("ssse3")))
+static const uint8_t* DecodeBytesGroupSsse3(const uint8_t* data, uint8_t* out, int32_t bitslog2) {
+  switch (bitslog2) {
+    case 0:
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_setzero_si128());
+      return data;
+    case 1: {
+      int32_t packed;
+      std::memcpy(&packed, data, sizeof(packed));
+      __m128i sel2 = _mm_cvtsi32_si128(packed);
+      __m128i sel22 = _mm_unpacklo_epi8(_mm_srli_epi16(sel2, 4), sel2);
+      __m128i sel2222 = _mm_unpacklo_epi8(_mm_srli_epi16(sel22, 2), sel22);
+      __m128i values = _mm_and_si128(sel2222, _mm_set1_epi8(3));
+      return ExpandEscapesSsse3(values, _mm_set1_epi8(3), data + 4, out);
+    }
+    case 2: {
+      __m128i sel4 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+      __m128i sel44 = _mm_unpacklo_epi8(_mm_srli_epi16(sel4, 4), sel4);
+      __m128i values = _mm_and_si128(sel44, _mm_set1_epi8(15));
+      return ExpandEscapesSsse3(values, _mm_set1_epi8(15), data + 8, out);
+    }
+    default:
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+      return data + kByteGroupSize;
+  }
+}
+
+__attribute__((target("ssse3")))
+static const uint8_t* DecodeBytesSsse3(const uint8_t* data, const uint8_t* end, uint8_t* out, size_t size) {
+  size_t header_size = (size / kByteGroupSize + 3) / 4;
+  if (size_t(end - data) < header_size) {
+    return nullptr;
+  }
+
+  const uint8_t* header = data;
+  data += header_size;
+
+  for (size_t i = 0; i < size; i += kByteGroupSize) {
+    if (size_t(end - data) < kByteGroupDecodeLimit) {
+      return nullptr;
+    }
+
+    size_t group = i / kByteGroupSize;
+    int32_t bitslog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+    data = DecodeBytesGroupSsse3(data, out + i, bitslog2);
+  }
+
+  return data;
+}
+
+// Zigzag deltas of 16 vertices to values, previous holds the value before
+// them in every byte
+__attribute__((target("ssse3")))
+static __m128i DecodeDeltasSsse3(__m128i zigzag, __m128i previous) {
+  __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(zigzag, _mm_set1_epi8(1)));
+  __m128i magnitude = _mm_and_si128(_mm_srli_epi16(zigzag, 1), _mm_set1_epi8(127));
+  __m128i delta = _mm_xor_si128(sign, magnitude);
+
+  delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 1));
+  delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 2));
+  delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 4));
+  delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 8));
+  return _mm_add_epi8(delta, previous);
+}
+
+// DecodeVertexBlock four byte channels at a time, which the stride being a
+// multiple of four allows. Each set of channels is decoded 16 vertices per
+// step and transposed back to four bytes per vertex with unpacks.
+__attribute__((target("ssse3")))
+static const uint8_t* DecodeVertexBlockSsse3(
+  const uint8_t* data,
+  const uint8_t* end,
+  uint8_t* vertices,
+  size_t count,
+  size_t stride,
+  uint8_t* last_vertex
+) {
+  alignas(16) uint8_t lanes[4][kVertexBlockMaxSize];
+  alignas(16) uint8_t rows[64];
+  uint8_t transposed[kVertexBlockSizeBytes];
+
+  size_t count_aligned = (count + kByteGroupSize - 1) & ~(kByteGroupSize - 1);
+  __m128i last_byte = _mm_set1_epi8(15);
+
+  for (size_t k = 0; k < stride; k += 4) {
+    __m128i previous[4];
+    for (size_t c = 0; c < 4; ++c) {
+      data = DecodeBytesSsse3(data, end, lanes[c], count_aligned);
+      if (data == nullptr) {
+        return nullptr;
+      }
+      previous[c] = _mm_set1_epi8(char(last_vertex[k + c]));
+    }
+
+    for (size_t i = 0; i < count; i += kByteGroupSize) {
+      __m128i values[4];
+      for (size_t c = 0; c < 4; ++c) {
+        values[c] = DecodeDeltasSsse3(_mm_load_si128(reinterpret_cast<const __m128i*>(lanes[c] + i)), previous[c]);
+        previous[c] = _mm_shuffle_epi8(values[c], last_byte);
+      }
+
+      __m128i low01 = _mm_unpacklo_epi8(values[0], values[1]);
+      __m128i high01 = _mm_unpackhi_epi8(values[0], values[1]);
+      __m128i low23 = _mm_unpacklo_epi8(values[2], values[3]);
+      __m128i high23 = _mm_unpackhi_epi8(values[2], values[3]);
+      _mm_store_si128(reinterpret_cast<__m128i*>(rows + 0), _mm_unpacklo_epi16(low01, low23));
+      _mm_store_si128(reinterpret_cast<__m128i*>(rows + 16), _mm_unpackhi_epi16(low01, low23));
+      _mm_store_si128(reinterpret_cast<__m128i*>(rows + 32), _mm_unpacklo_epi16(high01, high23));
+      _mm_store_si128(reinterpret_cast<__m128i*>(rows + 48), _mm_unpackhi_epi16(high01, high23));
+
+      size_t row_count = std::min(kByteGroupSize, count - i);
+      for (size_t j = 0; j < row_count; ++j) {
+        std::memcpy(&transposed[(i + j) * stride + k], rows + j * 4, 4);
+      }
+    }
+  }
+
+  std::memcpy(vertices, transposed, count * stride);
+  std::memcpy(last_vertex, &transposed[stride * (count - 1)], stride);
+
+  return data;
+}
+
+static bool HasSsse3() {
+  static const bool kSupported = __builtin_cpu_supports("ssse3");
+  return kSupported;
+}
+
+#endif
+
+bool MeshoptDecoder::DecodeVertexBuffer(uint8_t* destination, size_t count, size_t stride, const uint8_t* source, size_t size) {
+  if (stride == 0 || stride > kMaxVertexSize || stride % 4 != 0) {
+    return false;
+  }
+  if (size < 1 + stride) {
+    return false;
+  }
+
+  const uint8_t* data = source;
+  const uint8_t* end = source + size;
+
+  uint8_t header = *data++;
+  if ((header & 0xf0) != kVertexHeader || (header & 0x0f) > 0) {
+    return false;
+  }
+
+  // The first vertex is the baseline for the first block's deltas
+  uint8_t last_vertex[kMaxVertexSize];
+  std::memcpy(last_vertex, end - stride, stride);
+
+  auto decode_block = DecodeVertexBlock;
+#ifdef MESHOPT_SSSE3
+  if (HasSsse3()) {
+    decode_block = DecodeVertexBlockSsse3;
+  }
+#endif
+
+  size_t block_size = VertexBlockSize(stride);
+  for (size_t offset = 0; offset < count; offset += block_size) {
+    size_t block_count = std::min(block_size, count - offset);
+    data = decode_block(data, end, destination + offset * stride, block_count, stride, last_vertex);
+    if (data == nullptr) {
+      return false;
+    }
+  }
+
+  size_t tail_size = std::max(stride, kTailMinSize);
+  return size_t(end - data) == tail_size;
+}
+
+static uint32_t DecodeVByte(const uint8_t*& data) {
+  uint8_t lead = *data++;
+  if (lead < 128) {
+    return lead;
+  }
+
+  uint32_t result = lead & 127;
+  uint32_t shift = 7;
+  for (int32_t i = 0; i < 4; ++i) {
+    uint8_t group = *data++;
+    result |= uint32_t(group & 127) << shift;
+    shift += 7;
+    if (group < 128) {
+      break;
+    }
+  }
+  return result;
+}
+
+static uint32_t DecodeIndex(const uint8_t*& data, uint32_t last) {
+  uint32_t v = DecodeVByte(data);
+  uint32_t delta = (v >> 1) ^ -int32_t(v & 1);
+  return last + delta;
+}
+
+static void WriteIndex(uint8_t* destination, size_t i, size_t index_size, uint32_t index) {
+  if (index_size == 2) {
+    uint16_t value = uint16_t(index);
+    std::memcpy(destination + i * 2, &value, 2);
+  } else {
+    std::memcpy(destination + i * 4, &index, 4);
+  }
+}
+
+static void WriteTriangle(uint8_t* destination, size_t i, size_t index_size, uint32_t a, uint32_t b, uint32_t c) {
+  WriteIndex(destination, i + 0, index_size, a);
+  WriteIndex(destination, i + 1, index_size, b);
+  WriteIndex(destination, i + 2, index_size, c);
+}
+
+struct IndexFifos {
+  uint32_t edges_[16][2];
+  uint32_t vertices_[16];
+  uint32_t edge_offset_ = 0;
+  uint32_t vertex_offset_ = 0;
+
+  void PushEdge(uint32_t a, uint32_t b) {
+    edges_[edge_offset_][0] = a;
+    edges_[edge_offset_][1] = b;
+    edge_offset_ = (edge_offset_ + 1) & 15;
+  }
+
+  void PushVertex(uint32_t v, bool advance = true) {
+    vertices_[vertex_offset_] = v;
+    vertex_offset_ = (vertex_offset_ + advance) & 15;
+  }
+};
+
+// Triangles are coded one byte each against a 16 entry edge FIFO and vertex
+// FIFO; indices that miss both are delta coded varints in the data stream
+bool MeshoptDecoder::DecodeIndexBuffer(uint8_t* destination, size_t count, size_t index_size, const uint8_t* source, size_t size) {
+  if (count % 3 != 0 || (index_size != 2 && index_size != 4)) {
+    return false;
+  }
+  if (size < 1 + count / 3 + 16) {
+    return false;
+  }
+  if ((source[0] & 0xf0) != kIndexHeader) {
+    return false;
+  }
+
+  int32_t version = source[0] & 0x0f;
+  if (version > 1) {
+    return false;
+  }
+
+  IndexFifos fifos;
+  std::memset(fifos.edges_, -1, sizeof(fifos.edges_));
+  std::memset(fifos.vertices_, -1, sizeof(fifos.vertices_));
+
+  uint32_t next = 0;
+  uint32_t last = 0;
+  uint32_t fec_max = version >= 1 ? 13 : 15;
+
+  const uint8_t* code = source + 1;
+  const uint8_t* data = code + count / 3;
+  const uint8_t* data_safe_end = source + size - 16;
+  const uint8_t* code_aux_table = data_safe_end;
+
+  for (size_t i = 0; i < count; i += 3) {
+    if (data > data_safe_end) {
+      return false;
+    }
+
+    uint8_t code_tri = *code++;
+
+    if (code_tri < 0xf0) {
+      // Edge from the FIFO plus one more vertex
+      uint32_t fe = code_tri >> 4;
+      uint32_t a = fifos.edges_[(fifos.edge_offset_ - 1 - fe) & 15][0];
+      uint32_t b = fifos.edges_[(fifos.edge_offset_ - 1 - fe) & 15][1];
+
+      uint32_t fec = code_tri & 15;
+      if (fec < fec_max) {
+        uint32_t cf = fifos.vertices_[(fifos.vertex_offset_ - 1 - fec) & 15];
+        uint32_t c = fec == 0 ? next : cf;
+
+        bool fec0 = fec == 0;
+        next += fec0;
+
+        WriteTriangle(destination, i, index_size, a, b, c);
+        fifos.PushVertex(c, fec0);
+        fifos.PushEdge(c, b);
+        fifos.PushEdge(a, c);
+      } else {
+        // 13 and 14 are -1 and +1 from the last free index
+        uint32_t c = fec != 15 ? last + (fec - (fec ^ 3)) : DecodeIndex(data, last);
+        last = c;
+
+        WriteTriangle(destination, i, index_size, a, b, c);
+        fifos.PushVertex(c);
+        fifos.PushEdge(c, b);
+        fifos.PushEdge(a, c);
+      }
+    } else if (code_tri < 0xfe) {
+      // Three vertices, two of them described by the aux table
+      uint8_t code_aux = code_aux_table[code_tri & 15];
+      uint32_t feb = code_aux >> 4;
+      uint32_t fec = code_aux & 15;
+
+      uint32_t a = next++;
+
+      uint32_t b = feb == 0 ? next : fifos.vertices_[(fifos.vertex_offset_ - feb) & 15];
+      bool feb0 = feb == 0;
+      next += feb0;
+
+      uint32_t c = fec == 0 ? next : fifos.vertices_[(fifos.vertex_offset_ - fec) & 15];
+      bool fec0 = fec == 0;
+      next += fec0;
+
+      WriteTriangle(destination, i, index_size, a, b, c);
+      fifos.PushVertex(a);
+      fifos.PushVertex(b, feb0);
+      fifos.PushVertex(c, fec0);
+      fifos.PushEdge(b, a);
+      fifos.PushEdge(c, b);
+      fifos.PushEdge(a, c);
+    } else {
+      // Three vertices with an explicit aux byte, any of them may be free
+      uint8_t code_aux = *data++;
+      uint32_t fea = code_tri == 0xfe ? 0 : 15;
+      uint32_t feb = code_aux >> 4;
+      uint32_t fec = code_aux & 15;
+
+      if (code_aux == 0) {
+        next = 0;
+      }
+
+      uint32_t a = fea == 0 ? next++ : 0;
+      uint32_t b = feb == 0 ? next++ : fifos.vertices_[(fifos.vertex_offset_ - feb) & 15];
+      uint32_t c = fec == 0 ? next++ : fifos.vertices_[(fifos.vertex_offset_ - fec) & 15];
+
+      if (fea == 15) {
+        last = a = DecodeIndex(data, last);
+      }
+      if (feb == 15) {
+        last = b = DecodeIndex(data, last);
+      }
+      if (fec == 15) {
+        last = c = DecodeIndex(data, last);
+      }
+
+      WriteTriangle(destination, i, index_size, a, b, c);
+      fifos.PushVertex(a);
+      fifos.PushVertex(b, feb == 0 || feb == 15);
+      fifos.PushVertex(c, fec == 0 || fec == 15);
+      fifos.PushEdge(b, a);
+      fifos.PushEdge(c, b);
+      fifos.PushEdge(a, c);
+    }
+  }
+
+  return data == data_safe_end;
+}
+
+// Each index is a varint delta against one of two baselines, picked by the low bit
+bool MeshoptDecoder::DecodeIndexSequence(uint8_t* destination, size_t count, size_t index_size, const uint8_t* source, size_t size) {
+  if (index_size != 2 && index_size != 4) {
+    return false;
+  }
+  if (size < 1 + count + 4) {
+    return false;
+  }
+  if ((source[0] & 0xf0) != kSequenceHeader || (source[0] & 0x0f) > 1) {
+    return false;
+  }
+
+  const uint8_t* data = source + 1;
+  // A varint is at most 5 bytes, the 4 byte tail keeps reads in bounds
+  const uint8_t* data_safe_end = source + size - 4;
+
+  uint32_t last[2] = { 0, 0 };
+
+  for (size_t i = 0; i < count; ++i) {
+    if (data >= data_safe_end) {
+      return false;
+    }
+
+    uint32_t v = DecodeVByte(data);
+    uint32_t baseline = v & 1;
+    v >>= 1;
+
+    uint32_t delta = (v >> 1) ^ -int32_t(v & 1);
+    uint32_t index = last[baseline] + delta;
+    last[baseline] = index;
+
+    WriteIndex(destination, i, index_size, index);
+  }
+
+  return data == data_safe_end;
+}
+
+static float RoundAway(float value) {
+  return value + (value >= 0.0f ? 0.5f : -0.5f);
+}
+
+// Normals and tangents stored as octahedral x/y with z holding the scale
+template <typename T>
+static void DecodeOctahedral(T* data, size_t count) {
+  const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+
+  for (size_t i = 0; i < count; ++i) {
+    float x = float(data[i * 4 + 0]);
+    float y = float(data[i * 4 + 1]);
+    float z = float(data[i * 4 + 2]) - std::fabs(x) - std::fabs(y);
+
+    float t = z >= 0.0f ? 0.0f : z;
+    x += x >= 0.0f ? t : -t;
+    y += y >= 0.0f ? t : -t;
+
+    float scale = max / std::sqrt(x * x + y * y + z * z);
+
+    data[i * 4 + 0] = T(int32_t(RoundAway(x * scale)));
+    data[i * 4 + 1] = T(int32_t(RoundAway(y * scale)));
+    data[i * 4 + 2] = T(int32_t(RoundAway(z * scale)));
+  }
+}
+
+// Unit quaternions stored as the three smallest components, the index of the
+// dropped one in the low two bits of w
+static void DecodeQuaternion(int16_t* data, size_t count) {
+  const float scale = 1.0f / std::sqrt(2.0f);
+
+  for (size_t i = 0; i < count; ++i) {
+    int32_t sf = data[i * 4 + 3] | 3;
+    float ss = scale / float(sf);
+
+    float x = float(data[i * 4 + 0]) * ss;
+    float y = float(data[i * 4 + 1]) * ss;
+    float z = float(data[i * 4 + 2]) * ss;
+
+    float ww = 1.0f - x * x - y * y - z * z;
+    float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+
+    int32_t qc = data[i * 4 + 3] & 3;
+
+    data[i * 4 + ((qc + 1) & 3)] = int16_t(RoundAway(x * 32767.0f));
+    data[i * 4 + ((qc + 2) & 3)] = int16_t(RoundAway(y * 32767.0f));
+    data[i * 4 + ((qc + 3) & 3)] = int16_t(RoundAway(z * 32767.0f));
+    data[i * 4 + ((qc + 0) & 3)] = int16_t(RoundAway(w * 32767.0f));
+  }
+}
+
+// 24-bit mantissa and 8-bit exponent per float
+static void DecodeExponential(uint32_t* data, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t v = data[i];
+    int32_t mantissa = int32_t(v << 8) >> 8;
+    int32_t exponent = int32_t(v) >> 24;
+
+    float value = std::ldexp(float(mantissa), exponent);
+    std::memcpy(&data[i], &value, sizeof(float));
+  }
+}
+
+void MeshoptDecoder::ApplyFilter(uint8_t* data, size_t count, size_t stride, MeshoptFilter filter) {
+  switch (filter) {
+    case MeshoptFilter::kOctahedral:
+      if (stride == 4) {
+        DecodeOctahedral(reinterpret_cast<int8_t*>(data), count);
+      } else if (stride == 8) {
+        DecodeOctahedral(reinterpret_cast<int16_t*>(data), count);
+      }
+      break;
+    case MeshoptFilter::kQuaternion:
+      if (stride == 8) {
+        DecodeQuaternion(reinterpret_cast<int16_t*>(data), count);
+      }
+      break;
+    case MeshoptFilter::kExponential:
+      DecodeExponential(reinterpret_cast<uint32_t*>(data), count * (stride / 4));
+      break;
+    case MeshoptFilter::kNone:
+      break;
+  }
+}
+
+bool MeshoptDecoder::Decode(
+  uint8_t* destination,
+  size_t count,
+  size_t stride,
+  const uint8_t* source,
+  size_t size,
+  MeshoptMode mode,
+  MeshoptFilter filter
+) {
+  switch (mode) {
+    case MeshoptMode::kAttributes:
+      if (!DecodeVertexBuffer(destination, count, stride, source, size)) {
+        return false;
+      }
+      ApplyFilter(destination, count, stride, filter);
+      return true;
+    case MeshoptMode::kTriangles:
+      return DecodeIndexBuffer(destination, count, stride, source, size);
+    case MeshoptMode::kIndices:
+      return DecodeIndexSequence(destination, count, stride, source, size);
+  }
+  return false;
+}
@@ -0,0 +1,44 @@
+#ifndef MESHOPT_DECODER_H_
+#define MESHOPT_DECODER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+enum class MeshoptMode {
+  kAttributes,
+  kTriangles,
+  kIndices,
+};
+
+enum class MeshoptFilter {
+  kNone,
+  kOctahedral,
+  kQuaternion,
+  kExponential,
+};
+
+// Decoders for buffer views compressed with EXT_meshopt_compression, matching
+// version 0 of the vertex codec and versions 0 and 1 of the index codecs.
+// All of them write count * stride bytes to destination and return false
+// on malformed input.
+class MeshoptDecoder {
+public:
+  static bool Decode(
+    uint8_t* destination,
+    size_t count,
+    size_t stride,
+    const uint8_t* source,
+    size_t size,
+    MeshoptMode mode,
+    MeshoptFilter filter
+  );
+
+  static bool DecodeVertexBuffer(uint8_t* destination, size_t count, size_t stride, const uint8_t* source, size_t size);
+  static bool DecodeIndexBuffer(uint8_t* destination, size_t count, size_t index_size, const uint8_t* source, size_t size);
+  static bool DecodeIndexSequence(uint8_t* destination, size_t count, size_t index_size, const uint8_t* source, size_t size);
+
+  // In place, on the output of DecodeVertexBuffer
+  static void ApplyFilter(uint8_t* data, size_t count, size_t stride, MeshoptFilter filter);
+};
+
+#endif
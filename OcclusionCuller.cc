@@ -0,0 +1,298 @@
+#include "OcclusionCuller.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// Anything this close to the eye plane counts as crossing the near plane
+constexpr float kMinW = 1e-4f;
+
+void OcclusionCuller::Create(int32_t width, int32_t height, WorkerPool* pool) {
+  assert(width % kTileWidth == 0 && height % kTileHeight == 0);
+
+  width_ = width;
+  height_ = height;
+  tiles_x_ = width / kTileWidth;
+  tiles_y_ = height / kTileHeight;
+
+  depth_.assign(width_ * height_, 1.0f);
+  tile_bins_.resize(tiles_x_ * tiles_y_);
+
+  pool_ = pool;
+}
+
+void OcclusionCuller::Destroy() {
+  pool_ = nullptr;
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& view_projection) {
+  view_projection_ = view_projection;
+  stats_ = OcclusionStats {};
+
+  triangles_.clear();
+  for (std::vector<uint32_t>& bin : tile_bins_) {
+    bin.clear();
+  }
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& mesh, const glm::mat4& model) {
+  Clock::time_point start = Clock::now();
+
+  glm::mat4 mvp = view_projection_ * model * mesh.local_transform_;
+  glm::vec2 viewport(width_, height_);
+
+  for (size_t i = 0; i + 2 < mesh.indices_.size(); i += 3) {
+    glm::vec3 screen[3];
+    bool clipped = false;
+
+    for (int32_t v = 0; v < 3; ++v) {
+      glm::vec4 clip = mvp * glm::vec4(mesh.positions_[mesh.indices_[i + v]], 1.0);
+      // Dropping occluder triangles is always safe, it only loses occlusion
+      if (clip.w < kMinW) {
+        clipped = true;
+        break;
+      }
+      glm::vec3 ndc = glm::vec3(clip) / clip.w;
+      screen[v] = glm::vec3((glm::vec2(ndc) * 0.5f + 0.5f) * viewport, ndc.z * 0.5f + 0.5f);
+    }
+    if (clipped) {
+      continue;
+    }
+
+    // Counter-clockwise is front facing
+    float area =
+      (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+      (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+    if (area <= 0.0f) {
+      continue;
+    }
+
+    Triangle triangle;
+    triangle.min_x_ = std::max(int32_t(std::floor(std::min({ screen[0].x, screen[1].x, screen[2].x }))), 0);
+    triangle.min_y_ = std::max(int32_t(std::floor(std::min({ screen[0].y, screen[1].y, screen[2].y }))), 0);
+    triangle.max_x_ = std::min(int32_t(std::ceil(std::max({ screen[0].x, screen[1].x, screen[2].x }))), width_ - 1);
+    triangle.max_y_ = std::min(int32_t(std::ceil(std::max({ screen[0].y, screen[1].y, screen[2].y }))), height_ - 1);
+    if (triangle.min_x_ > triangle.max_x_ || triangle.min_y_ > triangle.max_y_) {
+      continue;
+    }
+
+    // Edge e is opposite vertex e, positive inside
+    for (int32_t e = 0; e < 3; ++e) {
+      const glm::vec3& v0 = screen[(e + 1) % 3];
+      const glm::vec3& v1 = screen[(e + 2) % 3];
+      triangle.edge_a_[e] = v0.y - v1.y;
+      triangle.edge_b_[e] = v1.x - v0.x;
+      triangle.edge_c_[e] = v0.x * v1.y - v0.y * v1.x;
+    }
+
+    // Barycentric weights are the edge functions over the area
+    float inverse_area = 1.0f / area;
+    triangle.depth_a_ = 0.0f;
+    triangle.depth_b_ = 0.0f;
+    triangle.depth_c_ = 0.0f;
+    for (int32_t e = 0; e < 3; ++e) {
+      float z = screen[e].z * inverse_area;
+      triangle.depth_a_ += triangle.edge_a_[e] * z;
+      triangle.depth_b_ += triangle.edge_b_[e] * z;
+      triangle.depth_c_ += triangle.edge_c_[e] * z;
+    }
+
+    uint32_t index = triangles_.size();
+    triangles_.push_back(triangle);
+
+    for (int32_t ty = triangle.min_y_ / kTileHeight; ty <= triangle.max_y_ / kTileHeight; ++ty) {
+      for (int32_t tx = triangle.min_x_ / kTileWidth; tx <= triangle.max_x_ / kTileWidth; ++tx) {
+        tile_bins_[ty * tiles_x_ + tx].push_back(index);
+      }
+    }
+  }
+
+  stats_.occluder_triangles_ = triangles_.size();
+  stats_.bin_ms_ += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void OcclusionCuller::Rasterize() {
+  Clock::time_point start = Clock::now();
+
+  std::fill(depth_.begin(), depth_.end(), 1.0f);
+  next_tile_ = 0;
+
+  if (pool_ == nullptr) {
+    RasterizeTiles();
+  } else {
+    uint32_t parts = std::min<uint32_t>(pool_->GetThreadCount(), tiles_x_ * tiles_y_);
+    pool_->Run(parts, [this](uint32_t) {
+      RasterizeTiles();
+    });
+  }
+
+  stats_.raster_ms_ += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void OcclusionCuller::RasterizeTiles() {
+  int32_t tile_count = tiles_x_ * tiles_y_;
+  for (int32_t tile = next_tile_++; tile < tile_count; tile = next_tile_++) {
+    RasterizeTile(tile);
+  }
+}
+
+// Tiles own disjoint pixels, so no two threads ever touch the same depth
+void OcclusionCuller::RasterizeTile(int32_t tile) {
+  int32_t tile_x = (tile % tiles_x_) * kTileWidth;
+  int32_t tile_y = (tile / tiles_x_) * kTileHeight;
+
+  for (uint32_t index : tile_bins_[tile]) {
+    const Triangle& triangle = triangles_[index];
+
+    // Rows are walked four pixels at a time from an aligned start
+    int32_t min_x = std::max(triangle.min_x_, tile_x) & ~3;
+    int32_t max_x = std::min(triangle.max_x_, tile_x + kTileWidth - 1);
+    int32_t min_y = std::max(triangle.min_y_, tile_y);
+    int32_t max_y = std::min(triangle.max_y_, tile_y + kTileHeight - 1);
+
+    for (int32_t y = min_y; y <= max_y; ++y) {
+      float* row = depth_.data() + y * width_;
+      float py = y + 0.5f;
+
+#if defined(__SSE2__)
+      __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+      __m128 zero = _mm_setzero_ps();
+
+      __m128 row_edge[3];
+      __m128 edge_a[3];
+      for (int32_t e = 0; e < 3; ++e) {
+        edge_a[e] = _mm_set1_ps(triangle.edge_a_[e]);
+        row_edge[e] = _mm_set1_ps(triangle.edge_b_[e] * py + triangle.edge_c_[e]);
+      }
+      __m128 depth_a = _mm_set1_ps(triangle.depth_a_);
+      __m128 row_depth = _mm_set1_ps(triangle.depth_b_ * py + triangle.depth_c_);
+
+      for (int32_t x = min_x; x <= max_x; x += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(edge_a[0], px), row_edge[0]);
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(edge_a[1], px), row_edge[1]);
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(edge_a[2], px), row_edge[2]);
+
+        __m128 inside = _mm_and_ps(
+          _mm_cmpge_ps(e0, zero),
+          _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero))
+        );
+        if (_mm_movemask_ps(inside) == 0) {
+          continue;
+        }
+
+        __m128 z = _mm_add_ps(_mm_mul_ps(depth_a, px), row_depth);
+        __m128 old_depth = _mm_loadu_ps(row + x);
+        __m128 new_depth = _mm_min_ps(old_depth, z);
+
+        new_depth = _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth));
+        _mm_storeu_ps(row + x, new_depth);
+      }
+#else
+      for (int32_t x = min_x; x <= max_x; ++x) {
+        float px = x + 0.5f;
+        bool inside = true;
+        for (int32_t e = 0; e < 3; ++e) {
+          inside = inside && triangle.edge_a_[e] * px + triangle.edge_b_[e] * py + triangle.edge_c_[e] >= 0.0f;
+        }
+        if (inside) {
+          float z = triangle.depth_a_ * px + triangle.depth_b_ * py + triangle.depth_c_;
+          row[x] = std::min(row[x], z);
+        }
+      }
+#endif
+    }
+  }
+}
+
+bool OcclusionCuller::IsVisible(const Aabb& bounds, const glm::mat4& mvp) {
+  ++stats_.tested_;
+
+  glm::vec2 min_ndc(1.0);
+  glm::vec2 max_ndc(-1.0);
+  float min_depth = 1.0f;
+
+  bool all_left = true, all_right = true, all_below = true, all_above = true, all_far = true;
+
+  for (int32_t i = 0; i < 8; ++i) {
+    glm::vec3 corner(
+      (i & 1) ? bounds.max_.x : bounds.min_.x,
+      (i & 2) ? bounds.max_.y : bounds.min_.y,
+      (i & 4) ? bounds.max_.z : bounds.min_.z
+    );
+    glm::vec4 clip = mvp * glm::vec4(corner, 1.0);
+
+    all_left = all_left && clip.x < -clip.w;
+    all_right = all_right && clip.x > clip.w;
+    all_below = all_below && clip.y < -clip.w;
+    all_above = all_above && clip.y > clip.w;
+    all_far = all_far && clip.z > clip.w;
+
+    // Bounds crossing the near plane can't be projected, keep them
+    if (clip.w < kMinW) {
+      min_depth = 0.0f;
+      min_ndc = glm::vec2(-1.0);
+      max_ndc = glm::vec2(1.0);
+      continue;
+    }
+
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    min_ndc = glm::min(min_ndc, glm::vec2(ndc));
+    max_ndc = glm::max(max_ndc, glm::vec2(ndc));
+    min_depth = std::min(min_depth, ndc.z * 0.5f + 0.5f);
+  }
+
+  if (all_left || all_right || all_below || all_above || all_far) {
+    ++stats_.frustum_culled_;
+    return false;
+  }
+  if (min_depth <= 0.0f) {
+    return true;
+  }
+
+  // Rounded outwards so every pixel the bounds touch is checked
+  glm::vec2 viewport(width_, height_);
+  glm::vec2 min_screen = (glm::max(min_ndc, glm::vec2(-1.0)) * 0.5f + 0.5f) * viewport;
+  glm::vec2 max_screen = (glm::min(max_ndc, glm::vec2(1.0)) * 0.5f + 0.5f) * viewport;
+
+  int32_t min_x = std::max(int32_t(std::floor(min_screen.x)), 0);
+  int32_t min_y = std::max(int32_t(std::floor(min_screen.y)), 0);
+  int32_t max_x = std::min(int32_t(std::ceil(max_screen.x)), width_ - 1);
+  int32_t max_y = std::min(int32_t(std::ceil(max_screen.y)), height_ - 1);
+
+  for (int32_t y = min_y; y <= max_y; ++y) {
+    const float* row = depth_.data() + y * width_;
+    for (int32_t x = min_x; x <= max_x; ++x) {
+      if (row[x] >= min_depth) {
+        return true;
+      }
+    }
+  }
+
+  ++stats_.occlusion_culled_;
+  return false;
+}
+
+const OcclusionStats& OcclusionCuller::GetStats() const {
+  return stats_;
+}
+
+const std::vector<float>& OcclusionCuller::GetDepth() const {
+  return depth_;
+}
+
+int32_t OcclusionCuller::GetWidth() const {
+  return width_;
+}
+
+int32_t OcclusionCuller::GetHeight() const {
+  return height_;
+}
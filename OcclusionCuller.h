@@ -0,0 +1,100 @@
+#ifndef OCCLUSION_CULLER_H_
+#define OCCLUSION_CULLER_H_
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include "AssetDecoder.h"
+#include "WorkerPool.h"
+
+// CPU copy of the geometry a model contributes as an occluder
+struct OccluderMesh {
+  glm::mat4 local_transform_;
+  std::vector<glm::vec3> positions_;
+  std::vector<uint32_t> indices_;
+};
+
+struct OcclusionStats {
+  size_t occluder_triangles_ = 0;
+  size_t tested_ = 0;
+  size_t frustum_culled_ = 0;
+  size_t occlusion_culled_ = 0;
+  double bin_ms_ = 0.0;
+  double raster_ms_ = 0.0;
+};
+
+// Software occlusion culling against a small depth buffer. Occluders are
+// binned into screen tiles and the tiles rasterized four pixels at a time
+// on worker threads; occludees are tested by the screen rect and nearest
+// depth of their projected bounds. No GL involved.
+//
+// Per frame: BeginFrame, AddOccluder for each occluder, Rasterize, then
+// IsVisible for everything that might be drawn.
+class OcclusionCuller {
+public:
+  OcclusionCuller() = default;
+
+  OcclusionCuller(const OcclusionCuller&) = delete;
+  OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+  // Width has to be a multiple of kTileWidth and height of kTileHeight.
+  // Tiles are rasterized on pool, or on the calling thread without one.
+  void Create(int32_t width = 256, int32_t height = 128, WorkerPool* pool = nullptr);
+  void Destroy();
+
+  void BeginFrame(const glm::mat4& view_projection);
+  void AddOccluder(const OccluderMesh& mesh, const glm::mat4& model);
+  void Rasterize();
+
+  // mvp takes the bounds to clip space
+  bool IsVisible(const Aabb& bounds, const glm::mat4& mvp);
+
+  // Counted since BeginFrame
+  const OcclusionStats& GetStats() const;
+  const std::vector<float>& GetDepth() const;
+  int32_t GetWidth() const;
+  int32_t GetHeight() const;
+public:
+  constexpr static int32_t kTileWidth = 32;
+  constexpr static int32_t kTileHeight = 32;
+private:
+  // Edge functions and depth plane in pixel space, evaluated at pixel centers
+  struct Triangle {
+    float edge_a_[3];
+    float edge_b_[3];
+    float edge_c_[3];
+    float depth_a_;
+    float depth_b_;
+    float depth_c_;
+
+    int32_t min_x_;
+    int32_t min_y_;
+    int32_t max_x_;
+    int32_t max_y_;
+  };
+
+  void RasterizeTiles();
+  void RasterizeTile(int32_t tile);
+private:
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+  int32_t tiles_x_ = 0;
+  int32_t tiles_y_ = 0;
+
+  glm::mat4 view_projection_;
+
+  std::vector<float> depth_;
+  std::vector<Triangle> triangles_;
+  std::vector<std::vector<uint32_t>> tile_bins_;
+
+  OcclusionStats stats_;
+
+  WorkerPool* pool_ = nullptr;
+  std::atomic<int32_t> next_tile_ { 0 };
+};
+
+#endif
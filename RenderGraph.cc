@@ -0,0 +1,691 @@
+#include "RenderGraph.h"
+
+#include "GLExtensions.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+struct FormatInfo {
+  GLenum internal_format_;
+  GLenum format_;
+  GLenum type_;
+  size_t bytes_per_pixel_;
+  bool depth_;
+};
+
+static FormatInfo GetFormatInfo(RenderFormat format) {
+  switch (format) {
+    case RenderFormat::kRGBA8: return FormatInfo { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, false };
+    case RenderFormat::kRGBA16F: return FormatInfo { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, false };
+    case RenderFormat::kR11G11B10F: return FormatInfo { GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, 4, false };
+    case RenderFormat::kDepth24: return FormatInfo { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4, true };
+    case RenderFormat::kDepth32F: return FormatInfo { GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4, true };
+  }
+  return FormatInfo { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, false };
+}
+
+static void ResolveSize(const RenderTextureDesc& desc, int32_t width, int32_t height, int32_t& out_width, int32_t& out_height) {
+  if (desc.width_ > 0 && desc.height_ > 0) {
+    out_width = desc.width_;
+    out_height = desc.height_;
+    return;
+  }
+  out_width = std::max(int32_t(width * desc.scale_), 1);
+  out_height = std::max(int32_t(height * desc.scale_), 1);
+}
+
+static bool SameDesc(const RenderTextureDesc& a, const RenderTextureDesc& b) {
+  return a.format_ == b.format_ && a.scale_ == b.scale_ && a.width_ == b.width_ && a.height_ == b.height_ &&
+    a.dynamic_ == b.dynamic_;
+}
+
+uint32_t RenderPassContext::GetTexture(RenderResource resource) const {
+  return graph_->GetPhysicalId(resource);
+}
+
+uint32_t RenderPassContext::GetBuffer(RenderResource resource) const {
+  return graph_->GetPhysicalId(resource);
+}
+
+void RenderPassContext::BindTexture(RenderResource resource, int32_t slot) const {
+  glActiveTexture(GL_TEXTURE0 + slot);
+  glBindTexture(GL_TEXTURE_2D, graph_->GetPhysicalId(resource));
+}
+
+void RenderPassContext::Blit(RenderResource source) const {
+  const RenderGraph::Resource& resource = graph_->GetResource(source);
+  assert(resource.kind_ == RenderGraph::ResourceKind::kTexture && "Blitting from something that isn't a texture");
+  const RenderGraph::Physical& physical = graph_->physicals_[resource.physical_];
+
+  int32_t drawn_width = 0;
+  int32_t drawn_height = 0;
+  graph_->GetDrawnSize(physical, drawn_width, drawn_height);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, graph_->blit_framebuffer_);
+  glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, physical.id_, 0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
+
+  bool same_size = drawn_width == width_ && drawn_height == height_;
+  glBlitFramebuffer(
+    0, 0, drawn_width, drawn_height,
+    0, 0, width_, height_,
+    GL_COLOR_BUFFER_BIT, same_size ? GL_NEAREST : GL_LINEAR);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+}
+
+void RenderPassContext::DrawFullscreen() const {
+  GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+  glDisable(GL_DEPTH_TEST);
+
+  glBindVertexArray(graph_->empty_vertex_array_);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+
+  if (depth_test) {
+    glEnable(GL_DEPTH_TEST);
+  }
+}
+
+int32_t RenderPassContext::GetWidth() const {
+  return width_;
+}
+
+int32_t RenderPassContext::GetHeight() const {
+  return height_;
+}
+
+void RenderPassContext::GetDrawnSize(RenderResource resource, int32_t& width, int32_t& height) const {
+  const RenderGraph::Resource& found = graph_->GetResource(resource);
+  assert(found.kind_ == RenderGraph::ResourceKind::kTexture && "Only textures have a size");
+  graph_->GetDrawnSize(graph_->physicals_[found.physical_], width, height);
+}
+
+void RenderPassContext::GetTextureSize(RenderResource resource, int32_t& width, int32_t& height) const {
+  const RenderGraph::Resource& found = graph_->GetResource(resource);
+  assert(found.kind_ == RenderGraph::ResourceKind::kTexture && "Only textures have a size");
+  const RenderGraph::Physical& physical = graph_->physicals_[found.physical_];
+  width = physical.width_;
+  height = physical.height_;
+}
+
+void RenderPassBuilder::Read(RenderResource resource) {
+  assert(!resource.IsNull() && "Reading a null resource");
+  graph_->passes_[pass_].reads_.push_back(resource.version_);
+}
+
+RenderResource RenderPassBuilder::Write(RenderResource resource, LoadOp load) {
+  assert(!resource.IsNull() && "Writing a null resource");
+
+  std::vector<RenderGraph::Version>& versions = graph_->versions_;
+  for (const RenderGraph::Version& version : versions) {
+    assert(version.previous_ != resource.version_ && "Resource was already written from this version");
+    (void)version;
+  }
+
+  uint32_t resource_index = versions[resource.version_].resource_;
+  versions.push_back(RenderGraph::Version { resource_index, resource.version_, pass_ });
+  uint32_t written = versions.size() - 1;
+
+  RenderGraph::Pass& pass = graph_->passes_[pass_];
+  pass.writes_.push_back(written);
+  if (load == LoadOp::kLoad) {
+    pass.loads_.push_back(resource.version_);
+  }
+
+  RenderGraph::ResourceKind kind = graph_->resources_[resource_index].kind_;
+  if (kind == RenderGraph::ResourceKind::kTexture || kind == RenderGraph::ResourceKind::kBackbuffer) {
+    pass.attachments_.push_back(RenderGraph::Attachment { resource_index, load });
+    pass.backbuffer_ |= kind == RenderGraph::ResourceKind::kBackbuffer;
+  }
+
+  return RenderResource { written };
+}
+
+void RenderPassBuilder::SetClearColor(Color color) {
+  graph_->passes_[pass_].clear_color_ = color;
+}
+
+void RenderPassBuilder::SetSideEffects() {
+  graph_->passes_[pass_].side_effects_ = true;
+}
+
+void RenderGraph::Create() {
+  glGenFramebuffers(1, &blit_framebuffer_);
+  glGenVertexArrays(1, &empty_vertex_array_);
+}
+
+void RenderGraph::Destroy() {
+  Reset();
+
+  for (Physical& physical : physicals_) {
+    if (physical.kind_ == ResourceKind::kTexture) {
+      glDeleteTextures(1, &physical.id_);
+    } else {
+      glDeleteBuffers(1, &physical.id_);
+    }
+  }
+  physicals_.clear();
+
+  glDeleteFramebuffers(1, &blit_framebuffer_);
+  blit_framebuffer_ = 0;
+  glDeleteVertexArrays(1, &empty_vertex_array_);
+  empty_vertex_array_ = 0;
+}
+
+void RenderGraph::Reset() {
+  for (Pass& pass : passes_) {
+    if (pass.framebuffer_ != 0) {
+      glDeleteFramebuffers(1, &pass.framebuffer_);
+    }
+  }
+
+  resources_.clear();
+  versions_.clear();
+  passes_.clear();
+  order_.clear();
+  compiled_ = false;
+  framebuffers_valid_ = false;
+  stats_ = RenderGraphStats {};
+}
+
+RenderResource RenderGraph::AddResource(Resource resource) {
+  resource.first_ = 1;
+  resource.last_ = 0;
+  resource.physical_ = RenderResource::kNone;
+  resources_.push_back(resource);
+
+  versions_.push_back(Version { uint32_t(resources_.size() - 1), RenderResource::kNone, RenderResource::kNone });
+  compiled_ = false;
+  return RenderResource { uint32_t(versions_.size() - 1) };
+}
+
+RenderResource RenderGraph::CreateTexture(const std::string& name, const RenderTextureDesc& desc) {
+  return AddResource(Resource { name, ResourceKind::kTexture, desc, 0, 0 });
+}
+
+RenderResource RenderGraph::CreateBuffer(const std::string& name, size_t size) {
+  return AddResource(Resource { name, ResourceKind::kBuffer, RenderTextureDesc {}, size, 0 });
+}
+
+RenderResource RenderGraph::ImportBackbuffer() {
+  return AddResource(Resource { "backbuffer", ResourceKind::kBackbuffer, RenderTextureDesc {}, 0, 0 });
+}
+
+RenderResource RenderGraph::ImportBuffer(const std::string& name, uint32_t id) {
+  return AddResource(Resource { name, ResourceKind::kImportedBuffer, RenderTextureDesc {}, 0, id });
+}
+
+RenderPassBuilder RenderGraph::AddPass(const std::string& name, RenderPassFunction function) {
+  Pass pass;
+  pass.name_ = name;
+  pass.function_ = std::move(function);
+  pass.clear_color_ = Graphics::kBlack;
+  pass.side_effects_ = false;
+  pass.culled_ = false;
+  pass.backbuffer_ = false;
+  pass.framebuffer_ = 0;
+  passes_.push_back(std::move(pass));
+  compiled_ = false;
+
+  RenderPassBuilder builder;
+  builder.graph_ = this;
+  builder.pass_ = passes_.size() - 1;
+  return builder;
+}
+
+const RenderGraph::Resource& RenderGraph::GetResource(RenderResource resource) const {
+  return resources_[versions_[resource.version_].resource_];
+}
+
+uint32_t RenderGraph::GetPhysicalId(RenderResource resource) const {
+  const Resource& found = GetResource(resource);
+  switch (found.kind_) {
+    case ResourceKind::kTexture:
+    case ResourceKind::kBuffer:
+      return physicals_[found.physical_].id_;
+    case ResourceKind::kImportedBuffer:
+      return found.imported_id_;
+    case ResourceKind::kBackbuffer:
+      return 0;
+  }
+  return 0;
+}
+
+void RenderGraph::GetDrawnSize(const Physical& physical, int32_t& width, int32_t& height) const {
+  width = physical.width_;
+  height = physical.height_;
+  if (physical.desc_.dynamic_) {
+    width = std::max(int32_t(std::lround(physical.width_ * render_scale_)), 1);
+    height = std::max(int32_t(std::lround(physical.height_ * render_scale_)), 1);
+  }
+}
+
+// Whatever writes an imported resource is kept along with everything it
+// depends on, the rest is dropped
+void RenderGraph::Cull() {
+  std::vector<uint32_t> pending;
+  for (uint32_t i = 0; i < passes_.size(); ++i) {
+    Pass& pass = passes_[i];
+    pass.culled_ = !pass.side_effects_;
+    for (uint32_t version : pass.writes_) {
+      ResourceKind kind = resources_[versions_[version].resource_].kind_;
+      if (kind == ResourceKind::kBackbuffer || kind == ResourceKind::kImportedBuffer) {
+        pass.culled_ = false;
+      }
+    }
+    if (!pass.culled_) {
+      pending.push_back(i);
+    }
+  }
+
+  auto keep = [&](uint32_t version) {
+    uint32_t writer = versions_[version].writer_;
+    if (writer != RenderResource::kNone && passes_[writer].culled_) {
+      passes_[writer].culled_ = false;
+      pending.push_back(writer);
+    }
+  };
+
+  while (!pending.empty()) {
+    uint32_t index = pending.back();
+    pending.pop_back();
+    for (uint32_t version : passes_[index].reads_) {
+      keep(version);
+    }
+    for (uint32_t version : passes_[index].loads_) {
+      keep(version);
+    }
+  }
+}
+
+// Writers come before their readers, and every reader of a version before
+// the write that replaces it. Ties go to the order passes were added in.
+void RenderGraph::Sort() {
+  std::vector<std::vector<uint32_t>> readers(versions_.size());
+  for (uint32_t i = 0; i < passes_.size(); ++i) {
+    for (uint32_t version : passes_[i].reads_) {
+      readers[version].push_back(i);
+    }
+    for (uint32_t version : passes_[i].loads_) {
+      readers[version].push_back(i);
+    }
+  }
+
+  std::vector<std::vector<uint32_t>> successors(passes_.size());
+  std::vector<uint32_t> dependencies(passes_.size(), 0);
+  auto add_edge = [&](uint32_t from, uint32_t to) {
+    if (from == RenderResource::kNone || from == to || passes_[from].culled_ || passes_[to].culled_) {
+      return;
+    }
+    successors[from].push_back(to);
+    ++dependencies[to];
+  };
+
+  for (uint32_t i = 0; i < passes_.size(); ++i) {
+    for (uint32_t version : passes_[i].reads_) {
+      add_edge(versions_[version].writer_, i);
+    }
+    for (uint32_t version : passes_[i].writes_) {
+      uint32_t previous = versions_[version].previous_;
+      add_edge(versions_[previous].writer_, i);
+      for (uint32_t reader : readers[previous]) {
+        add_edge(reader, i);
+      }
+    }
+  }
+
+  order_.clear();
+  std::vector<bool> placed(passes_.size(), false);
+  size_t alive = 0;
+  for (const Pass& pass : passes_) {
+    alive += pass.culled_ ? 0 : 1;
+  }
+
+  while (order_.size() < alive) {
+    uint32_t next = RenderResource::kNone;
+    for (uint32_t i = 0; i < passes_.size(); ++i) {
+      if (!passes_[i].culled_ && !placed[i] && dependencies[i] == 0) {
+        next = i;
+        break;
+      }
+    }
+    assert(next != RenderResource::kNone && "Render graph has a cycle");
+    if (next == RenderResource::kNone) {
+      break;
+    }
+
+    placed[next] = true;
+    order_.push_back(next);
+    for (uint32_t successor : successors[next]) {
+      --dependencies[successor];
+    }
+  }
+}
+
+// Greedy first fit in order of first use. A transient takes over any
+// allocation of the same shape whose last occupant is done with it.
+void RenderGraph::Alias() {
+  for (Physical& physical : physicals_) {
+    physical.busy_until_ = -1;
+  }
+
+  std::vector<uint32_t> transients;
+  for (uint32_t i = 0; i < resources_.size(); ++i) {
+    const Resource& resource = resources_[i];
+    bool transient = resource.kind_ == ResourceKind::kTexture || resource.kind_ == ResourceKind::kBuffer;
+    if (transient && resource.first_ <= resource.last_) {
+      transients.push_back(i);
+    }
+  }
+  std::stable_sort(transients.begin(), transients.end(), [&](uint32_t a, uint32_t b) {
+    return resources_[a].first_ < resources_[b].first_;
+  });
+
+  // Allocations kept from an earlier Compile are reused before new ones
+  for (uint32_t index : transients) {
+    Resource& resource = resources_[index];
+
+    uint32_t chosen = RenderResource::kNone;
+    for (uint32_t p = 0; p < physicals_.size(); ++p) {
+      const Physical& physical = physicals_[p];
+      if (physical.kind_ != resource.kind_ || physical.busy_until_ >= int64_t(resource.first_)) {
+        continue;
+      }
+      bool fits = resource.kind_ == ResourceKind::kTexture
+        ? SameDesc(physical.desc_, resource.desc_)
+        : physical.size_ >= resource.size_;
+      if (fits) {
+        chosen = p;
+        break;
+      }
+    }
+
+    if (chosen == RenderResource::kNone) {
+      physicals_.push_back(Physical { resource.kind_, resource.desc_, resource.size_, 0, 0, 0, -1 });
+      chosen = physicals_.size() - 1;
+    }
+
+    physicals_[chosen].busy_until_ = resource.last_;
+    resource.physical_ = chosen;
+  }
+
+  // Anything the new graph doesn't use is released
+  std::vector<uint32_t> remap(physicals_.size(), RenderResource::kNone);
+  size_t kept = 0;
+  for (uint32_t p = 0; p < physicals_.size(); ++p) {
+    Physical& physical = physicals_[p];
+    if (physical.busy_until_ < 0) {
+      if (physical.kind_ == ResourceKind::kTexture) {
+        glDeleteTextures(1, &physical.id_);
+      } else {
+        glDeleteBuffers(1, &physical.id_);
+      }
+      continue;
+    }
+    remap[p] = kept;
+    physicals_[kept++] = physical;
+  }
+  physicals_.resize(kept);
+
+  for (uint32_t index : transients) {
+    resources_[index].physical_ = remap[resources_[index].physical_];
+  }
+
+  stats_.transient_count_ = transients.size();
+  stats_.allocation_count_ = physicals_.size();
+}
+
+void RenderGraph::Compile() {
+  Cull();
+  Sort();
+
+  stats_ = RenderGraphStats {};
+  stats_.pass_count_ = order_.size();
+  stats_.culled_count_ = passes_.size() - order_.size();
+
+  for (Resource& resource : resources_) {
+    resource.first_ = 1;
+    resource.last_ = 0;
+  }
+
+  // GL 3.3 has no explicit barriers: render to texture and transform
+  // feedback writes are ordered before later reads by the driver, as long
+  // as nothing samples a texture that is bound for drawing. Transitions are
+  // still counted, and the feedback loop case is caught here.
+  for (uint32_t position = 0; position < order_.size(); ++position) {
+    const Pass& pass = passes_[order_[position]];
+
+    auto touch = [&](uint32_t version) {
+      Resource& resource = resources_[versions_[version].resource_];
+      if (resource.first_ > resource.last_) {
+        resource.first_ = position;
+      }
+      resource.last_ = position;
+    };
+
+    for (uint32_t version : pass.reads_) {
+      touch(version);
+      if (versions_[version].writer_ != RenderResource::kNone) {
+        ++stats_.barrier_count_;
+      }
+      for (const Attachment& attachment : pass.attachments_) {
+        assert(attachment.resource_ != versions_[version].resource_ && "Pass reads a texture it draws to");
+        (void)attachment;
+      }
+    }
+    for (uint32_t version : pass.loads_) {
+      touch(version);
+      if (versions_[version].writer_ != RenderResource::kNone) {
+        ++stats_.barrier_count_;
+      }
+    }
+    for (uint32_t version : pass.writes_) {
+      touch(version);
+    }
+
+    if (pass.backbuffer_) {
+      assert(pass.attachments_.size() == 1 && "The backbuffer can't share a pass with other targets");
+    }
+  }
+
+  Alias();
+
+  compiled_ = true;
+  framebuffers_valid_ = false;
+}
+
+bool RenderGraph::Allocate(int32_t width, int32_t height) {
+  bool changed = false;
+  for (Physical& physical : physicals_) {
+    if (physical.kind_ == ResourceKind::kBuffer) {
+      if (physical.id_ == 0) {
+        glGenBuffers(1, &physical.id_);
+        glBindBuffer(GL_ARRAY_BUFFER, physical.id_);
+        glBufferData(GL_ARRAY_BUFFER, physical.size_, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+      }
+      continue;
+    }
+
+    int32_t target_width = 0;
+    int32_t target_height = 0;
+    ResolveSize(physical.desc_, width, height, target_width, target_height);
+    if (physical.id_ != 0 && physical.width_ == target_width && physical.height_ == target_height) {
+      continue;
+    }
+
+    FormatInfo info = GetFormatInfo(physical.desc_.format_);
+    if (physical.id_ == 0) {
+      glGenTextures(1, &physical.id_);
+    }
+    glBindTexture(GL_TEXTURE_2D, physical.id_);
+    glTexImage2D(GL_TEXTURE_2D, 0, info.internal_format_, target_width, target_height, 0, info.format_, info.type_, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, info.depth_ ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, info.depth_ ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    physical.width_ = target_width;
+    physical.height_ = target_height;
+    changed = true;
+  }
+  return changed;
+}
+
+void RenderGraph::BuildFramebuffers() {
+  for (uint32_t index : order_) {
+    Pass& pass = passes_[index];
+    if (pass.backbuffer_ || pass.attachments_.empty()) {
+      continue;
+    }
+
+    if (pass.framebuffer_ == 0) {
+      glGenFramebuffers(1, &pass.framebuffer_);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer_);
+
+    GLenum draw_buffers[8];
+    GLsizei color_count = 0;
+    for (const Attachment& attachment : pass.attachments_) {
+      const Physical& physical = physicals_[resources_[attachment.resource_].physical_];
+      if (GetFormatInfo(physical.desc_.format_).depth_) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, physical.id_, 0);
+      } else {
+        assert(color_count < 8 && "Too many color targets in one pass");
+        draw_buffers[color_count] = GL_COLOR_ATTACHMENT0 + color_count;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, draw_buffers[color_count], GL_TEXTURE_2D, physical.id_, 0);
+        ++color_count;
+      }
+    }
+
+    if (color_count > 0) {
+      glDrawBuffers(color_count, draw_buffers);
+    } else {
+      glDrawBuffer(GL_NONE);
+      glReadBuffer(GL_NONE);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      std::cout << "Framebuffer for pass " << pass.name_ << " is incomplete" << std::endl;
+    }
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderGraph::CountMemory(int32_t width, int32_t height) {
+  auto bytes = [&](ResourceKind kind, const RenderTextureDesc& desc, size_t size) {
+    if (kind == ResourceKind::kBuffer) {
+      return size;
+    }
+    int32_t target_width = 0;
+    int32_t target_height = 0;
+    ResolveSize(desc, width, height, target_width, target_height);
+    return size_t(target_width) * size_t(target_height) * GetFormatInfo(desc.format_).bytes_per_pixel_;
+  };
+
+  stats_.requested_bytes_ = 0;
+  for (const Resource& resource : resources_) {
+    if (resource.physical_ != RenderResource::kNone) {
+      stats_.requested_bytes_ += bytes(resource.kind_, resource.desc_, resource.size_);
+    }
+  }
+
+  stats_.allocated_bytes_ = 0;
+  for (const Physical& physical : physicals_) {
+    stats_.allocated_bytes_ += bytes(physical.kind_, physical.desc_, physical.size_);
+  }
+}
+
+void RenderGraph::BeginPass(const Pass& pass, int32_t width, int32_t height, RenderPassContext& context) const {
+  context.graph_ = this;
+  context.framebuffer_ = 0;
+  context.width_ = width;
+  context.height_ = height;
+
+  if (pass.attachments_.empty()) {
+    return;
+  }
+
+  if (!pass.backbuffer_) {
+    const Physical& first = physicals_[resources_[pass.attachments_[0].resource_].physical_];
+    context.framebuffer_ = pass.framebuffer_;
+    GetDrawnSize(first, context.width_, context.height_);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer_);
+  glViewport(0, 0, context.width_, context.height_);
+
+  const Color& color = pass.clear_color_;
+  GLfloat clear_color[] = { color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f };
+  GLfloat clear_depth = 1.0f;
+
+  GLint color_index = 0;
+  for (const Attachment& attachment : pass.attachments_) {
+    const Resource& resource = resources_[attachment.resource_];
+    bool depth = resource.kind_ == ResourceKind::kTexture && GetFormatInfo(resource.desc_.format_).depth_;
+
+    if (attachment.load_ == LoadOp::kClear) {
+      if (depth || resource.kind_ == ResourceKind::kBackbuffer) {
+        glDepthMask(GL_TRUE);
+        glClearBufferfv(GL_DEPTH, 0, &clear_depth);
+      }
+      if (!depth) {
+        glClearBufferfv(GL_COLOR, color_index, clear_color);
+      }
+    }
+    color_index += depth ? 0 : 1;
+  }
+}
+
+void RenderGraph::SetRenderScale(float scale) {
+  render_scale_ = std::clamp(scale, 0.0f, 1.0f);
+}
+
+float RenderGraph::GetRenderScale() const {
+  return render_scale_;
+}
+
+void RenderGraph::Execute(int32_t width, int32_t height) {
+  assert(compiled_ && "Executing a render graph that changed since Compile");
+
+  bool resized = Allocate(width, height);
+  if (resized || !framebuffers_valid_) {
+    BuildFramebuffers();
+    CountMemory(width, height);
+    framebuffers_valid_ = true;
+  }
+
+  for (uint32_t index : order_) {
+    const Pass& pass = passes_[index];
+
+    RenderPassContext context;
+    BeginPass(pass, width, height, context);
+    pass.function_(context);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, width, height);
+}
+
+const RenderGraphStats& RenderGraph::GetStats() const {
+  return stats_;
+}
+
+void RenderGraph::Report() const {
+  std::cout << "[render graph]";
+  for (size_t i = 0; i < order_.size(); ++i) {
+    std::cout << (i == 0 ? " " : " -> ") << passes_[order_[i]].name_;
+  }
+  std::cout
+    << ", " << stats_.culled_count_ << " culled, " << stats_.barrier_count_ << " barriers" << std::endl;
+
+  size_t saved = stats_.requested_bytes_ - std::min(stats_.allocated_bytes_, stats_.requested_bytes_);
+  std::cout
+    << "[render graph] " << stats_.transient_count_ << " transients in "
+    << stats_.allocation_count_ << " allocations, " << stats_.requested_bytes_ / 1024 << " KB requested, "
+    << stats_.allocated_bytes_ / 1024 << " KB allocated, " << saved / 1024 << " KB saved" << std::endl;
+}
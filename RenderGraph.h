@@ -0,0 +1,252 @@
+#ifndef RENDER_GRAPH_H_
+#define RENDER_GRAPH_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Graphics.h"
+
+enum class RenderFormat {
+  kRGBA8,
+  kRGBA16F,
+  kR11G11B10F,
+  kDepth24,
+  kDepth32F,
+};
+
+// Sized at scale_ times the output unless width_ and height_ are set.
+// Dynamic textures are allocated at that size but only drawn to in the
+// corner the graph's render scale leaves of it, so changing the scale
+// never reallocates.
+struct RenderTextureDesc {
+  RenderFormat format_ = RenderFormat::kRGBA8;
+  float scale_ = 1.0f;
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+  bool dynamic_ = false;
+};
+
+// What a write does with the previous contents of a render target
+enum class LoadOp {
+  kLoad,
+  kClear,
+  kDontCare,
+};
+
+// One version of a graph resource. Every write makes a new version, which
+// is what passes after it read; passes reading the older version are
+// ordered before the write.
+struct RenderResource {
+  constexpr static uint32_t kNone = ~0u;
+
+  uint32_t version_ = kNone;
+
+  bool IsNull() const {
+    return version_ == kNone;
+  }
+};
+
+struct RenderGraphStats {
+  size_t pass_count_ = 0;
+  size_t culled_count_ = 0;
+  // Write to read transitions between passes
+  size_t barrier_count_ = 0;
+  size_t transient_count_ = 0;
+  size_t allocation_count_ = 0;
+  // Transients with an allocation each against what aliasing needed, at
+  // the current output size
+  size_t requested_bytes_ = 0;
+  size_t allocated_bytes_ = 0;
+};
+
+class RenderGraph;
+
+// Handed to each pass while it runs, its targets are already bound
+class RenderPassContext {
+public:
+  uint32_t GetTexture(RenderResource resource) const;
+  uint32_t GetBuffer(RenderResource resource) const;
+  void BindTexture(RenderResource resource, int32_t slot) const;
+
+  // Stretches what was drawn of a color texture over the whole of the
+  // pass's target
+  void Blit(RenderResource source) const;
+  // One triangle covering the target without depth testing, the bound
+  // program makes its corners from gl_VertexID
+  void DrawFullscreen() const;
+
+  // Of the region drawn to, smaller than the texture for dynamic ones
+  int32_t GetWidth() const;
+  int32_t GetHeight() const;
+  void GetDrawnSize(RenderResource resource, int32_t& width, int32_t& height) const;
+  void GetTextureSize(RenderResource resource, int32_t& width, int32_t& height) const;
+private:
+  friend class RenderGraph;
+
+  const RenderGraph* graph_;
+  uint32_t framebuffer_;
+  int32_t width_;
+  int32_t height_;
+};
+
+using RenderPassFunction = std::function<void(const RenderPassContext&)>;
+
+class RenderPassBuilder {
+public:
+  // Sampled or otherwise read by the pass
+  void Read(RenderResource resource);
+  // Textures become the pass's attachments in the order written. kLoad
+  // also depends on whoever wrote the previous version.
+  RenderResource Write(RenderResource resource, LoadOp load = LoadOp::kLoad);
+
+  void SetClearColor(Color color);
+  // Never culled, even when nothing reads what it writes
+  void SetSideEffects();
+private:
+  friend class RenderGraph;
+
+  RenderGraph* graph_;
+  uint32_t pass_;
+};
+
+// Passes declare what they read and write up front. Compile culls the ones
+// nothing depends on, orders the rest and lets transient targets whose
+// lifetimes don't overlap share one allocation. Execute runs the compiled
+// passes every frame without touching the heap.
+//
+// The graph is built once and only recompiled when passes change. Resizing
+// the output only reallocates the targets.
+class RenderGraph {
+public:
+  void Create();
+  void Destroy();
+
+  // Drops every pass and resource, allocations are kept for the next Compile
+  void Reset();
+
+  RenderResource CreateTexture(const std::string& name, const RenderTextureDesc& desc);
+  RenderResource CreateBuffer(const std::string& name, size_t size);
+
+  // The default framebuffer, whatever writes it is always kept
+  RenderResource ImportBackbuffer();
+  // Owned elsewhere. An id of 0 is fine for buffers that only order passes.
+  RenderResource ImportBuffer(const std::string& name, uint32_t id);
+
+  RenderPassBuilder AddPass(const std::string& name, RenderPassFunction function);
+
+  void Compile();
+  // Applied to dynamic textures from the next Execute on, up to 1
+  void SetRenderScale(float scale);
+  float GetRenderScale() const;
+
+  // width and height are the backbuffer's
+  void Execute(int32_t width, int32_t height);
+
+  const RenderGraphStats& GetStats() const;
+  // Pass order and transient memory
+  void Report() const;
+private:
+  friend class RenderPassContext;
+  friend class RenderPassBuilder;
+
+  enum class ResourceKind {
+    kTexture,
+    kBuffer,
+    kBackbuffer,
+    kImportedBuffer,
+  };
+
+  struct Resource {
+    std::string name_;
+    ResourceKind kind_;
+    RenderTextureDesc desc_;
+    size_t size_;
+    uint32_t imported_id_;
+
+    // Positions in the compiled order, first_ > last_ when unused
+    uint32_t first_;
+    uint32_t last_;
+    uint32_t physical_;
+  };
+
+  struct Version {
+    uint32_t resource_;
+    uint32_t previous_;
+    uint32_t writer_;
+  };
+
+  struct Attachment {
+    uint32_t resource_;
+    LoadOp load_;
+  };
+
+  struct Pass {
+    std::string name_;
+    RenderPassFunction function_;
+
+    std::vector<uint32_t> reads_;
+    std::vector<uint32_t> writes_;
+    std::vector<Attachment> attachments_;
+    // Versions the pass depends on without sampling them
+    std::vector<uint32_t> loads_;
+
+    Color clear_color_;
+    bool side_effects_;
+    bool culled_;
+    bool backbuffer_;
+    uint32_t framebuffer_;
+  };
+
+  // A GL object shared by every transient aliased onto it
+  struct Physical {
+    ResourceKind kind_;
+    RenderTextureDesc desc_;
+    size_t size_;
+
+    uint32_t id_;
+    int32_t width_;
+    int32_t height_;
+
+    // Last compiled position of the current occupant while aliasing
+    int64_t busy_until_;
+  };
+
+  RenderResource AddResource(Resource resource);
+  const Resource& GetResource(RenderResource resource) const;
+  uint32_t GetPhysicalId(RenderResource resource) const;
+  void GetDrawnSize(const Physical& physical, int32_t& width, int32_t& height) const;
+
+  void Cull();
+  void Sort();
+  void Alias();
+
+  // Textures follow the output size, framebuffers follow the textures
+  bool Allocate(int32_t width, int32_t height);
+  void BuildFramebuffers();
+  void CountMemory(int32_t width, int32_t height);
+  void BeginPass(const Pass& pass, int32_t width, int32_t height, RenderPassContext& context) const;
+private:
+  std::vector<Resource> resources_;
+  std::vector<Version> versions_;
+  std::vector<Pass> passes_;
+  std::vector<Physical> physicals_;
+
+  // Compiled order, culled passes left out
+  std::vector<uint32_t> order_;
+  bool compiled_ = false;
+  bool framebuffers_valid_ = false;
+
+  float render_scale_ = 1.0f;
+
+  // Read side of Blit
+  uint32_t blit_framebuffer_ = 0;
+  // Core profile draws need a vertex array even without attributes
+  uint32_t empty_vertex_array_ = 0;
+
+  RenderGraphStats stats_;
+};
+
+#endif
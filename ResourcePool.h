@@ -0,0 +1,158 @@
+#ifndef RESOURCE_POOL_H_
+#define RESOURCE_POOL_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <cassert>
+
+// 20 bits of slot index and 12 bits of generation. Generations start at 1,
+// so a default constructed handle never refers to anything.
+template <typename T>
+struct Handle {
+  static constexpr uint32_t kIndexBits = 20;
+  static constexpr uint32_t kIndexMask = (1u << kIndexBits) - 1;
+  static constexpr uint32_t kMaxGeneration = (1u << (32 - kIndexBits)) - 1;
+
+  uint32_t value_ = 0;
+
+  static Handle Make(uint32_t index, uint32_t generation) {
+    return Handle { (generation << kIndexBits) | index };
+  }
+
+  uint32_t GetIndex() const {
+    return value_ & kIndexMask;
+  }
+
+  uint32_t GetGeneration() const {
+    return value_ >> kIndexBits;
+  }
+
+  bool IsNull() const {
+    return value_ == 0;
+  }
+
+  bool operator==(Handle other) const {
+    return value_ == other.value_;
+  }
+
+  bool operator!=(Handle other) const {
+    return value_ != other.value_;
+  }
+};
+
+// For pools whose resources have no cold part
+struct NoColdData {};
+
+// Resources are kept packed so they can be scanned without chasing
+// pointers; handles go through a slot table that maps them to their current
+// dense index. Removal swaps the last element into the hole.
+//
+// Storage is split in two parallel dense arrays: T holds what the frame
+// reads, Cold whatever only creation, destruction and the odd rebuild
+// need, so scans and lookups on the hot path don't pull it into cache.
+//
+// Pointers returned by Get and GetCold are only good until the next Insert
+// or Remove.
+template <typename T, typename Cold = NoColdData>
+class ResourcePool {
+public:
+  Handle<T> Insert(T resource, Cold cold = Cold {}) {
+    uint32_t slot = 0;
+    if (!free_slots_.empty()) {
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+    } else {
+      slot = static_cast<uint32_t>(generations_.size());
+      assert(slot <= Handle<T>::kIndexMask && "Resource pool is full");
+      generations_.push_back(1);
+      slot_dense_.push_back(0);
+    }
+
+    slot_dense_[slot] = static_cast<uint32_t>(dense_.size());
+    dense_.push_back(std::move(resource));
+    cold_.push_back(std::move(cold));
+    dense_slots_.push_back(slot);
+
+    return Handle<T>::Make(slot, generations_[slot]);
+  }
+
+  bool Contains(Handle<T> handle) const {
+    uint32_t slot = handle.GetIndex();
+    return
+      !handle.IsNull() &&
+      slot < generations_.size() &&
+      generations_[slot] == handle.GetGeneration();
+  }
+
+  T* Get(Handle<T> handle) {
+    return Contains(handle) ? &dense_[slot_dense_[handle.GetIndex()]] : nullptr;
+  }
+
+  const T* Get(Handle<T> handle) const {
+    return Contains(handle) ? &dense_[slot_dense_[handle.GetIndex()]] : nullptr;
+  }
+
+  Cold* GetCold(Handle<T> handle) {
+    return Contains(handle) ? &cold_[slot_dense_[handle.GetIndex()]] : nullptr;
+  }
+
+  const Cold* GetCold(Handle<T> handle) const {
+    return Contains(handle) ? &cold_[slot_dense_[handle.GetIndex()]] : nullptr;
+  }
+
+  // The handle is dead as soon as this returns, the resource is handed back
+  // so the caller decides when it is actually destroyed. Its cold part goes
+  // to cold when given.
+  T Remove(Handle<T> handle, Cold* cold = nullptr) {
+    uint32_t slot = handle.GetIndex();
+    uint32_t dense = slot_dense_[slot];
+    uint32_t last = static_cast<uint32_t>(dense_.size() - 1);
+
+    T resource = std::move(dense_[dense]);
+    if (cold != nullptr) {
+      *cold = std::move(cold_[dense]);
+    }
+    if (dense != last) {
+      dense_[dense] = std::move(dense_[last]);
+      cold_[dense] = std::move(cold_[last]);
+      dense_slots_[dense] = dense_slots_[last];
+      slot_dense_[dense_slots_[dense]] = dense;
+    }
+    dense_.pop_back();
+    cold_.pop_back();
+    dense_slots_.pop_back();
+
+    uint32_t generation = generations_[slot] + 1;
+    generations_[slot] = generation > Handle<T>::kMaxGeneration ? 1 : generation;
+    free_slots_.push_back(slot);
+
+    return resource;
+  }
+
+  // Handle of the resource at a dense index, for use while iterating
+  Handle<T> GetHandle(size_t dense) const {
+    uint32_t slot = dense_slots_[dense];
+    return Handle<T>::Make(slot, generations_[slot]);
+  }
+
+  size_t Size() const {
+    return dense_.size();
+  }
+
+  T* begin() { return dense_.data(); }
+  T* end() { return dense_.data() + dense_.size(); }
+  const T* begin() const { return dense_.data(); }
+  const T* end() const { return dense_.data() + dense_.size(); }
+private:
+  std::vector<T> dense_;
+  std::vector<Cold> cold_;
+  std::vector<uint32_t> dense_slots_;
+
+  std::vector<uint32_t> slot_dense_;
+  std::vector<uint16_t> generations_;
+  std::vector<uint32_t> free_slots_;
+};
+
+#endif
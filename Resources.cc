@@ -0,0 +1,232 @@
+#include "Resources.h"
+
+#include "GLExtensions.h"
+
+#include <vector>
+#include <utility>
+
+template <typename T, typename Cold = NoColdData>
+struct PendingRelease {
+  // Last frame that could have referenced the resource
+  uint64_t frame_;
+  T resource_;
+  Cold cold_;
+};
+
+struct FrameFence {
+  uint64_t frame_;
+  GLsync fence_;
+};
+
+static struct {
+  ResourcePool<Primitive, PrimitiveBuffers> primitives_;
+  ResourcePool<TextureArray> textures_;
+  ResourcePool<Shader> shaders_;
+  ResourcePool<Model> models_;
+
+  std::vector<PendingRelease<Primitive, PrimitiveBuffers>> pending_primitives_;
+  std::vector<PendingRelease<TextureArray>> pending_textures_;
+  std::vector<PendingRelease<Shader>> pending_shaders_;
+
+  // Oldest first. Only a few frames are ever in flight, and unlike a deque
+  // the vector keeps its capacity so steady state doesn't allocate
+  std::vector<FrameFence> fences_;
+  // Frames submitted so far, and how many of them the GPU has finished
+  uint64_t frame_ = 0;
+  uint64_t completed_frames_ = 0;
+} Pools;
+
+static void Release(Primitive& primitive, PrimitiveBuffers& buffers) {
+  Graphics::DestroyPrimitive(primitive, buffers);
+}
+
+static void Release(TextureArray& texture, NoColdData&) {
+  texture.UnloadTexture();
+}
+
+static void Release(Shader& shader, NoColdData&) {
+  shader.UnloadShader();
+}
+
+// Entries are queued in frame order, so everything retired is at the front
+template <typename T, typename Cold>
+static void ReleaseCompleted(std::vector<PendingRelease<T, Cold>>& pending, uint64_t completed_frames) {
+  size_t count = 0;
+  while (count < pending.size() && pending[count].frame_ < completed_frames) {
+    Release(pending[count].resource_, pending[count].cold_);
+    ++count;
+  }
+  pending.erase(pending.begin(), pending.begin() + count);
+}
+
+template <typename T, typename Cold>
+static void RetireAll(ResourcePool<T, Cold>& pool, std::vector<PendingRelease<T, Cold>>& pending) {
+  for (PendingRelease<T, Cold>& entry : pending) {
+    Release(entry.resource_, entry.cold_);
+  }
+  pending.clear();
+
+  while (pool.Size() > 0) {
+    Cold cold;
+    T resource = pool.Remove(pool.GetHandle(0), &cold);
+    Release(resource, cold);
+  }
+}
+
+template <typename T, typename Cold>
+static void Defer(ResourcePool<T, Cold>& pool, std::vector<PendingRelease<T, Cold>>& pending, Handle<T> handle) {
+  if (!pool.Contains(handle)) {
+    return;
+  }
+  PendingRelease<T, Cold> entry;
+  entry.frame_ = Pools.frame_;
+  entry.resource_ = pool.Remove(handle, &entry.cold_);
+  pending.push_back(std::move(entry));
+}
+
+PrimitiveHandle Resources::CreatePrimitive(
+  const Vertex* vertices,
+  size_t vertex_count,
+  uint32_t index_count,
+  uint32_t index_type,
+  uint32_t joint_type,
+  const uint8_t* raw_indices,
+  size_t raw_indices_size
+) {
+  PrimitiveBuffers buffers;
+  Primitive primitive = Graphics::CreatePrimitive(
+    vertices, vertex_count, index_count, index_type, joint_type, buffers, raw_indices, raw_indices_size
+  );
+  return Pools.primitives_.Insert(primitive, buffers);
+}
+
+PrimitiveHandle Resources::CreatePrimitive(
+  const VertexLayout& layout,
+  const uint8_t* const (&streams)[kStreamCount],
+  size_t vertex_count,
+  uint32_t index_count,
+  uint32_t index_type,
+  const uint8_t* raw_indices,
+  size_t raw_indices_size
+) {
+  PrimitiveBuffers buffers;
+  Primitive primitive = Graphics::CreatePrimitive(
+    layout, streams, vertex_count, index_count, index_type, buffers, raw_indices, raw_indices_size
+  );
+  return Pools.primitives_.Insert(primitive, buffers);
+}
+
+TextureHandle Resources::CreateTexture(const TextureArrayDesc& desc) {
+  TextureArray texture;
+  texture.Create(desc);
+  return Pools.textures_.Insert(texture);
+}
+
+ShaderHandle Resources::LoadShader(const std::string& filename, uint32_t features) {
+  Shader shader;
+  shader.LoadShader(filename, features);
+  return Pools.shaders_.Insert(shader);
+}
+
+ModelHandle Resources::LoadModel(const std::string& filename, bool keep_occluders) {
+  Model model;
+  model.Load(filename, keep_occluders);
+  return Pools.models_.Insert(std::move(model));
+}
+
+Primitive* Resources::Get(PrimitiveHandle handle) {
+  return Pools.primitives_.Get(handle);
+}
+
+TextureArray* Resources::Get(TextureHandle handle) {
+  return Pools.textures_.Get(handle);
+}
+
+Shader* Resources::Get(ShaderHandle handle) {
+  return Pools.shaders_.Get(handle);
+}
+
+Model* Resources::Get(ModelHandle handle) {
+  return Pools.models_.Get(handle);
+}
+
+PrimitiveBuffers* Resources::GetBuffers(PrimitiveHandle handle) {
+  return Pools.primitives_.GetCold(handle);
+}
+
+void Resources::Destroy(PrimitiveHandle handle) {
+  Defer(Pools.primitives_, Pools.pending_primitives_, handle);
+}
+
+void Resources::Destroy(TextureHandle handle) {
+  Defer(Pools.textures_, Pools.pending_textures_, handle);
+}
+
+void Resources::Destroy(ShaderHandle handle) {
+  Defer(Pools.shaders_, Pools.pending_shaders_, handle);
+}
+
+void Resources::Destroy(ModelHandle handle) {
+  if (!Pools.models_.Contains(handle)) {
+    return;
+  }
+  Model model = Pools.models_.Remove(handle);
+  model.Unload();
+}
+
+const ResourcePool<Primitive, PrimitiveBuffers>& Resources::GetPrimitives() {
+  return Pools.primitives_;
+}
+
+const ResourcePool<TextureArray>& Resources::GetTextures() {
+  return Pools.textures_;
+}
+
+const ResourcePool<Shader>& Resources::GetShaders() {
+  return Pools.shaders_;
+}
+
+const ResourcePool<Model>& Resources::GetModels() {
+  return Pools.models_;
+}
+
+void Resources::EndFrame() {
+  Pools.fences_.push_back(FrameFence { Pools.frame_, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+  ++Pools.frame_;
+
+  // Never blocks, whatever hasn't signaled yet is checked again next frame
+  size_t signaled = 0;
+  while (signaled < Pools.fences_.size()) {
+    FrameFence& front = Pools.fences_[signaled];
+    GLenum result = glClientWaitSync(front.fence_, 0, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    Pools.completed_frames_ = front.frame_ + 1;
+    glDeleteSync(front.fence_);
+    ++signaled;
+  }
+  Pools.fences_.erase(Pools.fences_.begin(), Pools.fences_.begin() + signaled);
+
+  ReleaseCompleted(Pools.pending_primitives_, Pools.completed_frames_);
+  ReleaseCompleted(Pools.pending_textures_, Pools.completed_frames_);
+  ReleaseCompleted(Pools.pending_shaders_, Pools.completed_frames_);
+}
+
+void Resources::Shutdown() {
+  glFinish();
+
+  for (FrameFence& frame_fence : Pools.fences_) {
+    glDeleteSync(frame_fence.fence_);
+  }
+  Pools.fences_.clear();
+  Pools.completed_frames_ = Pools.frame_;
+
+  while (Pools.models_.Size() > 0) {
+    Destroy(Pools.models_.GetHandle(0));
+  }
+
+  RetireAll(Pools.primitives_, Pools.pending_primitives_);
+  RetireAll(Pools.textures_, Pools.pending_textures_);
+  RetireAll(Pools.shaders_, Pools.pending_shaders_);
+}
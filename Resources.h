@@ -0,0 +1,66 @@
+#ifndef RESOURCES_H_
+#define RESOURCES_H_
+
+#include <string>
+#include <cstdint>
+
+#include "Graphics.h"
+#include "ResourcePool.h"
+
+// Owns every GL resource. Callers hold handles, which go stale instead of
+// dangling once the resource is destroyed.
+//
+// Destroying a GPU resource only invalidates its handle; the GL objects are
+// deleted once the fence of the last frame that could have used them has
+// signaled. EndFrame has to run once per frame for that to happen.
+class Resources {
+public:
+  static PrimitiveHandle CreatePrimitive(
+    const Vertex* vertices,
+    size_t vertex_count,
+    uint32_t index_count,
+    uint32_t index_type,
+    uint32_t joint_type,
+    const uint8_t* raw_indices = nullptr,
+    size_t raw_indices_size = 0
+  );
+  static PrimitiveHandle CreatePrimitive(
+    const VertexLayout& layout,
+    const uint8_t* const (&streams)[kStreamCount],
+    size_t vertex_count,
+    uint32_t index_count,
+    uint32_t index_type,
+    const uint8_t* raw_indices = nullptr,
+    size_t raw_indices_size = 0
+  );
+  static TextureHandle CreateTexture(const TextureArrayDesc& desc);
+  static ShaderHandle LoadShader(const std::string& filename, uint32_t features = 0);
+  static ModelHandle LoadModel(const std::string& filename, bool keep_occluders = false);
+
+  // nullptr for stale handles
+  static Primitive* Get(PrimitiveHandle handle);
+  static TextureArray* Get(TextureHandle handle);
+  static Shader* Get(ShaderHandle handle);
+  static Model* Get(ModelHandle handle);
+  // Buffers and layout behind a primitive, nullptr for stale handles
+  static PrimitiveBuffers* GetBuffers(PrimitiveHandle handle);
+
+  static void Destroy(PrimitiveHandle handle);
+  static void Destroy(TextureHandle handle);
+  static void Destroy(ShaderHandle handle);
+  // Also destroys the model's primitives and textures
+  static void Destroy(ModelHandle handle);
+
+  static const ResourcePool<Primitive, PrimitiveBuffers>& GetPrimitives();
+  static const ResourcePool<TextureArray>& GetTextures();
+  static const ResourcePool<Shader>& GetShaders();
+  static const ResourcePool<Model>& GetModels();
+
+  // Call after the swap
+  static void EndFrame();
+
+  // Waits for the GPU and deletes everything, live or pending
+  static void Shutdown();
+};
+
+#endif
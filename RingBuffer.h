@@ -0,0 +1,53 @@
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-capacity queue, safe for exactly one producer thread and one
+// consumer thread. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class RingBuffer {
+  static_assert((Capacity & (Capacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+public:
+  RingBuffer() : head_(0), tail_(0) {}
+
+  // Producer side, returns false and drops the item when full
+  bool Push(const T& item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    items_[head & kMask] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool Pop(T& item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items_[tail & kMask];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t Size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  constexpr static size_t GetCapacity() {
+    return Capacity;
+  }
+private:
+  constexpr static size_t kMask = Capacity - 1;
+
+  // Separate cache lines so the two threads don't false share
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+  T items_[Capacity];
+};
+
+#endif
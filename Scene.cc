@@ -0,0 +1,44 @@
+#include "Scene.h"
+
+#include <cmath>
+
+glm::vec3 Scene::MoveController(const Controller& controller, const InputManager& input, float yaw, float dt) {
+  glm::vec2 move(0.0);
+  move.y += input.IsActionDown(controller.forward_) ? 1.0f : 0.0f;
+  move.y -= input.IsActionDown(controller.back_) ? 1.0f : 0.0f;
+  move.x += input.IsActionDown(controller.right_) ? 1.0f : 0.0f;
+  move.x -= input.IsActionDown(controller.left_) ? 1.0f : 0.0f;
+  if (move.x == 0.0f && move.y == 0.0f) {
+    return glm::vec3(0.0);
+  }
+  move = glm::normalize(move) * controller.speed_ * dt;
+
+  // Forward is -z at a yaw of 0
+  float s = std::sin(yaw);
+  float c = std::cos(yaw);
+  return glm::vec3(move.x * c - move.y * s, 0.0f, -(move.x * s + move.y * c));
+}
+
+void Scene::UpdateControllers(World& world, const InputManager& input, float dt) {
+  world.Each<Transform, Controller>([&](Transform& transform, const Controller& controller) {
+    transform.position_ += MoveController(controller, input, transform.yaw_, dt);
+  });
+}
+
+// Built directly instead of through glm::translate/rotate/scale, which
+// would do three full matrix multiplies per entity
+void Scene::UpdateWorldMatrices(World& world) {
+  world.ParallelEachChunk<Transform, WorldMatrix>([](uint32_t count, const Entity*, const Transform* transforms, WorldMatrix* matrices) {
+    for (uint32_t i = 0; i < count; ++i) {
+      const Transform& transform = transforms[i];
+      float s = std::sin(transform.yaw_);
+      float c = std::cos(transform.yaw_);
+
+      glm::mat4& m = matrices[i].value_;
+      m[0] = glm::vec4(c * transform.scale_.x, 0.0f, -s * transform.scale_.x, 0.0f);
+      m[1] = glm::vec4(0.0f, transform.scale_.y, 0.0f, 0.0f);
+      m[2] = glm::vec4(s * transform.scale_.z, 0.0f, c * transform.scale_.z, 0.0f);
+      m[3] = glm::vec4(transform.position_, 1.0f);
+    }
+  });
+}
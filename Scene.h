@@ -0,0 +1,60 @@
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+
+#include "Graphics.h"
+#include "InputManager.h"
+#include "World.h"
+
+// Components of the entities in a scene World, and the systems that update
+// them once per frame
+
+struct Transform {
+  glm::vec3 position_ = glm::vec3(0.0);
+  // Radians around +y
+  float yaw_ = 0.0f;
+  glm::vec3 scale_ = glm::vec3(1.0);
+};
+
+// Written from Transform by UpdateWorldMatrices
+struct WorldMatrix {
+  glm::mat4 value_ = glm::mat4(1.0);
+};
+
+// Draws every MeshPrimitive of the model, each at WorldMatrix times the
+// mesh's local transform
+struct Renderable {
+  ModelHandle model_;
+};
+
+// Which skinned pose the entity is drawn with. Entities sharing a pose id
+// share one SkinCache entry per primitive.
+struct SkeletonPose {
+  uint32_t pose_ = 0;
+};
+
+// Moves the entity on the xz plane while the actions are held, relative to
+// its yaw
+struct Controller {
+  ActionId forward_;
+  ActionId back_;
+  ActionId left_;
+  ActionId right_;
+  float speed_ = 1.0f;
+};
+
+class Scene {
+public:
+  // Displacement over dt of something facing yaw, for controllers whose
+  // entity is moved elsewhere, such as on the simulation thread
+  static glm::vec3 MoveController(const Controller& controller, const InputManager& input, float yaw, float dt);
+  static void UpdateControllers(World& world, const InputManager& input, float dt);
+  // Spread over the world's workers
+  static void UpdateWorldMatrices(World& world);
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "Simulation.h"
+
+#include <algorithm>
+
+// Ticks allowed back to back before the simulation gives up catching up and
+// resynchronizes with the wall clock
+constexpr int32_t kMaxCatchUpTicks = 5;
+
+WorldState WorldState::Interpolate(const WorldState& a, const WorldState& b, float alpha) {
+  WorldState result;
+  result.camera_position_ = glm::mix(a.camera_position_, b.camera_position_, alpha);
+  result.player_position_ = glm::mix(a.player_position_, b.player_position_, alpha);
+  return result;
+}
+
+Simulation::Simulation(double dt, StepFunction step) 
+  : dt_(dt), step_(step), clock_(SimulationClock::kThread), time_(0.0), accumulator_(0.0), running_(false), tick_count_(0) {}
+
+Simulation::~Simulation() {
+  Stop();
+}
+
+void Simulation::Start(const WorldState& initial, SimulationClock clock) {
+  if (running_) {
+    return;
+  }
+
+  clock_ = clock;
+  state_ = initial;
+  time_ = 0.0;
+  accumulator_ = 0.0;
+
+  Snapshot& snapshot = snapshots_.GetWriteBuffer();
+  snapshot.previous_ = initial;
+  snapshot.current_ = initial;
+  snapshot.tick_time_ = Clock::now();
+  snapshots_.Publish();
+  snapshots_.Update();
+
+  running_ = true;
+  if (clock_ == SimulationClock::kThread) {
+    thread_ = std::thread(&Simulation::Run, this);
+  }
+}
+
+void Simulation::Stop() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void Simulation::Tick(const InputManager& input, Clock::time_point tick_time) {
+  WorldState previous = state_;
+  step_(state_, input, time_, dt_);
+  time_ += dt_;
+
+  Snapshot& snapshot = snapshots_.GetWriteBuffer();
+  snapshot.previous_ = previous;
+  snapshot.current_ = state_;
+  snapshot.tick_time_ = tick_time;
+  snapshots_.Publish();
+
+  tick_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Simulation::Run() {
+  Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(dt_));
+  Clock::time_point next_tick = Clock::now() + step;
+
+  while (running_) {
+    std::this_thread::sleep_until(next_tick);
+
+    inputs_.Update();
+    const InputManager& input = inputs_.GetReadBuffer();
+
+    int32_t ticks = 0;
+    while (Clock::now() >= next_tick && ticks < kMaxCatchUpTicks) {
+      Tick(input, next_tick);
+      next_tick += step;
+      ++ticks;
+    }
+
+    if (ticks == kMaxCatchUpTicks) {
+      next_tick = Clock::now() + step;
+    }
+  }
+}
+
+void Simulation::Advance(double frame_dt, const InputManager& input) {
+  if (clock_ == SimulationClock::kThread) {
+    inputs_.GetWriteBuffer() = input;
+    inputs_.Publish();
+    return;
+  }
+
+  if (!running_) {
+    return;
+  }
+
+  accumulator_ += frame_dt;
+  int32_t ticks = 0;
+  while (accumulator_ >= dt_ && ticks < kMaxCatchUpTicks) {
+    Tick(input, Clock::now());
+    accumulator_ -= dt_;
+    ++ticks;
+  }
+
+  // Same give up as the thread clock, still only a function of the deltas
+  if (ticks == kMaxCatchUpTicks) {
+    accumulator_ = 0.0;
+  }
+}
+
+WorldState Simulation::Sample() {
+  snapshots_.Update();
+  const Snapshot& snapshot = snapshots_.GetReadBuffer();
+
+  double accumulator = clock_ == SimulationClock::kFrame
+    ? accumulator_
+    : std::chrono::duration<double>(Clock::now() - snapshot.tick_time_).count();
+  float alpha = std::clamp(accumulator / dt_, 0.0, 1.0);
+
+  return WorldState::Interpolate(snapshot.previous_, snapshot.current_, alpha);
+}
+
+double Simulation::GetTimeStep() const {
+  return dt_;
+}
+
+uint64_t Simulation::GetTickCount() const {
+  return tick_count_.load(std::memory_order_relaxed);
+}
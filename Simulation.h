@@ -0,0 +1,86 @@
+#ifndef SIMULATION_H_
+#define SIMULATION_H_
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+#include "InputManager.h"
+#include "TripleBuffer.h"
+
+struct WorldState {
+  glm::vec3 camera_position_ = glm::vec3(0.0);
+  // Of the controlled entity, the render thread copies it into the World
+  glm::vec3 player_position_ = glm::vec3(0.0);
+
+  static WorldState Interpolate(const WorldState& a, const WorldState& b, float alpha);
+};
+
+enum class SimulationClock {
+  // Ticks on its own thread against the wall clock
+  kThread,
+  // Ticks inside Advance on the render thread, as the frame deltas it is
+  // given add up. With recorded deltas and input this replays exactly.
+  kFrame,
+};
+
+// Runs fixed-step updates on a dedicated thread, or on the render thread
+// with SimulationClock::kFrame. Each tick publishes the last two states so
+// the render thread can interpolate between them with accumulator / dt,
+// where accumulator is the time since the newest tick.
+//
+// Steps see the input the render thread last handed over with Advance. On
+// the thread clock only held state is reliable there, an edge can be seen
+// by any number of ticks.
+class Simulation {
+public:
+  using StepFunction = std::function<void(WorldState& state, const InputManager& input, double time, double dt)>;
+
+  Simulation(double dt, StepFunction step);
+  ~Simulation();
+
+  void Start(const WorldState& initial, SimulationClock clock = SimulationClock::kThread);
+  void Stop();
+
+  // Called from the render thread once per frame, before Sample. frame_dt
+  // only matters to the frame clock, which runs the ticks it completes.
+  void Advance(double frame_dt, const InputManager& input);
+  WorldState Sample();
+
+  double GetTimeStep() const;
+  uint64_t GetTickCount() const;
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Snapshot {
+    WorldState previous_;
+    WorldState current_;
+    Clock::time_point tick_time_;
+  };
+
+  void Run();
+  void Tick(const InputManager& input, Clock::time_point tick_time);
+private:
+  double dt_;
+  StepFunction step_;
+  SimulationClock clock_;
+
+  // Owned by whichever thread ticks
+  WorldState state_;
+  double time_;
+  // Frame clock only
+  double accumulator_;
+
+  TripleBuffer<Snapshot> snapshots_;
+  TripleBuffer<InputManager> inputs_;
+
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<uint64_t> tick_count_;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "SkinCache.h"
+
+#include "GLExtensions.h"
+#include "Resources.h"
+
+#include <cstddef>
+#include <cassert>
+
+static uint64_t EntryKey(uint32_t pose, PrimitiveHandle handle) {
+  return (uint64_t(pose) << 32) | handle.value_;
+}
+
+void SkinCache::Create(const std::string& skin_shader) {
+  const char* varyings[] = { "skinnedPos", "skinnedNormal" };
+  shader_.LoadFeedbackShader(skin_shader, varyings, 2, kFeatureSkinned);
+
+  shader_.SetUniformBlockBinding("FrameUniforms", kFrameUniformBinding);
+  shader_.SetUniformBlockBinding("SkinUniforms", kSkinUniformBinding);
+
+  frame_ = 0;
+  skin_count_ = 0;
+}
+
+void SkinCache::Destroy() {
+  for (auto& [key, entry] : entries_) {
+    DestroySkinned(entry.skinned_);
+  }
+  entries_.clear();
+
+  shader_.UnloadShader();
+}
+
+void SkinCache::BeginFrame() {
+  ++frame_;
+  skin_count_ = 0;
+}
+
+const SkinnedPrimitive& SkinCache::Skin(uint32_t pose, PrimitiveHandle handle) {
+  const Primitive* primitive = Resources::Get(handle);
+  assert(primitive != nullptr && "Skinning a destroyed primitive");
+
+  Entry& entry = GetEntry(pose, handle, *primitive);
+  if (entry.frame_ == frame_) {
+    return entry.skinned_;
+  }
+  entry.frame_ = frame_;
+  ++skin_count_;
+
+  // One point per vertex in, one skinned vertex out, nothing rasterized
+  shader_.Enable();
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, entry.skinned_.position_buffer_);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, entry.skinned_.normal_buffer_);
+
+  glBindVertexArray(primitive->vao_);
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, primitive->vertex_count_);
+  glEndTransformFeedback();
+  glBindVertexArray(0);
+
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, 0);
+  glDisable(GL_RASTERIZER_DISCARD);
+
+  return entry.skinned_;
+}
+
+const SkinnedPrimitive& SkinCache::Prepare(uint32_t pose, PrimitiveHandle handle) {
+  const Primitive* primitive = Resources::Get(handle);
+  assert(primitive != nullptr && "Preparing a destroyed primitive");
+  return GetEntry(pose, handle, *primitive).skinned_;
+}
+
+SkinCache::Entry& SkinCache::GetEntry(uint32_t pose, PrimitiveHandle handle, const Primitive& primitive) {
+  auto [it, inserted] = entries_.try_emplace(EntryKey(pose, handle));
+  Entry& entry = it->second;
+  if (inserted) {
+    entry.skinned_ = CreateSkinned(primitive, *Resources::GetBuffers(handle));
+    entry.frame_ = 0;
+  }
+  return entry;
+}
+
+void SkinCache::Collect() {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    PrimitiveHandle handle { uint32_t(it->first) };
+    if (Resources::Get(handle) == nullptr) {
+      DestroySkinned(it->second.skinned_);
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t SkinCache::GetSkinCount() const {
+  return skin_count_;
+}
+
+SkinnedPrimitive SkinCache::CreateSkinned(const Primitive& primitive, const PrimitiveBuffers& buffers) {
+  SkinnedPrimitive skinned;
+  skinned.vertex_count_ = primitive.vertex_count_;
+  skinned.index_count_ = primitive.index_count_;
+  skinned.index_type_ = primitive.index_type_;
+
+  glGenBuffers(1, &skinned.position_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, skinned.position_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, primitive.vertex_count_ * sizeof(glm::vec3), nullptr, GL_DYNAMIC_COPY);
+
+  glGenBuffers(1, &skinned.normal_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, skinned.normal_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, primitive.vertex_count_ * sizeof(glm::vec3), nullptr, GL_DYNAMIC_COPY);
+
+  glGenVertexArrays(1, &skinned.vao_);
+  glGenVertexArrays(1, &skinned.depth_vao_);
+
+  // Same locations as the skinned layout, minus joints and weights
+  for (uint32_t vao : { skinned.vao_, skinned.depth_vao_ }) {
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, skinned.position_buffer_);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+    glEnableVertexAttribArray(0);
+
+    if (primitive.index_count_ > 0) {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo_);
+    }
+  }
+
+  glBindVertexArray(skinned.vao_);
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo_);
+  Graphics::SetVertexAttribute(buffers.layout_, kAttributeTexCoord);
+
+  glBindBuffer(GL_ARRAY_BUFFER, skinned.normal_buffer_);
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+  glEnableVertexAttribArray(2);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  return skinned;
+}
+
+void SkinCache::DestroySkinned(SkinnedPrimitive& skinned) {
+  glDeleteVertexArrays(1, &skinned.vao_);
+  glDeleteVertexArrays(1, &skinned.depth_vao_);
+  glDeleteBuffers(1, &skinned.position_buffer_);
+  glDeleteBuffers(1, &skinned.normal_buffer_);
+}
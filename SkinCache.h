@@ -0,0 +1,53 @@
+#ifndef SKIN_CACHE_H_
+#define SKIN_CACHE_H_
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Graphics.h"
+
+// Skins each primitive once per frame into its own buffer with transform
+// feedback, so every later pass draws it with a plain static vertex shader
+// instead of skinning again.
+//
+// Skin uses whatever FrameUniforms and SkinUniforms are bound at the time.
+// Instances that share a pose pass the same pose id and share the result.
+class SkinCache {
+public:
+  void Create(const std::string& skin_shader);
+  void Destroy();
+
+  // Everything skinned in earlier frames goes stale
+  void BeginFrame();
+
+  // Leaves the skinning program bound
+  const SkinnedPrimitive& Skin(uint32_t pose, PrimitiveHandle handle);
+  // The entry Skin will fill, created if needed but not skinned. Lets draws
+  // be recorded against its vertex arrays before the skinning runs.
+  const SkinnedPrimitive& Prepare(uint32_t pose, PrimitiveHandle handle);
+
+  // Releases entries whose primitive has been destroyed
+  void Collect();
+
+  // Transform feedback draws issued since BeginFrame
+  size_t GetSkinCount() const;
+private:
+  struct Entry {
+    SkinnedPrimitive skinned_;
+    uint64_t frame_;
+  };
+
+  Entry& GetEntry(uint32_t pose, PrimitiveHandle handle, const Primitive& primitive);
+
+  static SkinnedPrimitive CreateSkinned(const Primitive& primitive, const PrimitiveBuffers& buffers);
+  static void DestroySkinned(SkinnedPrimitive& skinned);
+private:
+  Shader shader_;
+
+  std::unordered_map<uint64_t, Entry> entries_;
+  uint64_t frame_ = 0;
+  size_t skin_count_ = 0;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "SkinPalette.h"
+
+#include <cmath>
+
+size_t SkinPalette::GetVec4sPerBone(SkinningMode mode) {
+  return mode == SkinningMode::kDualQuaternion ? 2 : 3;
+}
+
+void SkinPalette::Pack(SkinningMode mode, const glm::mat4* joints, size_t count, glm::vec4* out) {
+  if (mode == SkinningMode::kDualQuaternion) {
+    PackDualQuaternion(joints, count, out);
+  } else {
+    PackLinear(joints, count, out);
+  }
+}
+
+// The bottom row of an affine matrix is always (0, 0, 0, 1), so only the
+// rows are stored and the shader multiplies vec4(pos, 1) from the left
+void SkinPalette::PackLinear(const glm::mat4* joints, size_t count, glm::vec4* out) {
+  for (size_t i = 0; i < count; ++i) {
+    const glm::mat4& m = joints[i];
+    for (int32_t row = 0; row < 3; ++row) {
+      out[i * 3 + row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+    }
+  }
+}
+
+// Rotation part of m as a quaternion in xyzw order. Scale is divided out of
+// the basis first, dual quaternions can't represent it.
+static glm::vec4 RotationQuaternion(const glm::mat4& m) {
+  glm::vec3 x = glm::normalize(glm::vec3(m[0]));
+  glm::vec3 y = glm::normalize(glm::vec3(m[1]));
+  glm::vec3 z = glm::normalize(glm::vec3(m[2]));
+
+  float trace = x.x + y.y + z.z;
+  glm::vec4 q;
+  if (trace > 0.0f) {
+    float s = std::sqrt(trace + 1.0f) * 2.0f;
+    q = glm::vec4((y.z - z.y) / s, (z.x - x.z) / s, (x.y - y.x) / s, 0.25f * s);
+  } else if (x.x > y.y && x.x > z.z) {
+    float s = std::sqrt(1.0f + x.x - y.y - z.z) * 2.0f;
+    q = glm::vec4(0.25f * s, (y.x + x.y) / s, (z.x + x.z) / s, (y.z - z.y) / s);
+  } else if (y.y > z.z) {
+    float s = std::sqrt(1.0f + y.y - x.x - z.z) * 2.0f;
+    q = glm::vec4((y.x + x.y) / s, 0.25f * s, (z.y + y.z) / s, (z.x - x.z) / s);
+  } else {
+    float s = std::sqrt(1.0f + z.z - x.x - y.y) * 2.0f;
+    q = glm::vec4((z.x + x.z) / s, (z.y + y.z) / s, 0.25f * s, (x.y - y.x) / s);
+  }
+
+  // Keeping w positive puts neighbouring joints in the same hemisphere
+  // most of the time, the shader still checks per vertex
+  return q.w < 0.0f ? -q : q;
+}
+
+void SkinPalette::PackDualQuaternion(const glm::mat4* joints, size_t count, glm::vec4* out) {
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec4 real = RotationQuaternion(joints[i]);
+    glm::vec3 t = glm::vec3(joints[i][3]);
+    glm::vec3 r = glm::vec3(real);
+
+    // dual = 0.5 * (t, 0) * real
+    glm::vec3 dual_xyz = (real.w * t + glm::cross(t, r)) * 0.5f;
+    float dual_w = -glm::dot(t, r) * 0.5f;
+
+    out[i * 2 + 0] = real;
+    out[i * 2 + 1] = glm::vec4(dual_xyz, dual_w);
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef SKIN_PALETTE_H_
+#define SKIN_PALETTE_H_
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <cstddef>
+
+// Matches the constants in shaders/skinning.glsl
+enum class SkinningMode : int32_t {
+  kLinear = 0,
+  kDualQuaternion = 1,
+};
+
+// Converts joint matrices into the palette layout the shader reads from the
+// SkinUniforms block:
+//   kLinear          top three rows of each matrix (mat3x4, 48 bytes)
+//   kDualQuaternion  real and dual quaternion (32 bytes), rigid joints only
+class SkinPalette {
+public:
+  static size_t GetVec4sPerBone(SkinningMode mode);
+
+  // out needs count * GetVec4sPerBone(mode) entries
+  static void Pack(SkinningMode mode, const glm::mat4* joints, size_t count, glm::vec4* out);
+private:
+  static void PackLinear(const glm::mat4* joints, size_t count, glm::vec4* out);
+  static void PackDualQuaternion(const glm::mat4* joints, size_t count, glm::vec4* out);
+};
+
+#endif
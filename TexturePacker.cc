@@ -0,0 +1,150 @@
+#include "TexturePacker.h"
+
+#include <algorithm>
+#include <tuple>
+#include <map>
+
+// GL guarantees at least 256 layers per array texture
+constexpr int32_t kMaxLayers = 256;
+
+// Gutter around atlased textures, filled with their edge texels on upload so
+// bilinear taps and the first two mips don't bleed. Only clamped textures
+// are atlased, the gutter is what clamping to the rectangle looks like.
+constexpr int32_t kAtlasPadding = 4;
+
+constexpr int32_t kClampToEdge = 33071;
+
+using GroupKey = std::tuple<int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t>;
+
+static GroupKey MakeKey(const TextureData& texture, int32_t width, int32_t height) {
+  return GroupKey(
+    width, height, texture.component_, 
+    texture.wrap_s_, texture.wrap_t_, texture.min_filter_, texture.mag_filter_
+  );
+}
+
+static TextureArrayDesc MakeArray(const TextureData& texture, int32_t width, int32_t height) {
+  TextureArrayDesc desc;
+  desc.width_ = width;
+  desc.height_ = height;
+  desc.component_ = texture.component_;
+  desc.layers_ = 0;
+  desc.wrap_s_ = texture.wrap_s_;
+  desc.wrap_t_ = texture.wrap_t_;
+  desc.min_filter_ = texture.min_filter_;
+  desc.mag_filter_ = texture.mag_filter_;
+  return desc;
+}
+
+// Returns the array to add a layer to, starting a new one once the current
+// array for the key is full
+static int32_t FindArray(
+  TextureLayout& layout, 
+  std::map<GroupKey, int32_t>& groups, 
+  const TextureData& texture, 
+  int32_t width, 
+  int32_t height
+) {
+  GroupKey key = MakeKey(texture, width, height);
+
+  auto it = groups.find(key);
+  if (it != groups.end() && layout.arrays_[it->second].layers_ < kMaxLayers) {
+    return it->second;
+  }
+
+  layout.arrays_.push_back(MakeArray(texture, width, height));
+  groups[key] = layout.arrays_.size() - 1;
+  return layout.arrays_.size() - 1;
+}
+
+TextureLayout TexturePacker::Pack(const std::vector<TextureData>& textures, int32_t atlas_size, int32_t small_size) {
+  TextureLayout layout;
+  layout.placements_.resize(textures.size());
+
+  std::map<GroupKey, int32_t> groups;
+  std::vector<size_t> atlased;
+
+  for (size_t i = 0; i < textures.size(); ++i) {
+    const TextureData& texture = textures[i];
+    if (texture.width_ <= 0 || texture.height_ <= 0) {
+      continue;
+    }
+
+    bool small = texture.width_ <= small_size && texture.height_ <= small_size;
+    bool clamped = texture.wrap_s_ == kClampToEdge && texture.wrap_t_ == kClampToEdge;
+    if (small && clamped) {
+      atlased.push_back(i);
+      continue;
+    }
+
+    TexturePlacement& placement = layout.placements_[i];
+    placement.array_ = FindArray(layout, groups, texture, texture.width_, texture.height_);
+    placement.layer_ = layout.arrays_[placement.array_].layers_++;
+  }
+
+  // Shelf packing, tallest first so each shelf wastes as little as possible
+  std::sort(atlased.begin(), atlased.end(), [&textures](size_t a, size_t b) {
+    return textures[a].height_ > textures[b].height_;
+  });
+
+  struct Page {
+    int32_t array_;
+    int32_t layer_;
+    int32_t shelf_y_;
+    int32_t shelf_height_;
+    int32_t cursor_x_;
+  };
+  std::map<GroupKey, Page> pages;
+
+  for (size_t index : atlased) {
+    const TextureData& texture = textures[index];
+    int32_t width = texture.width_ + kAtlasPadding * 2;
+    int32_t height = texture.height_ + kAtlasPadding * 2;
+
+    GroupKey key = MakeKey(texture, atlas_size, atlas_size);
+
+    auto it = pages.find(key);
+    if (it != pages.end()) {
+      Page& page = it->second;
+      if (page.cursor_x_ + width > atlas_size) {
+        page.shelf_y_ += page.shelf_height_;
+        page.shelf_height_ = 0;
+        page.cursor_x_ = 0;
+      }
+      if (page.shelf_y_ + height > atlas_size) {
+        pages.erase(it);
+        it = pages.end();
+      }
+    }
+
+    if (it == pages.end()) {
+      Page page;
+      page.array_ = FindArray(layout, groups, texture, atlas_size, atlas_size);
+      page.layer_ = layout.arrays_[page.array_].layers_++;
+      page.shelf_y_ = 0;
+      page.shelf_height_ = 0;
+      page.cursor_x_ = 0;
+      it = pages.emplace(key, page).first;
+    }
+
+    Page& page = it->second;
+
+    TexturePlacement& placement = layout.placements_[index];
+    placement.array_ = page.array_;
+    placement.layer_ = page.layer_;
+    placement.x_ = page.cursor_x_ + kAtlasPadding;
+    placement.y_ = page.shelf_y_ + kAtlasPadding;
+    placement.padding_ = kAtlasPadding;
+    placement.uv_rect_ = glm::vec4(
+      float(texture.width_) / atlas_size,
+      float(texture.height_) / atlas_size,
+      float(placement.x_) / atlas_size,
+      float(placement.y_) / atlas_size
+    );
+
+    page.cursor_x_ += width;
+    page.shelf_height_ = std::max(page.shelf_height_, height);
+  }
+
+  return layout;
+}
@@ -0,0 +1,62 @@
+#ifndef TEXTURE_PACKER_H_
+#define TEXTURE_PACKER_H_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "AssetDecoder.h"
+
+// One GL_TEXTURE_2D_ARRAY worth of layers that share size, format and
+// sampling state
+struct TextureArrayDesc {
+  int32_t width_;
+  int32_t height_;
+  int32_t component_;
+  int32_t layers_;
+
+  int32_t wrap_s_;
+  int32_t wrap_t_;
+  int32_t min_filter_;
+  int32_t mag_filter_;
+};
+
+struct TexturePlacement {
+  // Index into TextureLayout::arrays_, -1 if the texture couldn't be placed
+  int32_t array_ = -1;
+  int32_t layer_ = 0;
+
+  // Pixel offset inside the layer, non zero only for atlased textures
+  int32_t x_ = 0;
+  int32_t y_ = 0;
+  // Texels around the texture that repeat its edge, so filtering and the
+  // first mips don't pick up neighbours. Atlased textures only.
+  int32_t padding_ = 0;
+
+  // UV scale in xy and offset in zw that map the texture's 0-1 range into
+  // its rectangle of the layer
+  glm::vec4 uv_rect_ = glm::vec4(1.0, 1.0, 0.0, 0.0);
+};
+
+struct TextureLayout {
+  std::vector<TextureArrayDesc> arrays_;
+  // Parallel to ModelData::textures_
+  std::vector<TexturePlacement> placements_;
+};
+
+class TexturePacker {
+public:
+  // Textures no larger than small_size on either axis that clamp on both
+  // axes are shelf packed into atlas_size pages. Everything else gets a full
+  // layer in an array of identically sized textures. That includes every
+  // texture without a sampler, glTF's default is GL_REPEAT, which can't be
+  // honoured inside an atlas rectangle.
+  static TextureLayout Pack(
+    const std::vector<TextureData>& textures, 
+    int32_t atlas_size = 1024, 
+    int32_t small_size = 256
+  );
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the latest value from one producer thread to one
+// consumer thread. The producer always has a buffer to write into and the
+// consumer always has a complete one to read, so neither side ever waits.
+template <typename T>
+class TripleBuffer {
+public:
+  TripleBuffer() : middle_(1), write_(0), read_(2) {}
+
+  // Producer side
+  T& GetWriteBuffer() {
+    return buffers_[write_];
+  }
+
+  void Publish() {
+    uint8_t previous = middle_.exchange(write_ | kFresh, std::memory_order_acq_rel);
+    write_ = previous & kIndexMask;
+  }
+
+  // Consumer side, returns true when a newer value was picked up
+  bool Update() {
+    if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) {
+      return false;
+    }
+    uint8_t previous = middle_.exchange(read_, std::memory_order_acq_rel);
+    read_ = previous & kIndexMask;
+    return true;
+  }
+
+  const T& GetReadBuffer() const {
+    return buffers_[read_];
+  }
+private:
+  constexpr static uint8_t kFresh = 0x4;
+  constexpr static uint8_t kIndexMask = 0x3;
+
+  T buffers_[3];
+  std::atomic<uint8_t> middle_;
+  uint8_t write_;
+  uint8_t read_;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "UniformRing.h"
+
+#include "GLExtensions.h"
+
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+static size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void UniformRing::Create(size_t frame_size, uint32_t frames_in_flight) {
+  GLint alignment = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  alignment_ = alignment;
+
+  frame_size_ = AlignUp(frame_size, alignment_);
+  fences_.assign(frames_in_flight, nullptr);
+  frame_ = 0;
+  head_ = 0;
+
+  size_t total_size = frame_size_ * frames_in_flight;
+
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+
+  persistent_ = GLEXT_ARB_buffer_storage != 0;
+  if (persistent_) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_UNIFORM_BUFFER, total_size, nullptr, flags);
+    mapped_ = static_cast<uint8_t*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, total_size, flags));
+  } else {
+    glBufferData(GL_UNIFORM_BUFFER, total_size, nullptr, GL_STREAM_DRAW);
+  }
+
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformRing::Destroy() {
+  for (GLsync& fence : fences_) {
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+
+  if (persistent_) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+  mapped_ = nullptr;
+  region_ = nullptr;
+
+  glDeleteBuffers(1, &buffer_);
+}
+
+void UniformRing::BeginFrame() {
+  GLsync& fence = fences_[frame_];
+  if (fence != nullptr) {
+    // Almost always signaled already, the region was last used
+    // frames_in_flight frames ago
+    while (true) {
+      GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+      if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+        break;
+      }
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  base_ = frame_ * frame_size_;
+  head_ = base_;
+
+  if (persistent_) {
+    region_ = mapped_ + base_;
+  } else {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    region_ = static_cast<uint8_t*>(glMapBufferRange(
+      GL_UNIFORM_BUFFER, base_, frame_size_, 
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+    ));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+}
+
+size_t UniformRing::Push(const void* data, size_t size, size_t reserve) {
+  size_t offset = head_;
+  size_t span = std::max(size, reserve);
+  assert(offset + span <= base_ + frame_size_ && "Uniform ring frame overflow");
+
+  std::memcpy(region_ + (offset - base_), data, size);
+  head_ = AlignUp(offset + span, alignment_);
+
+  return offset;
+}
+
+size_t UniformRing::Reserve(size_t size, size_t count) {
+  size_t offset = head_;
+  size_t span = GetStride(size) * count;
+  assert(offset + span <= base_ + frame_size_ && "Uniform ring frame overflow");
+
+  head_ = offset + span;
+  return offset;
+}
+
+size_t UniformRing::GetStride(size_t size) const {
+  return AlignUp(size, alignment_);
+}
+
+void UniformRing::Write(size_t offset, const void* data, size_t size) {
+  assert(offset >= base_ && offset + size <= head_ && "Writing outside what was reserved");
+  std::memcpy(region_ + (offset - base_), data, size);
+}
+
+void UniformRing::Flush() {
+  if (persistent_) {
+    return;
+  }
+
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  glUnmapBuffer(GL_UNIFORM_BUFFER);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  region_ = nullptr;
+}
+
+void UniformRing::Bind(uint32_t binding, size_t offset, size_t size) const {
+  glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer_, offset, size);
+}
+
+void UniformRing::EndFrame() {
+  fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame_ = (frame_ + 1) % fences_.size();
+}
+
+bool UniformRing::IsPersistent() const {
+  return persistent_;
+}
+
+uint32_t UniformRing::GetBuffer() const {
+  return buffer_;
+}
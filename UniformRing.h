@@ -0,0 +1,67 @@
+#ifndef UNIFORM_RING_H_
+#define UNIFORM_RING_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Streams per-frame uniform data through one large GL_UNIFORM_BUFFER split
+// into a region per frame in flight. Each region is fenced once the frame is
+// submitted and only rewritten after the GPU has passed that fence.
+//
+// With ARB_buffer_storage the buffer stays persistently mapped and pushes
+// are plain memcpys. Otherwise the frame's region is mapped unsynchronized
+// in BeginFrame and unmapped in Flush.
+//
+// All pushes for a frame have to happen before Flush, and draws that use
+// the data after it.
+class UniformRing {
+public:
+  void Create(size_t frame_size, uint32_t frames_in_flight = 3);
+  void Destroy();
+
+  void BeginFrame();
+
+  // Copies size bytes into the current frame's region and returns their
+  // offset in the buffer, aligned for glBindBufferRange. reserve keeps
+  // room for a block that is bound at its full size but only partly filled.
+  size_t Push(const void* data, size_t size, size_t reserve = 0);
+
+  template <typename T>
+  size_t Push(const T& value) {
+    return Push(&value, sizeof(T));
+  }
+
+  // Room for count blocks of size bytes, block i at the returned offset
+  // plus i * GetStride(size). Write fills them in from any thread, as long
+  // as each block has one writer, until Flush.
+  size_t Reserve(size_t size, size_t count);
+  size_t GetStride(size_t size) const;
+  void Write(size_t offset, const void* data, size_t size);
+
+  void Flush();
+
+  void Bind(uint32_t binding, size_t offset, size_t size) const;
+
+  void EndFrame();
+
+  bool IsPersistent() const;
+  uint32_t GetBuffer() const;
+private:
+  uint32_t buffer_ = 0;
+  uint8_t* mapped_ = nullptr;
+  bool persistent_ = false;
+
+  // Current frame's region, mapped_ + base_ when persistent
+  uint8_t* region_ = nullptr;
+
+  size_t frame_size_ = 0;
+  size_t alignment_ = 0;
+  size_t base_ = 0;
+  size_t head_ = 0;
+
+  uint32_t frame_ = 0;
+  std::vector<struct __GLsync*> fences_;
+};
+
+#endif
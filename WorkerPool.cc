@@ -0,0 +1,93 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cassert>
+
+WorkerPool::~WorkerPool() {
+  Destroy();
+}
+
+void WorkerPool::Create(uint32_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  quit_ = false;
+  for (uint32_t part = 1; part < thread_count; ++part) {
+    workers_.emplace_back(&WorkerPool::Work, this, part);
+  }
+}
+
+void WorkerPool::Destroy() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  start_.notify_all();
+
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+uint32_t WorkerPool::GetThreadCount() const {
+  return workers_.size() + 1;
+}
+
+void WorkerPool::Dispatch(uint32_t part_count, PartFunction function, void* context) {
+  assert(part_count <= GetThreadCount() && "More parts than threads");
+
+  if (part_count <= 1) {
+    if (part_count == 1) {
+      function(context, 0);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(active_ == 0 && "Run is not reentrant");
+    job_function_ = function;
+    job_context_ = context;
+    job_parts_ = part_count;
+    active_ = part_count - 1;
+    ++generation_;
+  }
+  start_.notify_all();
+
+  function(context, 0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return active_ == 0; });
+}
+
+void WorkerPool::Work(uint32_t part) {
+  uint64_t seen = 0;
+  while (true) {
+    PartFunction function = nullptr;
+    void* context = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] { return quit_ || generation_ != seen; });
+      if (quit_) {
+        return;
+      }
+      seen = generation_;
+      // Runs with fewer parts leave the last workers out
+      if (part >= job_parts_) {
+        continue;
+      }
+      function = job_function_;
+      context = job_context_;
+    }
+
+    function(context, part);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --active_;
+    }
+    done_.notify_one();
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <cstdint>
+
+// Threads shared by everything that splits a frame's work across cores:
+// the parallel World queries, command recording and occlusion
+// rasterization. One pool for all of them keeps the thread count at the
+// core count, and only one job runs at a time.
+//
+// Run calls f(part) once for each part in [0, part_count) and returns when
+// every call is done. Part 0 runs on the calling thread, the others on one
+// worker each.
+class WorkerPool {
+public:
+  WorkerPool() = default;
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // thread_count includes the calling thread, 0 for one per hardware thread
+  void Create(uint32_t thread_count = 0);
+  void Destroy();
+
+  // Most parts a Run can have, the workers plus the calling thread
+  uint32_t GetThreadCount() const;
+
+  // Not reentrant, f must not Run on the same pool
+  template <typename F>
+  void Run(uint32_t part_count, F&& f) {
+    using Function = std::remove_reference_t<F>;
+    Dispatch(part_count, [](void* context, uint32_t part) {
+      (*static_cast<Function*>(context))(part);
+    }, (void*)&f);
+  }
+private:
+  using PartFunction = void (*)(void* context, uint32_t part);
+
+  void Dispatch(uint32_t part_count, PartFunction function, void* context);
+  void Work(uint32_t part);
+private:
+  // Current Run
+  PartFunction job_function_ = nullptr;
+  void* job_context_ = nullptr;
+  uint32_t job_parts_ = 0;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  uint64_t generation_ = 0;
+  uint32_t active_ = 0;
+  bool quit_ = false;
+};
+
+#endif
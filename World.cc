@@ -0,0 +1,289 @@
+#include "World.h"
+
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <cassert>
+
+static struct {
+  std::array<size_t, kMaxComponents> sizes_;
+  std::array<size_t, kMaxComponents> alignments_;
+  std::atomic<uint32_t> count_ { 0 };
+} Registry;
+
+ComponentId ComponentRegistry::Register(size_t size, size_t alignment) {
+  ComponentId id = Registry.count_++;
+  assert(id < kMaxComponents && "Too many component types");
+  Registry.sizes_[id] = size;
+  Registry.alignments_[id] = alignment;
+  return id;
+}
+
+size_t ComponentRegistry::GetSize(ComponentId id) {
+  return Registry.sizes_[id];
+}
+
+size_t ComponentRegistry::GetAlignment(ComponentId id) {
+  return Registry.alignments_[id];
+}
+
+static size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Lays out capacity rows: the entity array first, then every component
+// array on its own cache line. Returns the bytes used.
+static size_t Layout(ComponentMask mask, uint32_t capacity, std::array<uint32_t, kMaxComponents>& offsets) {
+  size_t offset = capacity * sizeof(Entity);
+  for (ComponentId id = 0; id < kMaxComponents; ++id) {
+    if ((mask & (ComponentMask(1) << id)) == 0) {
+      continue;
+    }
+    offset = AlignUp(offset, std::max(Archetype::kCacheLine, ComponentRegistry::GetAlignment(id)));
+    offsets[id] = offset;
+    offset += capacity * ComponentRegistry::GetSize(id);
+  }
+  return offset;
+}
+
+Archetype::Archetype(ComponentMask mask) : mask_(mask), capacity_(0), count_(0), offsets_{} {
+  size_t row_size = sizeof(Entity);
+  for (ComponentId id = 0; id < kMaxComponents; ++id) {
+    if (mask & (ComponentMask(1) << id)) {
+      row_size += ComponentRegistry::GetSize(id);
+    }
+  }
+
+  // Padding between the arrays can cost a few rows off the ideal
+  capacity_ = kChunkSize / row_size;
+  while (capacity_ > 1 && Layout(mask_, capacity_, offsets_) > kChunkSize) {
+    --capacity_;
+  }
+  size_t used = Layout(mask_, capacity_, offsets_);
+  assert(used <= kChunkSize && "Components don't fit in a chunk");
+  (void)used;
+}
+
+Archetype::~Archetype() {
+  for (uint8_t* chunk : chunks_) {
+    operator delete(chunk, std::align_val_t(kCacheLine));
+  }
+}
+
+ComponentMask Archetype::GetMask() const {
+  return mask_;
+}
+
+uint32_t Archetype::GetCount() const {
+  return count_;
+}
+
+uint32_t Archetype::GetChunkCapacity() const {
+  return capacity_;
+}
+
+uint32_t Archetype::GetChunkCount() const {
+  return (count_ + capacity_ - 1) / capacity_;
+}
+
+uint32_t Archetype::GetChunkRows(uint32_t chunk) const {
+  return std::min(capacity_, count_ - chunk * capacity_);
+}
+
+Entity* Archetype::GetEntities(uint32_t chunk) {
+  return reinterpret_cast<Entity*>(chunks_[chunk]);
+}
+
+void* Archetype::GetArray(uint32_t chunk, ComponentId id) {
+  assert((mask_ & (ComponentMask(1) << id)) && "Archetype doesn't have the component");
+  return chunks_[chunk] + offsets_[id];
+}
+
+void* Archetype::GetComponent(uint32_t row, ComponentId id) {
+  size_t size = ComponentRegistry::GetSize(id);
+  return static_cast<uint8_t*>(GetArray(row / capacity_, id)) + (row % capacity_) * size;
+}
+
+uint32_t Archetype::AddRow(Entity entity) {
+  if (count_ == chunks_.size() * capacity_) {
+    chunks_.push_back(static_cast<uint8_t*>(operator new(kChunkSize, std::align_val_t(kCacheLine))));
+  }
+
+  uint32_t row = count_++;
+  GetEntities(row / capacity_)[row % capacity_] = entity;
+  return row;
+}
+
+Entity Archetype::RemoveRow(uint32_t row) {
+  uint32_t last = --count_;
+  if (row == last) {
+    return Entity {};
+  }
+
+  Entity moved = GetEntities(last / capacity_)[last % capacity_];
+  GetEntities(row / capacity_)[row % capacity_] = moved;
+  for (ComponentId id = 0; id < kMaxComponents; ++id) {
+    if (mask_ & (ComponentMask(1) << id)) {
+      std::memcpy(GetComponent(row, id), GetComponent(last, id), ComponentRegistry::GetSize(id));
+    }
+  }
+  return moved;
+}
+
+void World::Create(WorkerPool* pool) {
+  pool_ = pool;
+}
+
+void World::Destroy() {
+  pool_ = nullptr;
+}
+
+void World::DestroyEntity(Entity entity) {
+  assert(IsAlive(entity) && "Destroying a stale entity");
+
+  Record& record = records_[entity.GetIndex()];
+  Entity moved = record.archetype_->RemoveRow(record.row_);
+  if (!moved.IsNull()) {
+    records_[moved.GetIndex()].row_ = record.row_;
+  }
+  record.archetype_ = nullptr;
+
+  uint32_t slot = entity.GetIndex();
+  // Wrap to 1, a generation of 0 is reserved for null entities
+  generations_[slot] = generations_[slot] == Entity::kMaxGeneration ? 1 : generations_[slot] + 1;
+  free_slots_.push_back(slot);
+  --entity_count_;
+}
+
+bool World::IsAlive(Entity entity) const {
+  uint32_t slot = entity.GetIndex();
+  return !entity.IsNull() && slot < generations_.size() && generations_[slot] == entity.GetGeneration();
+}
+
+size_t World::GetEntityCount() const {
+  return entity_count_;
+}
+
+size_t World::GetArchetypeCount() const {
+  return archetypes_.size();
+}
+
+Archetype* World::GetArchetype(ComponentMask mask) {
+  auto it = archetype_lookup_.find(mask);
+  if (it != archetype_lookup_.end()) {
+    return it->second;
+  }
+
+  archetypes_.push_back(std::make_unique<Archetype>(mask));
+  archetype_lookup_[mask] = archetypes_.back().get();
+  return archetypes_.back().get();
+}
+
+Entity World::AllocateEntity(Archetype* archetype) {
+  uint32_t slot = 0;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    slot = static_cast<uint32_t>(generations_.size());
+    assert(slot <= Entity::kIndexMask && "World is full");
+    generations_.push_back(1);
+    records_.emplace_back();
+  }
+
+  Entity entity = Entity::Make(slot, generations_[slot]);
+  records_[slot] = Record { archetype, archetype->AddRow(entity) };
+  ++entity_count_;
+  return entity;
+}
+
+// Components both archetypes share are copied over, the rest are dropped
+// or left uninitialized for the caller
+void World::MoveEntity(Entity entity, Archetype* to) {
+  Record& record = records_[entity.GetIndex()];
+  Archetype* from = record.archetype_;
+
+  uint32_t row = to->AddRow(entity);
+  ComponentMask shared = from->GetMask() & to->GetMask();
+  for (ComponentId id = 0; id < kMaxComponents; ++id) {
+    if (shared & (ComponentMask(1) << id)) {
+      std::memcpy(to->GetComponent(row, id), from->GetComponent(record.row_, id), ComponentRegistry::GetSize(id));
+    }
+  }
+
+  Entity moved = from->RemoveRow(record.row_);
+  if (!moved.IsNull()) {
+    records_[moved.GetIndex()].row_ = record.row_;
+  }
+  record = Record { to, row };
+}
+
+void* World::AddComponent(Entity entity, ComponentId id) {
+  assert(IsAlive(entity) && "Adding a component to a stale entity");
+
+  Record& record = records_[entity.GetIndex()];
+  ComponentMask mask = record.archetype_->GetMask() | (ComponentMask(1) << id);
+  if (mask != record.archetype_->GetMask()) {
+    MoveEntity(entity, GetArchetype(mask));
+  }
+  return record.archetype_->GetComponent(record.row_, id);
+}
+
+void World::RemoveComponent(Entity entity, ComponentId id) {
+  assert(IsAlive(entity) && "Removing a component from a stale entity");
+
+  Record& record = records_[entity.GetIndex()];
+  ComponentMask mask = record.archetype_->GetMask() & ~(ComponentMask(1) << id);
+  if (mask != record.archetype_->GetMask()) {
+    MoveEntity(entity, GetArchetype(mask));
+  }
+}
+
+void* World::GetComponent(Entity entity, ComponentId id) {
+  if (!IsAlive(entity)) {
+    return nullptr;
+  }
+
+  const Record& record = records_[entity.GetIndex()];
+  if ((record.archetype_->GetMask() & (ComponentMask(1) << id)) == 0) {
+    return nullptr;
+  }
+  return record.archetype_->GetComponent(record.row_, id);
+}
+
+void World::CollectChunks(ComponentMask mask) {
+  job_chunks_.clear();
+  for (const std::unique_ptr<Archetype>& archetype : archetypes_) {
+    if ((archetype->GetMask() & mask) != mask) {
+      continue;
+    }
+    for (uint32_t chunk = 0; chunk < archetype->GetChunkCount(); ++chunk) {
+      job_chunks_.push_back(ChunkRef { archetype.get(), chunk });
+    }
+  }
+}
+
+void World::RunChunks(ChunkFunction function, void* context) {
+  job_function_ = function;
+  job_context_ = context;
+  next_chunk_ = 0;
+
+  // Not worth waking anyone for a single chunk
+  if (pool_ == nullptr || job_chunks_.size() < 2) {
+    ProcessChunks();
+    return;
+  }
+
+  // Parts take chunks until none are left, more parts than chunks would idle
+  uint32_t parts = std::min<size_t>(pool_->GetThreadCount(), job_chunks_.size());
+  pool_->Run(parts, [this](uint32_t) {
+    ProcessChunks();
+  });
+}
+
+void World::ProcessChunks() {
+  uint32_t chunk_count = job_chunks_.size();
+  for (uint32_t i = next_chunk_++; i < chunk_count; i = next_chunk_++) {
+    job_function_(job_context_, *job_chunks_[i].archetype_, job_chunks_[i].chunk_);
+  }
+}
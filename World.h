@@ -0,0 +1,227 @@
+#ifndef WORLD_H_
+#define WORLD_H_
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <atomic>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+
+#include "ResourcePool.h"
+#include "WorkerPool.h"
+
+struct EntityTag;
+using Entity = Handle<EntityTag>;
+
+using ComponentId = uint32_t;
+using ComponentMask = uint64_t;
+
+constexpr size_t kMaxComponents = 64;
+
+// Ids are handed out the first time each type is used, so they are only
+// stable within one run
+class ComponentRegistry {
+public:
+  template <typename T>
+  static ComponentId GetId() {
+    static_assert(std::is_trivially_copyable_v<T>, "Components are moved between chunks with memcpy");
+    static const ComponentId id = Register(sizeof(T), alignof(T));
+    return id;
+  }
+
+  static size_t GetSize(ComponentId id);
+  static size_t GetAlignment(ComponentId id);
+private:
+  static ComponentId Register(size_t size, size_t alignment);
+};
+
+template <typename... Ts>
+ComponentMask MaskOf() {
+  return (ComponentMask(0) | ... | (ComponentMask(1) << ComponentRegistry::GetId<Ts>()));
+}
+
+// Every entity with exactly the same set of components. Rows are packed
+// into fixed-size chunks with each component in its own cache line aligned
+// array, so a query only streams the arrays it asked for. Rows stay dense;
+// removal moves the last row into the hole.
+class Archetype {
+public:
+  constexpr static size_t kChunkSize = 16 * 1024;
+  constexpr static size_t kCacheLine = 64;
+
+  explicit Archetype(ComponentMask mask);
+  ~Archetype();
+
+  Archetype(const Archetype&) = delete;
+  Archetype& operator=(const Archetype&) = delete;
+
+  ComponentMask GetMask() const;
+  uint32_t GetCount() const;
+  uint32_t GetChunkCapacity() const;
+  // Chunks with at least one row
+  uint32_t GetChunkCount() const;
+  uint32_t GetChunkRows(uint32_t chunk) const;
+
+  Entity* GetEntities(uint32_t chunk);
+  void* GetArray(uint32_t chunk, ComponentId id);
+  void* GetComponent(uint32_t row, ComponentId id);
+
+  template <typename T>
+  T* GetArray(uint32_t chunk) {
+    return static_cast<T*>(GetArray(chunk, ComponentRegistry::GetId<T>()));
+  }
+
+  // The new row's components are left uninitialized
+  uint32_t AddRow(Entity entity);
+  // Returns the entity that was moved into row, null if row was the last
+  Entity RemoveRow(uint32_t row);
+private:
+  ComponentMask mask_;
+  uint32_t capacity_;
+  uint32_t count_;
+
+  // Byte offset of each component's array within a chunk
+  std::array<uint32_t, kMaxComponents> offsets_;
+
+  // Kept after they empty out, so churn doesn't hit the heap
+  std::vector<uint8_t*> chunks_;
+};
+
+// Entity and component storage. Components have to be trivially copyable.
+//
+// Pointers from Get and the arrays handed to queries are only good until
+// the next CreateEntity, DestroyEntity, Add or Remove.
+class World {
+public:
+  World() = default;
+
+  World(const World&) = delete;
+  World& operator=(const World&) = delete;
+
+  // Parallel queries run on pool, the calling thread always takes part.
+  // Without a pool they run on the calling thread alone.
+  void Create(WorkerPool* pool = nullptr);
+  void Destroy();
+
+  template <typename... Ts>
+  Entity CreateEntity(const Ts&... components) {
+    Archetype* archetype = GetArchetype(MaskOf<Ts...>());
+    Entity entity = AllocateEntity(archetype);
+    uint32_t row = records_[entity.GetIndex()].row_;
+    ((*static_cast<Ts*>(archetype->GetComponent(row, ComponentRegistry::GetId<Ts>())) = components), ...);
+    return entity;
+  }
+
+  void DestroyEntity(Entity entity);
+  bool IsAlive(Entity entity) const;
+
+  // Replaces the component if the entity already has one
+  template <typename T>
+  void Add(Entity entity, const T& component) {
+    *static_cast<T*>(AddComponent(entity, ComponentRegistry::GetId<T>())) = component;
+  }
+
+  template <typename T>
+  void Remove(Entity entity) {
+    RemoveComponent(entity, ComponentRegistry::GetId<T>());
+  }
+
+  // nullptr when the entity is stale or doesn't have T
+  template <typename T>
+  T* Get(Entity entity) {
+    return static_cast<T*>(GetComponent(entity, ComponentRegistry::GetId<T>()));
+  }
+
+  // f(count, entities, arrays...) once per chunk holding all of Ts
+  template <typename... Ts, typename F>
+  void EachChunk(F&& f) {
+    ComponentMask mask = MaskOf<Ts...>();
+    for (const std::unique_ptr<Archetype>& archetype : archetypes_) {
+      if ((archetype->GetMask() & mask) != mask) {
+        continue;
+      }
+      for (uint32_t chunk = 0; chunk < archetype->GetChunkCount(); ++chunk) {
+        f(archetype->GetChunkRows(chunk), archetype->GetEntities(chunk), archetype->template GetArray<Ts>(chunk)...);
+      }
+    }
+  }
+
+  // f(components...) for every entity holding all of Ts
+  template <typename... Ts, typename F>
+  void Each(F&& f) {
+    EachChunk<Ts...>([&](uint32_t count, const Entity*, Ts*... arrays) {
+      for (uint32_t i = 0; i < count; ++i) {
+        f(arrays[i]...);
+      }
+    });
+  }
+
+  // EachChunk with the chunks spread over the workers. f runs concurrently
+  // on different chunks and must not change the world's structure.
+  template <typename... Ts, typename F>
+  void ParallelEachChunk(F&& f) {
+    using Function = std::remove_reference_t<F>;
+    CollectChunks(MaskOf<Ts...>());
+    RunChunks([](void* context, Archetype& archetype, uint32_t chunk) {
+      (*static_cast<Function*>(context))(
+        archetype.GetChunkRows(chunk), archetype.GetEntities(chunk), archetype.template GetArray<Ts>(chunk)...);
+    }, (void*)&f);
+  }
+
+  template <typename... Ts, typename F>
+  void ParallelEach(F&& f) {
+    ParallelEachChunk<Ts...>([&](uint32_t count, const Entity*, Ts*... arrays) {
+      for (uint32_t i = 0; i < count; ++i) {
+        f(arrays[i]...);
+      }
+    });
+  }
+
+  size_t GetEntityCount() const;
+  size_t GetArchetypeCount() const;
+private:
+  struct Record {
+    Archetype* archetype_;
+    uint32_t row_;
+  };
+
+  struct ChunkRef {
+    Archetype* archetype_;
+    uint32_t chunk_;
+  };
+
+  using ChunkFunction = void (*)(void* context, Archetype& archetype, uint32_t chunk);
+
+  Archetype* GetArchetype(ComponentMask mask);
+  Entity AllocateEntity(Archetype* archetype);
+  void MoveEntity(Entity entity, Archetype* to);
+
+  void* AddComponent(Entity entity, ComponentId id);
+  void RemoveComponent(Entity entity, ComponentId id);
+  void* GetComponent(Entity entity, ComponentId id);
+
+  void CollectChunks(ComponentMask mask);
+  void RunChunks(ChunkFunction function, void* context);
+  void ProcessChunks();
+private:
+  std::vector<Record> records_;
+  std::vector<uint16_t> generations_;
+  std::vector<uint32_t> free_slots_;
+  size_t entity_count_ = 0;
+
+  std::vector<std::unique_ptr<Archetype>> archetypes_;
+  std::unordered_map<ComponentMask, Archetype*> archetype_lookup_;
+
+  // Current parallel query
+  std::vector<ChunkRef> job_chunks_;
+  ChunkFunction job_function_ = nullptr;
+  void* job_context_ = nullptr;
+  std::atomic<uint32_t> next_chunk_ { 0 };
+
+  WorkerPool* pool_ = nullptr;
+};
+
+#endif
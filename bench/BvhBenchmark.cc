@@ -0,0 +1,310 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <numeric>
+
+#include "AssetDecoder.h"
+#include "Bvh.h"
+
+// Build time and ray throughput of the BVHs on one model's geometry,
+// merged into a single mesh in model space. Rays are a coherent pinhole
+// camera over the model and incoherent rays between random points around
+// it. Pass a GLB path to replace the robot, --csv for one line per case.
+// Empty and non-indexed geometry is checked first, exits nonzero if either
+// answers wrong.
+
+constexpr int32_t kBuildIterations = 20;
+constexpr int32_t kRayIterations = 5;
+constexpr int32_t kImageSide = 512;
+constexpr int32_t kInstanceGridSide = 16;
+
+using Clock = std::chrono::steady_clock;
+
+struct Geometry {
+  std::vector<glm::vec3> positions_;
+  std::vector<uint32_t> indices_;
+};
+
+static uint32_t ReadIndex(const uint8_t* indices, uint32_t index_type, size_t i) {
+  if (index_type == GL_UNSIGNED_BYTE) {
+    return indices[i];
+  } else if (index_type == GL_UNSIGNED_SHORT) {
+    uint16_t index;
+    std::memcpy(&index, indices + i * sizeof(uint16_t), sizeof(uint16_t));
+    return index;
+  }
+  uint32_t index;
+  std::memcpy(&index, indices + i * sizeof(uint32_t), sizeof(uint32_t));
+  return index;
+}
+
+static Geometry Merge(const ModelData& data) {
+  Geometry geometry;
+  for (const MeshData& mesh : data.meshes_) {
+    for (const PrimitiveData& primitive : mesh.primitives_) {
+      uint32_t base = geometry.positions_.size();
+      for (const Vertex& vertex : primitive.vertices_) {
+        geometry.positions_.push_back(glm::vec3(mesh.local_transform_ * glm::vec4(vertex.pos_, 1.0f)));
+      }
+      if (primitive.index_count_ == 0) {
+        for (size_t i = 0; i < primitive.vertices_.size(); ++i) {
+          geometry.indices_.push_back(base + i);
+        }
+      }
+      for (size_t i = 0; i < primitive.index_count_; ++i) {
+        geometry.indices_.push_back(base + ReadIndex(primitive.indices_.data(), primitive.index_type_, i));
+      }
+    }
+  }
+  return geometry;
+}
+
+// Looks at box from -z, covering it with kImageSide * kImageSide rays
+static std::vector<Ray> CameraRays(const Aabb& box) {
+  glm::vec3 center = (box.min_ + box.max_) * 0.5f;
+  glm::vec3 extent = box.max_ - box.min_;
+  float size = std::max(extent.x, extent.y) * 0.6f;
+  glm::vec3 eye = center - glm::vec3(0.0f, 0.0f, extent.z + size * 2.0f);
+
+  std::vector<Ray> rays;
+  rays.reserve(kImageSide * kImageSide);
+  for (int32_t y = 0; y < kImageSide; ++y) {
+    for (int32_t x = 0; x < kImageSide; ++x) {
+      glm::vec3 target = center + glm::vec3(
+        (float(x) / kImageSide * 2.0f - 1.0f) * size,
+        (float(y) / kImageSide * 2.0f - 1.0f) * size,
+        0.0f);
+      rays.push_back(Ray { eye, glm::normalize(target - eye) });
+    }
+  }
+  return rays;
+}
+
+// From just outside box to random points inside it
+static std::vector<Ray> RandomRays(const Aabb& box, size_t count) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  glm::vec3 center = (box.min_ + box.max_) * 0.5f;
+  float radius = glm::length(box.max_ - box.min_);
+
+  std::vector<Ray> rays;
+  rays.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec3 target = box.min_ + (box.max_ - box.min_) * glm::vec3(unit(rng), unit(rng), unit(rng));
+    glm::vec3 offset = glm::normalize(glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f));
+    glm::vec3 origin = center + offset * radius;
+    rays.push_back(Ray { origin, glm::normalize(target - origin) });
+  }
+  return rays;
+}
+
+struct Throughput {
+  double single_mrays_;
+  double batch_mrays_;
+  size_t hits_;
+};
+
+template <typename Bvh>
+static Throughput Trace(const Bvh& bvh, const std::vector<Ray>& rays) {
+  std::vector<RayHit> hits(rays.size());
+  double single_ms = 0.0;
+  double batch_ms = 0.0;
+
+  for (int32_t i = 0; i < kRayIterations; ++i) {
+    std::fill(hits.begin(), hits.end(), RayHit {});
+    Clock::time_point start = Clock::now();
+    for (size_t r = 0; r < rays.size(); ++r) {
+      bvh.Intersect(rays[r], hits[r]);
+    }
+    single_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::fill(hits.begin(), hits.end(), RayHit {});
+    start = Clock::now();
+    bvh.IntersectBatch(rays.data(), rays.size(), hits.data());
+    batch_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  size_t hit_count = 0;
+  for (const RayHit& hit : hits) {
+    hit_count += hit.IsHit() ? 1 : 0;
+  }
+
+  double total_rays = double(rays.size()) * kRayIterations;
+  return Throughput { total_rays / single_ms / 1e3, total_rays / batch_ms / 1e3, hit_count };
+}
+
+static bool Expect(const char* name, bool hit, bool expected) {
+  if (hit != expected) {
+    std::cerr << name << ": " << (hit ? "hit" : "missed") << ", expected " << (expected ? "hit" : "miss") << std::endl;
+  }
+  return hit == expected;
+}
+
+// Every query against nothing misses instead of walking a root without
+// children, and triangles drawn without indices are hit like any others
+static bool CheckEdgeCases() {
+  Ray ray { glm::vec3(0.25f, 0.25f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+  RayHit hits[4];
+  Ray rays[4] = { ray, ray, ray, ray };
+  bool passed = true;
+
+  TriangleBvh empty;
+  empty.Build(nullptr, nullptr, 0);
+  RayHit hit;
+  passed &= Expect("empty mesh", empty.Intersect(ray, hit), false);
+  empty.IntersectBatch(rays, 4, hits);
+  passed &= Expect("empty mesh batch", hits[0].IsHit(), false);
+
+  InstanceBvh no_instances;
+  no_instances.Build(nullptr, 0);
+  passed &= Expect("no instances", no_instances.Intersect(ray, hit), false);
+  no_instances.IntersectBatch(rays, 4, hits);
+  passed &= Expect("no instances batch", hits[0].IsHit(), false);
+
+  // One triangle per vertex triple, as a non-indexed primitive is drawn
+  std::vector<glm::vec3> positions = {
+    glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+    glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(2.0f, 1.0f, 0.0f),
+  };
+  std::vector<uint32_t> indices(positions.size());
+  std::iota(indices.begin(), indices.end(), 0);
+
+  TriangleBvh soup;
+  soup.Build(positions.data(), indices.data(), indices.size() / 3);
+  hit = RayHit {};
+  passed &= Expect("non-indexed", soup.Intersect(ray, hit) && hit.triangle_ == 0, true);
+
+  BvhInstance instances[2] = { { &empty, glm::mat4(1.0f) }, { &soup, glm::mat4(1.0f) } };
+  InstanceBvh mixed;
+  mixed.Build(instances, 2);
+  hit = RayHit {};
+  passed &= Expect("empty and non-indexed instances", mixed.Intersect(ray, hit) && hit.instance_ == 1, true);
+  std::fill(hits, hits + 4, RayHit {});
+  mixed.IntersectBatch(rays, 4, hits);
+  passed &= Expect("empty and non-indexed instances batch", hits[3].IsHit() && hits[3].instance_ == 1, true);
+
+  return passed;
+}
+
+static void Report(const char* scene, const char* rays, size_t count, const Throughput& result, bool csv) {
+  if (csv) {
+    std::cout
+      << scene << "," << rays << "," << count << ","
+      << result.single_mrays_ << "," << result.batch_mrays_ << "," << result.hits_ << std::endl;
+    return;
+  }
+
+  std::cout
+    << std::setw(10) << scene
+    << std::setw(10) << rays
+    << std::setw(10) << count
+    << std::setw(12) << result.single_mrays_
+    << std::setw(12) << result.batch_mrays_
+    << std::setw(10) << result.hits_ << std::endl;
+}
+
+int main(int argc, char** argv) {
+  bool csv = false;
+  const char* model_path = "../assets/robot.glb";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else {
+      model_path = argv[i];
+    }
+  }
+
+  if (!CheckEdgeCases()) {
+    return 1;
+  }
+
+  ModelData data;
+  if (!AssetDecoder::LoadFromFile(model_path, data)) {
+    std::cerr << "Failed to load " << model_path << std::endl;
+    return 1;
+  }
+
+  Geometry geometry = Merge(data);
+  size_t triangle_count = geometry.indices_.size() / 3;
+
+  uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  if (csv) {
+    std::cout << "build,threads,triangles,ms" << std::endl;
+  } else {
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << model_path << ": " << triangle_count << " triangles" << std::endl;
+  }
+
+  TriangleBvh bvh;
+  for (uint32_t threads : { 1u, thread_count }) {
+    Clock::time_point start = Clock::now();
+    for (int32_t i = 0; i < kBuildIterations; ++i) {
+      bvh.Build(geometry.positions_.data(), geometry.indices_.data(), triangle_count, threads);
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / kBuildIterations;
+
+    if (csv) {
+      std::cout << "triangles," << threads << "," << triangle_count << "," << ms << std::endl;
+    } else {
+      std::cout << "build " << threads << " thread(s): " << ms << " ms, " << bvh.GetNodeCount() << " nodes" << std::endl;
+    }
+  }
+
+  // A grid of copies with a little rotation each, looked at from the front
+  std::vector<BvhInstance> instances;
+  Aabb bounds = bvh.GetBounds();
+  glm::vec3 spacing = (bounds.max_ - bounds.min_) * 1.5f;
+  Aabb grid_bounds = bounds;
+  for (int32_t y = 0; y < kInstanceGridSide; ++y) {
+    for (int32_t x = 0; x < kInstanceGridSide; ++x) {
+      float angle = float(x * kInstanceGridSide + y) * 0.1f;
+      glm::mat4 transform(1.0f);
+      transform[0] = glm::vec4(std::cos(angle), 0.0f, -std::sin(angle), 0.0f);
+      transform[2] = glm::vec4(std::sin(angle), 0.0f, std::cos(angle), 0.0f);
+      transform[3] = glm::vec4(float(x) * spacing.x, float(y) * spacing.y, 0.0f, 1.0f);
+      instances.push_back(BvhInstance { &bvh, transform });
+    }
+  }
+  grid_bounds.max_ += glm::vec3(spacing.x, spacing.y, 0.0f) * float(kInstanceGridSide - 1);
+
+  InstanceBvh instance_bvh;
+  Clock::time_point start = Clock::now();
+  for (int32_t i = 0; i < kBuildIterations; ++i) {
+    instance_bvh.Build(instances.data(), instances.size());
+  }
+  double instance_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / kBuildIterations;
+
+  if (csv) {
+    std::cout << "instances,1," << instances.size() << "," << instance_ms << std::endl;
+    std::cout << "scene,rays,count,single_mrays,batch_mrays,hits" << std::endl;
+  } else {
+    std::cout << "build " << instances.size() << " instances: " << instance_ms << " ms" << std::endl;
+    std::cout
+      << std::setw(10) << "scene"
+      << std::setw(10) << "rays"
+      << std::setw(10) << "count"
+      << std::setw(12) << "single Mr/s"
+      << std::setw(12) << "batch Mr/s"
+      << std::setw(10) << "hits" << std::endl;
+  }
+
+  std::vector<Ray> camera = CameraRays(bounds);
+  std::vector<Ray> random = RandomRays(bounds, camera.size());
+  Report("mesh", "camera", camera.size(), Trace(bvh, camera), csv);
+  Report("mesh", "random", random.size(), Trace(bvh, random), csv);
+
+  std::vector<Ray> grid_camera = CameraRays(grid_bounds);
+  std::vector<Ray> grid_random = RandomRays(grid_bounds, grid_camera.size());
+  Report("instances", "camera", grid_camera.size(), Trace(instance_bvh, grid_camera), csv);
+  Report("instances", "random", grid_random.size(), Trace(instance_bvh, grid_random), csv);
+
+  return 0;
+}
@@ -0,0 +1,249 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "App.h"
+#include "CommandList.h"
+#include "GLExtensions.h"
+#include "Graphics.h"
+#include "Resources.h"
+#include "UniformRing.h"
+
+// CPU time to build and submit a frame of small draws: pushing uniforms and
+// issuing GL calls from one loop the way main.cc used to, against recording
+// command lists on one thread and on every thread and replaying them.
+// Timing stops once the last draw is submitted, before the swap. Pass
+// --csv for one line per case.
+
+constexpr int32_t kWarmupFrames = 10;
+constexpr int32_t kFrames = 60;
+constexpr size_t kDrawCounts[] = { 5'000, 10'000, 25'000, 50'000 };
+constexpr size_t kMaxDraws = 50'000;
+
+enum class Mode {
+  kDirect,
+  kSerial,
+  kParallel,
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+  double build_ms_;
+  double submit_ms_;
+  size_t list_bytes_;
+};
+
+// Enough per-draw math that building a draw costs about what it does in a
+// scene, a spinning grid of triangles
+static DrawUniforms BuildDraw(size_t i, float time) {
+  float x = float(i % 250) * 0.08f - 10.0f;
+  float y = float(i / 250 % 200) * 0.06f - 6.0f;
+  float angle = time + float(i) * 0.01f;
+
+  DrawUniforms draw_uniforms;
+  draw_uniforms.model_ = glm::rotate(
+    glm::translate(glm::mat4(1.0), glm::vec3(x, y, 0.0f)), angle, glm::vec3(0.0f, 0.0f, 1.0f));
+  draw_uniforms.base_color_ = glm::vec4(std::fabs(std::sin(angle)), 0.5f, 0.5f, 1.0f);
+  draw_uniforms.uv_rect_ = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+  draw_uniforms.layer_ = -1;
+  return draw_uniforms;
+}
+
+static Result Run(
+  App& app,
+  UniformRing& uniform_ring,
+  CommandRecorder* recorder,
+  std::vector<CommandList>& lists,
+  const Shader& shader,
+  const Primitive& primitive,
+  size_t draw_count
+) {
+  std::vector<size_t> draw_offsets;
+  draw_offsets.reserve(draw_count);
+
+  double build_ms = 0.0;
+  double submit_ms = 0.0;
+  size_t list_bytes = 0;
+  int32_t measured_frames = 0;
+
+  for (int32_t frame = 0; frame < kWarmupFrames + kFrames && app.Update(); ++frame) {
+    app.BeginFrame();
+    Graphics::ClearColor(Color { 195, 195, 195, 255 });
+    uniform_ring.BeginFrame();
+
+    FrameUniforms frame_uniforms;
+    frame_uniforms.skinning_ = SkinningMode::kLinear;
+    frame_uniforms.view_projection_ =
+      glm::perspective(glm::radians(90.f), 16.f / 9.f, 0.01f, 100.f) *
+      glm::lookAt(glm::vec3(0.0, 0.0, 8.0), glm::vec3(0.0), glm::vec3(0.0, 1.0, 0.0));
+    size_t frame_offset = uniform_ring.Push(frame_uniforms);
+    float time = float(frame) * 0.016f;
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point built;
+
+    if (recorder == nullptr) {
+      draw_offsets.clear();
+      for (size_t i = 0; i < draw_count; ++i) {
+        draw_offsets.push_back(uniform_ring.Push(BuildDraw(i, time)));
+      }
+      built = Clock::now();
+
+      uniform_ring.Flush();
+      uniform_ring.Bind(kFrameUniformBinding, frame_offset, sizeof(FrameUniforms));
+      shader.Enable();
+      for (size_t i = 0; i < draw_count; ++i) {
+        uniform_ring.Bind(kDrawUniformBinding, draw_offsets[i], sizeof(DrawUniforms));
+        Graphics::RenderPrimitiveIndexed(primitive);
+      }
+      shader.Disable();
+    } else {
+      size_t base = uniform_ring.Reserve(sizeof(DrawUniforms), draw_count);
+      size_t stride = uniform_ring.GetStride(sizeof(DrawUniforms));
+      uint32_t buffer = uniform_ring.GetBuffer();
+
+      recorder->Record(draw_count, [&](uint32_t part, size_t begin, size_t end) {
+        CommandList& list = lists[part];
+        list.Reset();
+        for (size_t i = begin; i < end; ++i) {
+          DrawUniforms draw_uniforms = BuildDraw(i, time);
+          size_t offset = base + i * stride;
+          uniform_ring.Write(offset, &draw_uniforms, sizeof(DrawUniforms));
+
+          list.BindUniformRange(kDrawUniformBinding, buffer, offset, sizeof(DrawUniforms));
+          list.Draw(primitive);
+        }
+      });
+      built = Clock::now();
+
+      uniform_ring.Flush();
+      uniform_ring.Bind(kFrameUniformBinding, frame_offset, sizeof(FrameUniforms));
+      shader.Enable();
+      CommandList::Replay(lists.data(), recorder->GetPartCount());
+      shader.Disable();
+
+      list_bytes = 0;
+      for (uint32_t part = 0; part < recorder->GetPartCount(); ++part) {
+        list_bytes += lists[part].GetSize();
+      }
+    }
+
+    Clock::time_point submitted = Clock::now();
+    if (frame >= kWarmupFrames) {
+      build_ms += std::chrono::duration<double, std::milli>(built - start).count();
+      submit_ms += std::chrono::duration<double, std::milli>(submitted - built).count();
+      ++measured_frames;
+    }
+
+    uniform_ring.EndFrame();
+    app.EndFrame();
+    Resources::EndFrame();
+  }
+
+  if (measured_frames == 0) {
+    return Result { 0.0, 0.0, 0 };
+  }
+  return Result { build_ms / measured_frames, submit_ms / measured_frames, list_bytes };
+}
+
+int main(int argc, char** argv) {
+  bool csv = argc > 1 && std::strcmp(argv[1], "--csv") == 0;
+
+  App app(1280, 720, "Command List Benchmark");
+  app.SetSwapMode(SwapMode::kImmediate);
+
+  ShaderHandle shader_handle = Resources::LoadShader("../shaders/model.glsl");
+  const Shader& shader = *Resources::Get(shader_handle);
+  shader.Enable();
+  shader.SetUniformInt(shader.GetUniformLocation("texture0"), 0);
+  shader.Disable();
+  shader.SetUniformBlockBinding("FrameUniforms", kFrameUniformBinding);
+  shader.SetUniformBlockBinding("DrawUniforms", kDrawUniformBinding);
+
+  // One small triangle, so the GPU keeps up and the CPU side is what's measured
+  Vertex vertices[3] = {};
+  vertices[0].pos_ = glm::vec3(-0.02f, -0.02f, 0.0f);
+  vertices[1].pos_ = glm::vec3(0.02f, -0.02f, 0.0f);
+  vertices[2].pos_ = glm::vec3(0.0f, 0.02f, 0.0f);
+  for (Vertex& vertex : vertices) {
+    vertex.normal_ = glm::vec3(0.0f, 0.0f, 1.0f);
+  }
+  uint16_t indices[3] = { 0, 1, 2 };
+  PrimitiveHandle primitive_handle = Resources::CreatePrimitive(
+    vertices, 3, 3, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE,
+    reinterpret_cast<const uint8_t*>(indices), sizeof(indices));
+  const Primitive& primitive = *Resources::Get(primitive_handle);
+
+  // Draw blocks are aligned to at most 256 bytes
+  UniformRing uniform_ring;
+  uniform_ring.Create(kMaxDraws * 256 + (1 << 16));
+
+  WorkerPool workers;
+  workers.Create();
+
+  CommandRecorder serial_recorder;
+  serial_recorder.Create();
+  CommandRecorder parallel_recorder;
+  parallel_recorder.Create(&workers);
+  std::vector<CommandList> lists(parallel_recorder.GetPartCount());
+
+  if (csv) {
+    std::cout << "draws,mode,build_ms,submit_ms,total_ms,list_bytes" << std::endl;
+  } else {
+    std::cout
+      << kFrames << " frames per case, "
+      << parallel_recorder.GetPartCount() << " recording threads" << std::endl;
+    std::cout
+      << std::setw(8) << "draws"
+      << std::setw(10) << "mode"
+      << std::setw(12) << "build ms"
+      << std::setw(12) << "submit ms"
+      << std::setw(12) << "total ms"
+      << std::setw(12) << "list bytes" << std::endl;
+  }
+
+  for (size_t draw_count : kDrawCounts) {
+    for (Mode mode : { Mode::kDirect, Mode::kSerial, Mode::kParallel }) {
+      CommandRecorder* recorder = nullptr;
+      const char* name = "direct";
+      if (mode == Mode::kSerial) {
+        recorder = &serial_recorder;
+        name = "serial";
+      } else if (mode == Mode::kParallel) {
+        recorder = &parallel_recorder;
+        name = "parallel";
+      }
+
+      Result result = Run(app, uniform_ring, recorder, lists, shader, primitive, draw_count);
+      double total_ms = result.build_ms_ + result.submit_ms_;
+      if (csv) {
+        std::cout
+          << draw_count << "," << name << "," << result.build_ms_ << ","
+          << result.submit_ms_ << "," << total_ms << "," << result.list_bytes_ << std::endl;
+      } else {
+        std::cout
+          << std::setw(8) << draw_count
+          << std::setw(10) << name
+          << std::setw(12) << std::fixed << std::setprecision(3) << result.build_ms_
+          << std::setw(12) << result.submit_ms_
+          << std::setw(12) << total_ms
+          << std::setw(12) << result.list_bytes_ << std::endl;
+      }
+    }
+  }
+
+  parallel_recorder.Destroy();
+  serial_recorder.Destroy();
+  workers.Destroy();
+  uniform_ring.Destroy();
+  Resources::Shutdown();
+
+  return 0;
+}
@@ -0,0 +1,214 @@
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <cmath>
+#include <cstring>
+
+#include "Scene.h"
+#include "World.h"
+
+// Per-frame entity updates over a World against the same data kept as a
+// vector of structs, the way main.cc would have grown without one. Each
+// pass is the mean of kIterations runs. Pass --csv for one line per case.
+
+constexpr int32_t kIterations = 50;
+constexpr size_t kEntityCounts[] = { 10'000, 50'000, 100'000, 250'000 };
+
+// What a hand-written game object ends up as: everything inline, plus the
+// odd field no update touches
+struct GameObject {
+  std::string name_;
+  Transform transform_;
+  WorldMatrix world_;
+  Renderable renderable_;
+  SkeletonPose pose_;
+  Controller controller_;
+  bool has_pose_;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static float Sink = 0.0f;
+
+static void Move(Transform& transform, const Controller& controller, float dt) {
+  transform.position_.x -= std::sin(transform.yaw_) * controller.speed_ * dt;
+  transform.position_.z -= std::cos(transform.yaw_) * controller.speed_ * dt;
+}
+
+static void ComputeMatrix(const Transform& transform, WorldMatrix& matrix) {
+  float s = std::sin(transform.yaw_);
+  float c = std::cos(transform.yaw_);
+
+  glm::mat4& m = matrix.value_;
+  m[0] = glm::vec4(c * transform.scale_.x, 0.0f, -s * transform.scale_.x, 0.0f);
+  m[1] = glm::vec4(0.0f, transform.scale_.y, 0.0f, 0.0f);
+  m[2] = glm::vec4(s * transform.scale_.z, 0.0f, c * transform.scale_.z, 0.0f);
+  m[3] = glm::vec4(transform.position_, 1.0f);
+}
+
+template <typename F>
+static double Time(F&& f) {
+  f();
+
+  Clock::time_point start = Clock::now();
+  for (int32_t i = 0; i < kIterations; ++i) {
+    f();
+  }
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / kIterations;
+}
+
+struct Result {
+  double aos_ms_;
+  double ecs_ms_;
+  double parallel_ms_;
+};
+
+static void Report(size_t count, const char* pass, const Result& result, bool csv) {
+  if (csv) {
+    std::cout
+      << count << "," << pass << "," << result.aos_ms_ << ","
+      << result.ecs_ms_ << "," << result.parallel_ms_ << std::endl;
+    return;
+  }
+
+  std::cout
+    << std::setw(10) << count
+    << std::setw(10) << pass
+    << std::setw(12) << result.aos_ms_
+    << std::setw(12) << result.ecs_ms_
+    << std::setw(12) << result.parallel_ms_ << std::endl;
+}
+
+int main(int argc, char** argv) {
+  bool csv = argc > 1 && std::strcmp(argv[1], "--csv") == 0;
+
+  if (csv) {
+    std::cout << "entities,pass,aos_ms,ecs_ms,ecs_parallel_ms" << std::endl;
+  } else {
+    std::cout << std::fixed << std::setprecision(3)
+      << std::setw(10) << "entities"
+      << std::setw(10) << "pass"
+      << std::setw(12) << "aos ms"
+      << std::setw(12) << "ecs ms"
+      << std::setw(12) << "parallel" << std::endl;
+  }
+
+  const float dt = 1.0f / 60.0f;
+
+  WorkerPool workers;
+  workers.Create();
+
+  for (size_t count : kEntityCounts) {
+    World world;
+    world.Create(&workers);
+
+    std::vector<GameObject> objects;
+    objects.reserve(count);
+
+    // One in four has no skeleton, so the world holds two archetypes
+    for (size_t i = 0; i < count; ++i) {
+      Transform transform;
+      transform.position_ = glm::vec3(float(i % 256), 0.0f, float(i / 256));
+      transform.yaw_ = float(i) * 0.001f;
+
+      Controller controller {};
+      controller.speed_ = 1.0f + float(i % 7);
+
+      bool has_pose = i % 4 != 0;
+      objects.push_back(GameObject {
+        "entity " + std::to_string(i), transform, WorldMatrix {}, Renderable {}, SkeletonPose {}, controller, has_pose
+      });
+
+      if (has_pose) {
+        world.CreateEntity(transform, WorldMatrix {}, Renderable {}, SkeletonPose {}, controller);
+      } else {
+        world.CreateEntity(transform, WorldMatrix {}, Renderable {}, controller);
+      }
+    }
+
+    Result move;
+    move.aos_ms_ = Time([&] {
+      for (GameObject& object : objects) {
+        Move(object.transform_, object.controller_, dt);
+      }
+    });
+    move.ecs_ms_ = Time([&] {
+      world.Each<Transform, Controller>([&](Transform& transform, const Controller& controller) {
+        Move(transform, controller, dt);
+      });
+    });
+    move.parallel_ms_ = Time([&] {
+      world.ParallelEach<Transform, Controller>([&](Transform& transform, const Controller& controller) {
+        Move(transform, controller, dt);
+      });
+    });
+    Report(count, "move", move, csv);
+
+    Result matrices;
+    matrices.aos_ms_ = Time([&] {
+      for (GameObject& object : objects) {
+        ComputeMatrix(object.transform_, object.world_);
+      }
+    });
+    matrices.ecs_ms_ = Time([&] {
+      world.Each<Transform, WorldMatrix>([](const Transform& transform, WorldMatrix& matrix) {
+        ComputeMatrix(transform, matrix);
+      });
+    });
+    matrices.parallel_ms_ = Time([&] {
+      world.ParallelEach<Transform, WorldMatrix>([](const Transform& transform, WorldMatrix& matrix) {
+        ComputeMatrix(transform, matrix);
+      });
+    });
+    Report(count, "matrices", matrices, csv);
+
+    // Only skinned entities, the AoS loop has to branch on every object
+    Result skinned;
+    skinned.aos_ms_ = Time([&] {
+      float sum = 0.0f;
+      for (const GameObject& object : objects) {
+        if (object.has_pose_) {
+          sum += object.world_.value_[3].x + float(object.pose_.pose_);
+        }
+      }
+      Sink += sum;
+    });
+    skinned.ecs_ms_ = Time([&] {
+      float sum = 0.0f;
+      world.Each<WorldMatrix, SkeletonPose>([&](const WorldMatrix& matrix, const SkeletonPose& pose) {
+        sum += matrix.value_[3].x + float(pose.pose_);
+      });
+      Sink += sum;
+    });
+    skinned.parallel_ms_ = Time([&] {
+      float sum = 0.0f;
+      std::mutex mutex;
+      world.ParallelEachChunk<WorldMatrix, SkeletonPose>([&](uint32_t rows, const Entity*, const WorldMatrix* matrices, const SkeletonPose* poses) {
+        float chunk_sum = 0.0f;
+        for (uint32_t i = 0; i < rows; ++i) {
+          chunk_sum += matrices[i].value_[3].x + float(poses[i].pose_);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        sum += chunk_sum;
+      });
+      Sink += sum;
+    });
+    Report(count, "skinned", skinned, csv);
+
+    world.Destroy();
+  }
+
+  workers.Destroy();
+
+  // Keeps the reductions from being optimized out
+  if (Sink == 42.0f) {
+    std::cout << Sink << std::endl;
+  }
+
+  return 0;
+}
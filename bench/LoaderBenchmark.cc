@@ -0,0 +1,265 @@
+#include "AssetDecoder.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+
+// Measures AssetDecoder throughput on synthetic GLBs of increasing size and
+// on any GLB paths passed on the command line, the repo's test cube when
+// none are. Pass --csv for one line per case, suitable for tracking across
+// commits. Exits non zero if anything fails to load.
+
+constexpr int32_t kIterations = 5;
+
+template <typename T>
+static int32_t AppendView(tinygltf::Model& model, const std::vector<T>& values, int32_t target) {
+  tinygltf::Buffer& buffer = model.buffers[0];
+
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteOffset = buffer.data.size();
+  view.byteLength = values.size() * sizeof(T);
+  view.target = target;
+
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+  buffer.data.insert(buffer.data.end(), bytes, bytes + view.byteLength);
+  while (buffer.data.size() % 4 != 0) {
+    buffer.data.push_back(0);
+  }
+
+  model.bufferViews.push_back(view);
+  return model.bufferViews.size() - 1;
+}
+
+static int32_t AppendAccessor(tinygltf::Model& model, int32_t view, int32_t component_type, int32_t type, size_t count) {
+  tinygltf::Accessor accessor;
+  accessor.bufferView = view;
+  accessor.componentType = component_type;
+  accessor.type = type;
+  accessor.count = count;
+
+  model.accessors.push_back(accessor);
+  return model.accessors.size() - 1;
+}
+
+// A skinned grid of side * side vertices bound to a chain of joint_count joints
+static std::vector<uint8_t> BuildSyntheticGLB(int32_t side, int32_t joint_count) {
+  tinygltf::Model model;
+  model.buffers.emplace_back();
+
+  size_t vertex_count = side * side;
+
+  std::vector<glm::vec3> positions(vertex_count);
+  std::vector<glm::vec3> normals(vertex_count, glm::vec3(0.0, 1.0, 0.0));
+  std::vector<glm::vec2> texcoords(vertex_count);
+  std::vector<glm::u8vec4> joints(vertex_count);
+  std::vector<glm::vec4> weights(vertex_count, glm::vec4(0.5, 0.5, 0.0, 0.0));
+
+  for (int32_t z = 0; z < side; ++z) {
+    for (int32_t x = 0; x < side; ++x) {
+      size_t i = z * side + x;
+      positions[i] = glm::vec3(x, 0.0, z);
+      texcoords[i] = glm::vec2(float(x) / side, float(z) / side);
+
+      uint8_t joint = (z * joint_count) / side;
+      joints[i] = glm::u8vec4(joint, std::min(joint + 1, joint_count - 1), 0, 0);
+    }
+  }
+
+  std::vector<uint32_t> indices;
+  indices.reserve((side - 1) * (side - 1) * 6);
+  for (int32_t z = 0; z < side - 1; ++z) {
+    for (int32_t x = 0; x < side - 1; ++x) {
+      uint32_t i = z * side + x;
+      indices.insert(indices.end(), { i, i + side, i + 1, i + 1, i + side, i + side + 1 });
+    }
+  }
+
+  std::vector<glm::mat4> inverse_bind_matrices(joint_count, glm::mat4(1.0));
+
+  tinygltf::Primitive primitive;
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  primitive.attributes["POSITION"] = AppendAccessor(
+    model, AppendView(model, positions, TINYGLTF_TARGET_ARRAY_BUFFER), 
+    TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, vertex_count
+  );
+  primitive.attributes["NORMAL"] = AppendAccessor(
+    model, AppendView(model, normals, TINYGLTF_TARGET_ARRAY_BUFFER), 
+    TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, vertex_count
+  );
+  primitive.attributes["TEXCOORD_0"] = AppendAccessor(
+    model, AppendView(model, texcoords, TINYGLTF_TARGET_ARRAY_BUFFER), 
+    TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, vertex_count
+  );
+  primitive.attributes["JOINTS_0"] = AppendAccessor(
+    model, AppendView(model, joints, TINYGLTF_TARGET_ARRAY_BUFFER), 
+    TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, TINYGLTF_TYPE_VEC4, vertex_count
+  );
+  primitive.attributes["WEIGHTS_0"] = AppendAccessor(
+    model, AppendView(model, weights, TINYGLTF_TARGET_ARRAY_BUFFER), 
+    TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC4, vertex_count
+  );
+  primitive.indices = AppendAccessor(
+    model, AppendView(model, indices, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER), 
+    TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT, TINYGLTF_TYPE_SCALAR, indices.size()
+  );
+
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+
+  tinygltf::Skin skin;
+  skin.inverseBindMatrices = AppendAccessor(
+    model, AppendView(model, inverse_bind_matrices, 0), 
+    TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_MAT4, joint_count
+  );
+
+  tinygltf::Node mesh_node;
+  mesh_node.mesh = 0;
+  mesh_node.skin = 0;
+  model.nodes.push_back(mesh_node);
+
+  for (int32_t i = 0; i < joint_count; ++i) {
+    tinygltf::Node joint;
+    joint.translation = { 0.0, 0.0, double(side) / joint_count };
+    if (i + 1 < joint_count) {
+      joint.children.push_back(model.nodes.size() + 1);
+    }
+    skin.joints.push_back(model.nodes.size());
+    model.nodes.push_back(joint);
+  }
+  model.skins.push_back(skin);
+
+  tinygltf::Scene scene;
+  scene.nodes = { 0, 1 };
+  model.scenes.push_back(scene);
+  model.defaultScene = 0;
+
+  std::ostringstream stream;
+  tinygltf::TinyGLTF writer;
+  writer.WriteGltfSceneToStream(&model, stream, false, true);
+
+  std::string bytes = stream.str();
+  return std::vector<uint8_t>(bytes.cbegin(), bytes.cend());
+}
+
+// Runs kIterations decodes and keeps the fastest, which is the least noisy
+// figure to compare between builds. load(result, stats) does the decode.
+template <typename F>
+static bool Measure(F&& load, LinearArena& scratch, DecodeStats& best) {
+  bool measured = false;
+  for (int32_t i = 0; i < kIterations; ++i) {
+    scratch.Reset();
+
+    ModelData result;
+    DecodeStats stats;
+    if (!load(result, stats)) {
+      return false;
+    }
+
+    auto image_start = std::chrono::steady_clock::now();
+    ImageDecodeQueue decode_queue(result);
+    DecodedImage image;
+    while (decode_queue.WaitNext(image)) {
+      ImageDecodeQueue::Free(image);
+    }
+    stats.image_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - image_start).count();
+    if (!measured || stats.TotalMs() < best.TotalMs()) {
+      best = stats;
+      measured = true;
+    }
+  }
+  return true;
+}
+
+static void Report(const std::string& name, const DecodeStats& stats, bool csv) {
+  double megabytes = double(stats.source_bytes_) / (1024.0 * 1024.0);
+  double throughput = megabytes / (stats.TotalMs() / 1000.0);
+
+  if (csv) {
+    std::cout 
+      << name << "," << stats.source_bytes_ << "," << stats.vertex_count_ << ","
+      << stats.parse_ms_ << "," << stats.decompress_ms_ << "," << stats.accessor_ms_ << "," << stats.vertex_ms_ << "," 
+      << stats.skin_ms_ << "," << stats.image_ms_ << "," << stats.TotalMs() << "," << throughput << std::endl;
+    return;
+  }
+
+  std::cout << std::fixed << std::setprecision(3)
+    << std::left << std::setw(24) << name << std::right
+    << std::setw(10) << megabytes
+    << std::setw(10) << stats.vertex_count_
+    << std::setw(10) << stats.parse_ms_
+    << std::setw(10) << stats.decompress_ms_
+    << std::setw(10) << stats.accessor_ms_
+    << std::setw(10) << stats.vertex_ms_
+    << std::setw(10) << stats.skin_ms_
+    << std::setw(10) << stats.image_ms_
+    << std::setw(10) << stats.TotalMs()
+    << std::setw(10) << throughput << std::endl;
+}
+
+int main(int argc, char** argv) {
+  bool csv = false;
+  std::vector<std::string> files;
+  for (int32_t i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else {
+      files.emplace_back(argv[i]);
+    }
+  }
+
+  if (csv) {
+    std::cout << "case,bytes,vertices,parse_ms,decompress_ms,accessor_ms,vertex_ms,skin_ms,image_ms,total_ms,mb_per_s" << std::endl;
+  } else {
+    std::cout 
+      << std::left << std::setw(24) << "case" << std::right
+      << std::setw(10) << "MB" << std::setw(10) << "verts"
+      << std::setw(10) << "parse" << std::setw(10) << "meshopt" << std::setw(10) << "accessor"
+      << std::setw(10) << "vertex" << std::setw(10) << "skin" << std::setw(10) << "image"
+      << std::setw(10) << "total" << std::setw(10) << "MB/s" << std::endl;
+  }
+
+  if (files.empty()) {
+    files.emplace_back("../assets/testcube.glb");
+  }
+
+  LinearArena scratch("benchmark scratch", 64 << 20);
+  int32_t failures = 0;
+
+  constexpr int32_t kSides[] = { 32, 128, 512, 1024 };
+  for (int32_t side : kSides) {
+    std::vector<uint8_t> glb = BuildSyntheticGLB(side, 64);
+
+    DecodeStats stats;
+    auto load = [&](ModelData& result, DecodeStats& load_stats) {
+      return AssetDecoder::LoadFromMemory(glb.data(), glb.size(), result, &load_stats, &scratch);
+    };
+    std::string name = "synthetic_" + std::to_string(side * side);
+    if (!Measure(load, scratch, stats)) {
+      std::cerr << "Unable to load " << name << std::endl;
+      ++failures;
+      continue;
+    }
+    Report(name, stats, csv);
+  }
+
+  // Through the mapped file, the way the engine loads
+  for (const std::string& file : files) {
+    DecodeStats stats;
+    auto load = [&](ModelData& result, DecodeStats& load_stats) {
+      return AssetDecoder::LoadFromFile(file, result, &load_stats, &scratch);
+    };
+    if (!Measure(load, scratch, stats)) {
+      std::cerr << "Unable to load " << file << std::endl;
+      ++failures;
+      continue;
+    }
+    Report(file, stats, csv);
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <string>
+
+#include "OcclusionCuller.h"
+
+// The software occlusion culler against a known scene: a camera at the
+// origin looking down -z and one square occluder facing it. Boxes in front
+// of, behind, beside and half behind the square are tested, on the calling
+// thread and on a worker pool. Exits nonzero if any answer is wrong.
+
+struct Case {
+  const char* name_;
+  Aabb bounds_;
+  bool visible_;
+};
+
+static Aabb Box(glm::vec3 center, float half_size) {
+  return Aabb { center - glm::vec3(half_size), center + glm::vec3(half_size) };
+}
+
+static bool RunCases(const char* label, WorkerPool* pool) {
+  OcclusionCuller culler;
+  culler.Create(256, 128, pool);
+
+  glm::mat4 view_projection = glm::perspective(glm::radians(60.f), 2.f, 0.1f, 100.f);
+
+  // Six units across at z = -10, counter-clockwise as seen from the camera
+  OccluderMesh square;
+  square.local_transform_ = glm::mat4(1.0f);
+  square.positions_ = {
+    glm::vec3(-3.0f, -3.0f, -10.0f),
+    glm::vec3(3.0f, -3.0f, -10.0f),
+    glm::vec3(3.0f, 3.0f, -10.0f),
+    glm::vec3(-3.0f, 3.0f, -10.0f),
+  };
+  square.indices_ = { 0, 1, 2, 0, 2, 3 };
+
+  culler.BeginFrame(view_projection);
+  culler.AddOccluder(square, glm::mat4(1.0f));
+  culler.Rasterize();
+
+  // At z = -20 the square covers x and y in [-6, 6]
+  const Case cases[] = {
+    { "in front", Box(glm::vec3(0.0f, 0.0f, -5.0f), 0.5f), true },
+    { "behind", Box(glm::vec3(0.0f, 0.0f, -20.0f), 0.5f), false },
+    { "beside", Box(glm::vec3(12.0f, 0.0f, -20.0f), 0.5f), true },
+    { "half behind", Box(glm::vec3(6.0f, 0.0f, -20.0f), 0.5f), true },
+    { "outside the frustum", Box(glm::vec3(0.0f, 0.0f, 10.0f), 0.5f), false },
+  };
+
+  bool passed = true;
+  for (const Case& test : cases) {
+    bool visible = culler.IsVisible(test.bounds_, view_projection);
+    bool correct = visible == test.visible_;
+    passed &= correct;
+    std::cout
+      << (correct ? "[pass] " : "[FAIL] ") << label << ", " << test.name_ << ": "
+      << (visible ? "visible" : "hidden") << " (expected " << (test.visible_ ? "visible" : "hidden") << ")"
+      << std::endl;
+  }
+
+  const OcclusionStats& stats = culler.GetStats();
+  bool counted = stats.occluder_triangles_ == 2 && stats.occlusion_culled_ == 1 && stats.frustum_culled_ == 1;
+  passed &= counted;
+  std::cout
+    << (counted ? "[pass] " : "[FAIL] ") << label << ", stats: "
+    << stats.occluder_triangles_ << " occluder triangles (expected 2), "
+    << stats.occlusion_culled_ << " occlusion culled (1), "
+    << stats.frustum_culled_ << " frustum culled (1)" << std::endl;
+
+  culler.Destroy();
+  return passed;
+}
+
+int main() {
+  bool passed = RunCases("calling thread", nullptr);
+
+  WorkerPool pool;
+  pool.Create(3);
+  passed &= RunCases("worker pool", &pool);
+  pool.Destroy();
+
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#include <iostream>
+#include <string>
+
+#include "RenderGraph.h"
+
+// Culling and aliasing of the render graph, checked without a window. Only
+// Compile runs, and a graph that was never allocated makes no GL calls in
+// it. Exits nonzero if any case disagrees with what it expects.
+
+struct Expected {
+  size_t pass_count_;
+  size_t culled_count_;
+  size_t transient_count_;
+  size_t allocation_count_;
+};
+
+static bool Check(const std::string& name, const RenderGraphStats& stats, const Expected& expected) {
+  bool passed =
+    stats.pass_count_ == expected.pass_count_ &&
+    stats.culled_count_ == expected.culled_count_ &&
+    stats.transient_count_ == expected.transient_count_ &&
+    stats.allocation_count_ == expected.allocation_count_;
+
+  std::cout
+    << (passed ? "[pass] " : "[FAIL] ") << name << ": "
+    << stats.pass_count_ << " passes (expected " << expected.pass_count_ << "), "
+    << stats.culled_count_ << " culled (" << expected.culled_count_ << "), "
+    << stats.transient_count_ << " transients (" << expected.transient_count_ << "), "
+    << stats.allocation_count_ << " allocations (" << expected.allocation_count_ << ")" << std::endl;
+  return passed;
+}
+
+static void Nothing(const RenderPassContext&) {
+}
+
+// first -> resolve -> second -> present, plus a pass nothing reads. The two
+// transients share a desc and are never alive at once, so they share an
+// allocation. With overlap set, present also reads the first one.
+static RenderGraphStats CompileChain(bool overlap) {
+  RenderTextureDesc desc;
+  desc.format_ = RenderFormat::kRGBA16F;
+
+  RenderGraph graph;
+  RenderResource first = graph.CreateTexture("first", desc);
+  RenderResource second = graph.CreateTexture("second", desc);
+  RenderResource unused = graph.CreateTexture("unused", desc);
+  RenderResource chain = graph.ImportBuffer("chain", 1);
+  RenderResource backbuffer = graph.ImportBackbuffer();
+
+  {
+    RenderPassBuilder pass = graph.AddPass("first", Nothing);
+    first = pass.Write(first, LoadOp::kClear);
+  }
+  {
+    RenderPassBuilder pass = graph.AddPass("resolve", Nothing);
+    pass.Read(first);
+    chain = pass.Write(chain, LoadOp::kDontCare);
+  }
+  {
+    RenderPassBuilder pass = graph.AddPass("second", Nothing);
+    pass.Read(chain);
+    second = pass.Write(second, LoadOp::kClear);
+  }
+  {
+    RenderPassBuilder pass = graph.AddPass("dead", Nothing);
+    pass.Read(second);
+    unused = pass.Write(unused, LoadOp::kClear);
+  }
+  {
+    RenderPassBuilder pass = graph.AddPass("present", Nothing);
+    pass.Read(second);
+    if (overlap) {
+      pass.Read(first);
+    }
+    pass.Write(backbuffer, LoadOp::kDontCare);
+  }
+
+  graph.Compile();
+  graph.Report();
+  return graph.GetStats();
+}
+
+int main() {
+  bool passed = true;
+  passed &= Check("disjoint lifetimes", CompileChain(false), Expected { 4, 1, 2, 1 });
+  passed &= Check("overlapping lifetimes", CompileChain(true), Expected { 4, 1, 2, 2 });
+  return passed ? 0 : 1;
+}
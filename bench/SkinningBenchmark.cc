@@ -0,0 +1,227 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+
+#include "App.h"
+#include "GLExtensions.h"
+#include "Graphics.h"
+#include "Resources.h"
+#include "SkinCache.h"
+#include "SkinPalette.h"
+#include "UniformRing.h"
+
+// GPU cost of drawing skinned instances over several passes, skinning in
+// the vertex shader of every pass versus skinning once into SkinCache and
+// drawing every pass with the static shader. All instances share one pose.
+// Pass a GLB path to replace the robot, --csv for one line per case.
+
+constexpr int32_t kWarmupFrames = 30;
+constexpr int32_t kFrames = 200;
+constexpr int32_t kInstances = 64;
+constexpr int32_t kPassCounts[] = { 1, 2, 4, 8 };
+
+struct Result {
+  double frame_ms_;
+  uint64_t skins_;
+};
+
+static void SetBindings(const Shader& shader, bool skinned) {
+  shader.Enable();
+  shader.SetUniformInt(shader.GetUniformLocation("texture0"), 0);
+  shader.Disable();
+
+  shader.SetUniformBlockBinding("FrameUniforms", kFrameUniformBinding);
+  shader.SetUniformBlockBinding("DrawUniforms", kDrawUniformBinding);
+  if (skinned) {
+    shader.SetUniformBlockBinding("SkinUniforms", kSkinUniformBinding);
+  }
+}
+
+static Result Run(
+  App& app,
+  UniformRing& uniform_ring,
+  SkinCache& skin_cache,
+  ModelHandle model_handle,
+  const Shader& shader,
+  bool cached,
+  int32_t passes
+) {
+  const Model& model = *Resources::Get(model_handle);
+
+  std::vector<uint32_t> queries(kFrames);
+  glGenQueries(kFrames, queries.data());
+
+  uint64_t skins = 0;
+  int32_t measured_frames = 0;
+
+  for (int32_t frame = 0; frame < kWarmupFrames + kFrames && app.Update(); ++frame) {
+    app.BeginFrame();
+    Graphics::ClearColor(Color { 195, 195, 195, 255 });
+
+    uniform_ring.BeginFrame();
+    skin_cache.BeginFrame();
+
+    FrameUniforms frame_uniforms;
+    frame_uniforms.skinning_ = SkinningMode::kLinear;
+    frame_uniforms.view_projection_ =
+      glm::perspective(glm::radians(90.f), 16.f / 9.f, 0.01f, 100.f) *
+      glm::lookAt(glm::vec3(0.0, 4.0, 10.0), glm::vec3(0.0), glm::vec3(0.0, 1.0, 0.0));
+    size_t frame_offset = uniform_ring.Push(frame_uniforms);
+
+    // Bind pose, the cost doesn't depend on the joint values
+    std::vector<glm::mat4> joints(kMaxBones, glm::mat4(1.0));
+    std::vector<glm::vec4> palette(kMaxBones * 3);
+    SkinPalette::Pack(SkinningMode::kLinear, joints.data(), kMaxBones, palette.data());
+    size_t skin_offset = uniform_ring.Push(palette.data(), palette.size() * sizeof(glm::vec4));
+
+    std::vector<size_t> draw_offsets;
+    for (int32_t instance = 0; instance < kInstances; ++instance) {
+      glm::mat4 instance_model = glm::translate(glm::mat4(1.0),
+        glm::vec3((instance % 8) * 1.5 - 5.25, -1.0, (instance / 8) * -1.5));
+      for (const Mesh& mesh : model.GetMeshes()) {
+        for (const MeshPrimitive& primitive : mesh.mesh_primitives_) {
+          Material material = primitive.material_.value_or(Material {});
+
+          DrawUniforms draw_uniforms;
+          draw_uniforms.model_ = instance_model * mesh.local_transform_;
+          draw_uniforms.base_color_ = material.color_;
+          draw_uniforms.uv_rect_ = material.uv_rect_;
+          draw_uniforms.layer_ = -1;
+          draw_offsets.push_back(uniform_ring.Push(draw_uniforms));
+        }
+      }
+    }
+
+    uniform_ring.Flush();
+    uniform_ring.Bind(kFrameUniformBinding, frame_offset, sizeof(FrameUniforms));
+    uniform_ring.Bind(kSkinUniformBinding, skin_offset, kSkinUniformsSize);
+
+    bool measured = frame >= kWarmupFrames;
+    if (measured) {
+      glBeginQuery(GL_TIME_ELAPSED, queries[frame - kWarmupFrames]);
+    }
+
+    if (cached) {
+      for (const Mesh& mesh : model.GetMeshes()) {
+        for (const MeshPrimitive& primitive : mesh.mesh_primitives_) {
+          skin_cache.Skin(0, primitive.primitive_);
+        }
+      }
+    }
+
+    shader.Enable();
+    for (int32_t pass = 0; pass < passes; ++pass) {
+      size_t draw = 0;
+      for (int32_t instance = 0; instance < kInstances; ++instance) {
+        for (const Mesh& mesh : model.GetMeshes()) {
+          for (const MeshPrimitive& primitive : mesh.mesh_primitives_) {
+            uniform_ring.Bind(kDrawUniformBinding, draw_offsets[draw++], sizeof(DrawUniforms));
+            if (cached) {
+              Graphics::RenderSkinned(skin_cache.Skin(0, primitive.primitive_));
+            } else {
+              Graphics::RenderPrimitiveIndexed(*Resources::Get(primitive.primitive_));
+            }
+          }
+        }
+      }
+    }
+    shader.Disable();
+
+    if (measured) {
+      glEndQuery(GL_TIME_ELAPSED);
+      skins += skin_cache.GetSkinCount();
+      ++measured_frames;
+    }
+
+    uniform_ring.EndFrame();
+    app.EndFrame();
+    Resources::EndFrame();
+  }
+
+  // Blocks until the last frame has finished on the GPU
+  uint64_t total_ns = 0;
+  for (int32_t i = 0; i < measured_frames; ++i) {
+    uint64_t elapsed = 0;
+    glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+    total_ns += elapsed;
+  }
+  glDeleteQueries(kFrames, queries.data());
+
+  if (measured_frames == 0) {
+    return Result { 0.0, 0 };
+  }
+  return Result { double(total_ns) / 1e6 / measured_frames, skins / measured_frames };
+}
+
+int main(int argc, char** argv) {
+  bool csv = false;
+  const char* model_path = "../assets/robot.glb";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else {
+      model_path = argv[i];
+    }
+  }
+
+  App app(1280, 720, "Skinning Benchmark");
+  app.SetSwapMode(SwapMode::kImmediate);
+
+  // Draws are untextured, only the skinning differs
+  ShaderHandle shader_handle = Resources::LoadShader("../shaders/model.glsl", kFeatureSkinned);
+  ShaderHandle static_shader_handle = Resources::LoadShader("../shaders/model.glsl");
+  ModelHandle model_handle = Resources::LoadModel(model_path);
+
+  SetBindings(*Resources::Get(shader_handle), true);
+  SetBindings(*Resources::Get(static_shader_handle), false);
+
+  UniformRing uniform_ring;
+  uniform_ring.Create(1 << 22);
+
+  SkinCache skin_cache;
+  skin_cache.Create("../shaders/skin.glsl");
+
+  if (csv) {
+    std::cout << "passes,mode,frame_ms,pass_ms,skins" << std::endl;
+  } else {
+    std::cout << kInstances << " instances, " << kFrames << " frames per case" << std::endl;
+    std::cout
+      << std::setw(8) << "passes"
+      << std::setw(12) << "mode"
+      << std::setw(12) << "frame ms"
+      << std::setw(12) << "pass ms"
+      << std::setw(8) << "skins" << std::endl;
+  }
+
+  for (int32_t passes : kPassCounts) {
+    for (bool cached : { false, true }) {
+      const Shader& shader = *Resources::Get(cached ? static_shader_handle : shader_handle);
+      Result result = Run(app, uniform_ring, skin_cache, model_handle, shader, cached, passes);
+
+      const char* mode = cached ? "cached" : "in-shader";
+      double pass_ms = result.frame_ms_ / passes;
+      if (csv) {
+        std::cout
+          << passes << "," << mode << "," << result.frame_ms_ << ","
+          << pass_ms << "," << result.skins_ << std::endl;
+      } else {
+        std::cout
+          << std::setw(8) << passes
+          << std::setw(12) << mode
+          << std::setw(12) << std::fixed << std::setprecision(3) << result.frame_ms_
+          << std::setw(12) << pass_ms
+          << std::setw(8) << result.skins_ << std::endl;
+      }
+    }
+  }
+
+  skin_cache.Destroy();
+  uniform_ring.Destroy();
+  Resources::Shutdown();
+
+  return 0;
+}
@@ -3,11 +3,26 @@
 #include <glm/common.hpp>
 
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
 
 #include "App.h"
+#include "AllocationTracker.h"
+#include "CommandList.h"
+#include "DynamicResolution.h"
 #include "Graphics.h"
+#include "RenderGraph.h"
+#include "Resources.h"
+#include "Scene.h"
+#include "Simulation.h"
+#include "SkinCache.h"
+#include "UniformRing.h"
+#include "WorkerPool.h"
 
-void ProcessRoot(std::vector<glm::mat4>& transforms, Joint root, glm::mat4 parent) {
+void ProcessRoot(ArenaVector<glm::mat4>& transforms, const Joint& root, glm::mat4 parent) {
   glm::mat4 global = parent * root.transform_;
   transforms.emplace_back(global);
   for (const Joint& child : root.children_) {
@@ -15,118 +30,487 @@ void ProcessRoot(std::vector<glm::mat4>& transforms, Joint root, glm::mat4 paren
   }
 }
 
-int main(void) {
+// The skin cache hands the shaders vertices that are already skinned
+static uint32_t DrawFeatures(const MeshPrimitive& primitive, bool use_skin_cache) {
+  return use_skin_cache ? primitive.features_ & ~kFeatureSkinned : primitive.features_;
+}
+
+// The whole argument has to be a finite number inside [min, max]
+static bool ParseFloat(const char* text, float min, float max, float& value) {
+  char* end = nullptr;
+  float parsed = std::strtof(text, &end);
+  if (end == text || *end != '\0' || !std::isfinite(parsed) || parsed < min || parsed > max) {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
+int main(int argc, char** argv) {
 
   App app(1600, 1480, "Graphics");
+  app.SetSwapMode(SwapMode::kVsync);
+  app.SetPacingMode(PacingMode::kLowLatency);
 
   Color better_white = { 195, 195, 195, 255 };
 
-  Shader shader;
-  shader.LoadShader("../shaders/model.glsl");
-
-  Model cube;
-  cube.Load("../assets/robot.glb");
+  ShaderVariants model_shaders;
+  model_shaders.Create("../shaders/model.glsl");
+  ShaderVariants depth_shaders;
+  depth_shaders.Create("../shaders/depth.glsl");
+  ModelHandle cube_handle = Resources::LoadModel("../assets/robot.glb", true);
 
   InputManager& input = app.GetInputManager();
-  input.AddAction(Key::kKeyEscape, "Quit");
-  input.AddAction(Key::kKey6, "Quit");
+  constexpr ActionId kQuit = HashAction("Quit");
+
+  input.AddAction(Key::kKeyEscape, kQuit);
+  input.AddAction(Key::kKey6, kQuit);
 
-  input.RegisterInputs();
+  Controller controller;
+  controller.forward_ = HashAction("MoveForward");
+  controller.back_ = HashAction("MoveBack");
+  controller.left_ = HashAction("MoveLeft");
+  controller.right_ = HashAction("MoveRight");
+  controller.speed_ = 1.5f;
 
-  float dt = 1.f / 60.f;
-  float accumulator = 0.f;
+  input.AddAction(Key::kKeyW, controller.forward_);
+  input.AddAction(Key::kKeyS, controller.back_);
+  input.AddAction(Key::kKeyA, controller.left_);
+  input.AddAction(Key::kKeyD, controller.right_);
+
+  model_shaders.SetSampler("texture0", 0);
+  model_shaders.SetUniformBlockBinding("FrameUniforms", kFrameUniformBinding);
+  model_shaders.SetUniformBlockBinding("DrawUniforms", kDrawUniformBinding);
+  model_shaders.SetUniformBlockBinding("SkinUniforms", kSkinUniformBinding);
+
+  depth_shaders.SetUniformBlockBinding("FrameUniforms", kFrameUniformBinding);
+  depth_shaders.SetUniformBlockBinding("DrawUniforms", kDrawUniformBinding);
+  depth_shaders.SetUniformBlockBinding("SkinUniforms", kSkinUniformBinding);
+
+  ShaderHandle upscale_shader = Resources::LoadShader("../shaders/upscale.glsl");
+  {
+    const Shader& shader = *Resources::Get(upscale_shader);
+    shader.Enable();
+    shader.SetUniformInt(shader.GetUniformLocation("u_source"), 0);
+    shader.Disable();
+  }
+  int32_t source_rect_location = Resources::Get(upscale_shader)->GetUniformLocation("u_sourceRect");
+  int32_t sharpness_location = Resources::Get(upscale_shader)->GetUniformLocation("u_sharpness");
+  float sharpness = 0.5f;
 
-  int32_t u_model = shader.GetUniformLocation("u_Model");
-  int32_t u_vp = shader.GetUniformLocation("u_ViewProjection");  
-  int32_t u_texture0 = shader.GetUniformLocation("texture0");
-  int32_t u_base_color = shader.GetUniformLocation("u_baseColor");
+  // The scene is drawn at whatever scale keeps GPU time inside one refresh
+  DynamicResolutionSettings resolution_settings;
+  resolution_settings.budget_ms_ = float(app.GetFramePacer().GetFramePeriodMs());
+  bool dynamic_resolution = true;
 
-  shader.Enable();
-  shader.SetUniformInt(u_texture0, 0);
-  shader.Disable();
+  SkinCache skin_cache;
+  skin_cache.Create("../shaders/skin.glsl");
+  bool use_skin_cache = true;
+  bool depth_prepass = true;
+
+  UniformRing uniform_ring;
+  uniform_ring.Create(1 << 20);
+
+  // Shared by the world queries, occlusion and command recording. The
+  // simulation thread keeps a core of its own.
+  WorkerPool workers;
+  workers.Create(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+  OcclusionCuller occlusion;
+  occlusion.Create(256, 128, &workers);
+
+  OcclusionStats occlusion_totals;
+  size_t frame_count = 0;
+
+  World world;
+  world.Create(&workers);
+
+  Transform robot_transform;
+  robot_transform.position_ = glm::vec3(0.0, -1, 0.0);
+  Entity robot = world.CreateEntity(robot_transform, WorldMatrix {}, Renderable { cube_handle }, SkeletonPose { 0 }, controller);
 
-  glm::mat4 model(1.0);
   glm::mat4 view(1.0);
   glm::mat4 projection(1.0);
 
-  std::vector<int32_t> u_bind_pose;
-  std::vector<glm::mat4> bind_poses;
-  
-  for (int i = 0; i < 100; ++i) {
-    std::string uniform = "u_Joints[" + std::to_string(i) + "]";
-    u_bind_pose.push_back(shader.GetUniformLocation(uniform.c_str()));
-  }
+  FrameUniforms frame_uniforms;
+  frame_uniforms.skinning_ = SkinningMode::kLinear;
 
+  glm::mat4 joints[kMaxBones];
+  int32_t joint_count = 0;
       
-  for (const Skin& skin : cube.GetSkins()) {
-    std::vector<glm::mat4> bone_transforms;
+  for (const Skin& skin : Resources::Get(cube_handle)->GetSkins()) {
+    ArenaVector<glm::mat4> bone_transforms { &app.GetFrameArena() };
     ProcessRoot(bone_transforms, skin.root_, glm::mat4(1.0));
-    for (int i = 0; i < skin.inverse_bind_matrices_.size(); ++i) {            
-      bind_poses.push_back(bone_transforms[i] * skin.inverse_bind_matrices_[i]);
+    for (size_t i = 0; i < skin.inverse_bind_matrices_.size() && joint_count < kMaxBones; ++i) {            
+      joints[joint_count++] = bone_transforms[i] * skin.inverse_bind_matrices_[i];
     }
   }
-    
-  while (app.Update()) {        
-    float frame_time = app.GetDeltaTime();
-    accumulator += frame_time;
-    
-    while (accumulator >= dt) {      
-      if (input.IsActionDown("Quit")) {
-        app.CloseWindow();
-      }          
 
-      float t = app.GetTime();
-      float x = cosf(t) * 1.5;
-      float z = sinf(t) * 1.5;
+  double dt = 1.0 / 60.0;
+
+  // Arenas, rings and caches settle over the first frames, every frame
+  // after that is expected to stay off the heap
+  constexpr size_t kAllocationWarmupFrames = 8;
+
+  // Recording and replaying tick the simulation on frame deltas instead of
+  // the wall clock, so a replay reproduces every tick and its input
+  SimulationClock simulation_clock = SimulationClock::kThread;
 
-      model = glm::translate(glm::mat4(1.0), glm::vec3(0.0, -1, 0.0));
-      // model = glm::rotate(model, glm::radians(90.f),glm::vec3(1.0,0.0,0.0));
-      // model = glm::scale(model, glm::vec3(0.05));
-      view = glm::lookAt(glm::vec3(x, 0.0, z), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
+  for (int32_t i = 1; i + 1 < argc; ++i) {
+    if (std::strcmp(argv[i], "--record") == 0) {
+      if (app.StartRecording(argv[i + 1], dt)) {
+        simulation_clock = SimulationClock::kFrame;
+      }
+    } else if (std::strcmp(argv[i], "--replay") == 0 && app.StartReplay(argv[i + 1])) {
+      dt = app.GetReplayTimeStep();
+      simulation_clock = SimulationClock::kFrame;
+    } else if (std::strcmp(argv[i], "--skinning") == 0 && std::strcmp(argv[i + 1], "dq") == 0) {
+      frame_uniforms.skinning_ = SkinningMode::kDualQuaternion;
+    } else if (std::strcmp(argv[i], "--skin-cache") == 0 && std::strcmp(argv[i + 1], "off") == 0) {
+      use_skin_cache = false;
+    } else if (std::strcmp(argv[i], "--prepass") == 0 && std::strcmp(argv[i + 1], "off") == 0) {
+      depth_prepass = false;
+    } else if (std::strcmp(argv[i], "--dynamic-resolution") == 0 && std::strcmp(argv[i + 1], "off") == 0) {
+      dynamic_resolution = false;
+    } else if (std::strcmp(argv[i], "--gpu-budget") == 0) {
+      // The controller divides by the budget, anything but a positive number
+      // keeps the frame period
+      float budget_ms = 0.0f;
+      if (ParseFloat(argv[i + 1], 0.0f, INFINITY, budget_ms) && budget_ms > 0.0f) {
+        resolution_settings.budget_ms_ = budget_ms;
+      } else {
+        std::cout << "Ignoring --gpu-budget " << argv[i + 1] << ", expected milliseconds above 0" << std::endl;
+      }
+    } else if (std::strcmp(argv[i], "--min-scale") == 0) {
+      if (!ParseFloat(argv[i + 1], 0.25f, 1.0f, resolution_settings.min_scale_)) {
+        std::cout << "Ignoring --min-scale " << argv[i + 1] << ", expected a number from 0.25 to 1" << std::endl;
+      }
+    } else if (std::strcmp(argv[i], "--sharpness") == 0) {
+      if (!ParseFloat(argv[i + 1], 0.0f, 1.0f, sharpness)) {
+        std::cout << "Ignoring --sharpness " << argv[i + 1] << ", expected a number from 0 to 1" << std::endl;
+      }
+    } else if (std::strcmp(argv[i], "--alloc-check") == 0) {
+      if (std::strcmp(argv[i + 1], "abort") == 0) {
+        AllocationTracker::SetSteadyStateMode(SteadyStateMode::kAbort);
+      } else if (std::strcmp(argv[i + 1], "count") == 0) {
+        AllocationTracker::SetSteadyStateMode(SteadyStateMode::kCount);
+      }
+    }
+  }
+
+  // Every variant a loaded primitive can be drawn with is compiled up
+  // front, the recording threads can only look them up
+  for (const Model& model : Resources::GetModels()) {
+    for (const Mesh& mesh : model.GetMeshes()) {
+      for (const MeshPrimitive& primitive : mesh.mesh_primitives_) {
+        uint32_t features = DrawFeatures(primitive, use_skin_cache);
+        model_shaders.Require(features);
+        depth_shaders.Require(features & kFeatureSkinned);
+      }
+    }
+  }
+
+  DynamicResolution resolution;
+  resolution.Create(resolution_settings);
+  resolution.SetEnabled(dynamic_resolution);
 
-      int32_t width = app.GetScreenWidth();
-      int32_t height = app.GetScreenHeight();
+  struct Draw {
+    const Model* model_;
+    const MeshPrimitive* primitive_;
+    uint32_t pose_;
+    glm::mat4 model_matrix_;
+    // Null when the skin cache is off or the primitive isn't skinned
+    const SkinnedPrimitive* skinned_;
+    uint32_t features_;
+  };
 
-      if (height == 0) height = 1;
+  // Built once, the passes reach each frame's draws through frame_draws
+  const ArenaVector<Draw>* frame_draws = nullptr;
+
+  // Each part records its slice of the draws for both passes
+  CommandRecorder recorder;
+  recorder.Create(&workers);
+  std::vector<CommandList> depth_lists(recorder.GetPartCount());
+  std::vector<CommandList> forward_lists(recorder.GetPartCount());
+
+  RenderGraph render_graph;
+  render_graph.Create();
+
+  RenderResource backbuffer = render_graph.ImportBackbuffer();
+  RenderResource skinned = render_graph.ImportBuffer("skinned vertices", 0);
+  // Allocated at window size, drawn at the render scale
+  RenderResource scene_color = render_graph.CreateTexture("scene color", RenderTextureDesc { RenderFormat::kRGBA8, 1.0f, 0, 0, true });
+  RenderResource scene_depth = render_graph.CreateTexture("scene depth", RenderTextureDesc { RenderFormat::kDepth24, 1.0f, 0, 0, true });
+
+  // Every skinned primitive is skinned up front, any later pass over the
+  // same draws reuses the buffers without touching the palette again
+  if (use_skin_cache) {
+    RenderPassBuilder pass = render_graph.AddPass("skin", [&](const RenderPassContext&) {
+      for (const Draw& draw : *frame_draws) {
+        if (draw.skinned_ != nullptr) {
+          skin_cache.Skin(draw.pose_, draw.primitive_->primitive_);
+        }
+      }
+    });
+    skinned = pass.Write(skinned, LoadOp::kDontCare);
+  }
+
+  // Lays down depth from the position stream alone, so the main pass
+  // shades each pixel once
+  if (depth_prepass) {
+    RenderPassBuilder pass = render_graph.AddPass("depth prepass", [&](const RenderPassContext&) {
+      // The lists bind each draw's variant
+      Graphics::BeginDepthPrepass();
+      CommandList::Replay(depth_lists.data(), depth_lists.size());
+      Graphics::EndDepthPrepass();
+    });
+    pass.Read(skinned);
+    scene_depth = pass.Write(scene_depth, LoadOp::kClear);
+  }
+
+  {
+    RenderPassBuilder pass = render_graph.AddPass("forward", [&](const RenderPassContext&) {
+      // Program and array binds that repeat the bound one are dropped by the replay
+      CommandList::Replay(forward_lists.data(), forward_lists.size());
+
+      if (depth_prepass) {
+        Graphics::ResetDepthState();
+      }
+    });
+    pass.Read(skinned);
+    pass.SetClearColor(better_white);
+    scene_color = pass.Write(scene_color, LoadOp::kClear);
+    scene_depth = pass.Write(scene_depth, depth_prepass ? LoadOp::kLoad : LoadOp::kClear);
+  }
+
+  if (dynamic_resolution) {
+    RenderPassBuilder pass = render_graph.AddPass("upscale", [&, scene_color](const RenderPassContext& context) {
+      int32_t drawn_width = 0;
+      int32_t drawn_height = 0;
+      int32_t texture_width = 0;
+      int32_t texture_height = 0;
+      context.GetDrawnSize(scene_color, drawn_width, drawn_height);
+      context.GetTextureSize(scene_color, texture_width, texture_height);
+
+      const Shader& shader = *Resources::Get(upscale_shader);
+      shader.Enable();
+      shader.SetUniformVec4(source_rect_location, glm::vec4(
+        float(drawn_width) / float(texture_width), float(drawn_height) / float(texture_height),
+        1.0f / float(texture_width), 1.0f / float(texture_height)));
+      shader.SetUniformFloat(sharpness_location, sharpness);
+      context.BindTexture(scene_color, 0);
+      context.DrawFullscreen();
+      shader.Disable();
+    });
+    pass.Read(scene_color);
+    pass.Write(backbuffer, LoadOp::kDontCare);
+  } else {
+    RenderPassBuilder pass = render_graph.AddPass("present", [scene_color](const RenderPassContext& context) {
+      context.Blit(scene_color);
+    });
+    pass.Read(scene_color);
+    pass.Write(backbuffer, LoadOp::kDontCare);
+  }
+
+  render_graph.Compile();
+
+  // Gameplay runs at the fixed step, the robot's Transform only mirrors it
+  Simulation simulation(dt, [controller, yaw = robot_transform.yaw_](WorldState& state, const InputManager& input, double time, double dt) {
+    float x = cosf(time) * 1.5;
+    float z = sinf(time) * 1.5;
+
+    state.camera_position_ = glm::vec3(x, 0.0, z);
+    state.player_position_ += Scene::MoveController(controller, input, yaw, float(dt));
+  });
+
+  simulation.Start(WorldState { glm::vec3(1.5, 0.0, 0.0), robot_transform.position_ }, simulation_clock);
     
-      projection = glm::perspective(glm::radians(90.f), float(width) / float(height), 0.01f, 100.f);
-      
-      accumulator -= dt;
+  while (true) {
+    // Opened first so input polling and replay are held to it as well
+    AllocationScope frame_scope("frame", frame_count >= kAllocationWarmupFrames);
+    if (!app.Update()) {
+      break;
+    }
+
+    if (input.IsActionDown(kQuit)) {
+      app.CloseWindow();
     }
 
+    simulation.Advance(app.GetDeltaTime(), input);
+    WorldState state = simulation.Sample();
+
+    world.Get<Transform>(robot)->position_ = state.player_position_;
+    Scene::UpdateWorldMatrices(world);
+
+    view = glm::lookAt(state.camera_position_, glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
+
+    int32_t width = app.GetScreenWidth();
+    int32_t height = app.GetScreenHeight();
+
+    if (height == 0) height = 1;
+  
+    projection = glm::perspective(glm::radians(90.f), float(width) / float(height), 0.01f, 100.f);
+
     app.BeginFrame();
-    
-    Graphics::ClearColor(better_white);
 
-    shader.Enable();
+    // Everything the frame needs is written to the ring first so the
+    // unsynchronized mapping can be released before any draw reads it
+    uniform_ring.BeginFrame();
+    skin_cache.BeginFrame();
 
-    shader.SetUniformMatrix(u_vp, projection * view);
+    frame_uniforms.view_projection_ = projection * view;
+    size_t frame_offset = uniform_ring.Push(frame_uniforms);
 
-    for (int32_t i = 0; i < bind_poses.size(); ++i) {
-      shader.SetUniformMatrix(u_bind_pose[i], bind_poses[i]);
-    }
+    // The whole palette is converted in one pass and only the bones in use
+    // are copied, the binding still covers the block's full size
+    size_t palette_size = joint_count * SkinPalette::GetVec4sPerBone(frame_uniforms.skinning_);
+    ArenaVector<glm::vec4> palette { &app.GetFrameArena() };
+    palette.resize(palette_size);
+    SkinPalette::Pack(frame_uniforms.skinning_, joints, joint_count, palette.data());
+    size_t skin_offset = uniform_ring.Push(palette.data(), palette_size * sizeof(glm::vec4), kSkinUniformsSize);
 
-    for (const Mesh& mesh : cube.GetMeshes()) {
-      shader.SetUniformMatrix(u_model, model * mesh.local_transform_);
-      for (const MeshPrimitive& primitive : mesh.mesh_primitives_) {
-        if (primitive.material_) {
-          const Material& material = primitive.material_.value();
-          if (material.has_texture_) {
-            Texture(material.texture_id_).Bind(0);
+    occlusion.BeginFrame(frame_uniforms.view_projection_);
+    world.Each<WorldMatrix, Renderable>([&](const WorldMatrix& matrix, const Renderable& renderable) {
+      for (const OccluderMesh& occluder : Resources::Get(renderable.model_)->GetOccluders()) {
+        occlusion.AddOccluder(occluder, matrix.value_);
+      }
+    });
+    occlusion.Rasterize();
+
+    ArenaVector<Draw> draws { &app.GetFrameArena() };
+
+    world.Each<WorldMatrix, Renderable, SkeletonPose>([&](const WorldMatrix& matrix, const Renderable& renderable, const SkeletonPose& pose) {
+      const Model& model = *Resources::Get(renderable.model_);
+      for (const Mesh& mesh : model.GetMeshes()) {
+        glm::mat4 mesh_model = matrix.value_ * mesh.local_transform_;
+        for (const MeshPrimitive& primitive : mesh.mesh_primitives_) {
+          if (!occlusion.IsVisible(primitive.bounds_, frame_uniforms.view_projection_ * mesh_model)) {
+            continue;
+          }
+
+          const SkinnedPrimitive* skinned = nullptr;
+          if (use_skin_cache && (primitive.features_ & kFeatureSkinned)) {
+            skinned = &skin_cache.Prepare(pose.pose_, primitive.primitive_);
           }
-          shader.SetUniformVec4(u_base_color, material.color_);
-        }        
-        Graphics::RenderPrimitiveIndexed(primitive.primitive_);
-        Texture(0).Unbind();
+          draws.push_back(Draw { &model, &primitive, pose.pose_, mesh_model, skinned, DrawFeatures(primitive, use_skin_cache) });
+        }
       }
-    }
-    
-    shader.Disable();
+    });
+
+    // Draw uniforms and both passes' commands are built in parallel slices,
+    // the GL thread only replays them
+    size_t draw_stride = uniform_ring.GetStride(sizeof(DrawUniforms));
+    size_t draw_base = uniform_ring.Reserve(sizeof(DrawUniforms), draws.size());
+    uint32_t ring_buffer = uniform_ring.GetBuffer();
+
+    recorder.Record(draws.size(), [&](uint32_t part, size_t begin, size_t end) {
+      CommandList& depth_list = depth_lists[part];
+      CommandList& forward_list = forward_lists[part];
+      depth_list.Reset();
+      forward_list.Reset();
+
+      for (size_t i = begin; i < end; ++i) {
+        const Draw& draw = draws[i];
+        Material material = draw.primitive_->material_.value_or(Material {});
+
+        DrawUniforms draw_uniforms;
+        draw_uniforms.model_ = draw.model_matrix_;
+        draw_uniforms.base_color_ = material.color_;
+        draw_uniforms.uv_rect_ = material.uv_rect_;
+        draw_uniforms.layer_ = material.array_ >= 0 ? material.layer_ : -1;
+
+        size_t offset = draw_base + i * draw_stride;
+        uniform_ring.Write(offset, &draw_uniforms, sizeof(DrawUniforms));
+
+        const Primitive& source = *Resources::Get(draw.primitive_->primitive_);
+        if (depth_prepass) {
+          depth_list.BindProgram(depth_shaders.Get(draw.features_ & kFeatureSkinned));
+          depth_list.BindUniformRange(kDrawUniformBinding, ring_buffer, offset, sizeof(DrawUniforms));
+          if (draw.skinned_ != nullptr) {
+            depth_list.DrawDepth(*draw.skinned_);
+          } else {
+            depth_list.DrawDepth(source);
+          }
+        }
+
+        forward_list.BindProgram(model_shaders.Get(draw.features_));
+        if (draw.features_ & kFeatureTextured) {
+          forward_list.BindTextureArray(0, *Resources::Get(draw.model_->GetTextures()[material.array_]));
+        }
+        forward_list.BindUniformRange(kDrawUniformBinding, ring_buffer, offset, sizeof(DrawUniforms));
+        if (draw.skinned_ != nullptr) {
+          forward_list.Draw(*draw.skinned_);
+        } else {
+          forward_list.Draw(source);
+        }
+      }
+    });
+
+    const OcclusionStats& stats = occlusion.GetStats();
+    occlusion_totals.tested_ += stats.tested_;
+    occlusion_totals.frustum_culled_ += stats.frustum_culled_;
+    occlusion_totals.occlusion_culled_ += stats.occlusion_culled_;
+    occlusion_totals.bin_ms_ += stats.bin_ms_;
+    occlusion_totals.raster_ms_ += stats.raster_ms_;
+    ++frame_count;
+
+    uniform_ring.Flush();
+
+    uniform_ring.Bind(kFrameUniformBinding, frame_offset, sizeof(FrameUniforms));
+    uniform_ring.Bind(kSkinUniformBinding, skin_offset, kSkinUniformsSize);
+
+    // Timed from the first GPU work of the frame to the last, the scale it
+    // picks shows up a few frames later
+    frame_draws = &draws;
+    resolution.BeginFrame();
+    render_graph.SetRenderScale(resolution.GetScale());
+    render_graph.Execute(width, height);
+    resolution.EndFrame();
+
+    uniform_ring.EndFrame();
     
     app.EndFrame();    
+
+    Resources::EndFrame();
+    skin_cache.Collect();
   }
   
-  shader.UnloadShader();
+  simulation.Stop();
+  app.StopRecording();
+
+  if (frame_count > 0) {
+    std::cout 
+      << "[occlusion] " << occlusion_totals.tested_ << " tested, " 
+      << occlusion_totals.frustum_culled_ << " frustum culled, " 
+      << occlusion_totals.occlusion_culled_ << " occlusion culled, " 
+      << occlusion_totals.bin_ms_ / frame_count << " ms binning and "
+      << occlusion_totals.raster_ms_ / frame_count << " ms raster per frame" << std::endl;
+
+    const FramePacer& pacer = app.GetFramePacer();
+    std::cout
+      << "[latency] input to present " << pacer.GetLatencyMs() << " ms average, "
+      << pacer.GetMaxLatencyMs() << " ms worst, " << pacer.GetWorkMs() << " ms work"
+      << (pacer.GetMode() == PacingMode::kLowLatency ? ", low latency pacing" : "") << std::endl;
+  }
+  render_graph.Report();
+  resolution.Report();
+
+  occlusion.Destroy();
+  world.Destroy();
+  recorder.Destroy();
+  workers.Destroy();
+  render_graph.Destroy();
+  resolution.Destroy();
+  skin_cache.Destroy();
+  model_shaders.Destroy();
+  depth_shaders.Destroy();
+
+  app.GetFrameArena().Report();
+  Model::GetScratchArena().Report();
+  AllocationTracker::Report();
+
+  uniform_ring.Destroy();
+  Resources::Shutdown();
   
   return 0;
 }
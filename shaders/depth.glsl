@@ -0,0 +1,35 @@
+#version 330 core
+// Depth prepass for shaders/model.glsl, the position math of each variant
+// has to stay identical. Only SKINNED changes anything here, and both take
+// its skinning from shaders/skinning.glsl.
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform FrameUniforms {
+    mat4 u_ViewProjection;
+    int u_skinning;
+};
+
+layout (std140) uniform DrawUniforms {
+    mat4 u_Model;
+    vec4 u_baseColor;
+    // Scale in xy and offset in zw into the layer, atlased textures clamp
+    vec4 u_uvRect;
+    // -1 when the material has no texture
+    int u_layer;
+};
+
+invariant gl_Position;
+
+void main() {
+#ifdef SKINNED
+    vec3 skinnedPos = u_skinning == SKINNING_DUAL_QUATERNION ? SkinDualQuaternion(aPos) : SkinLinear(aPos);
+    gl_Position = u_ViewProjection * u_Model * vec4(skinnedPos, 1.0);
+#else
+    gl_Position = u_ViewProjection * u_Model * vec4(aPos, 1.0);
+#endif
+}
+#SPLIT
+#version 330 core
+
+void main() {
+}
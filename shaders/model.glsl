@@ -1,59 +1,78 @@
 #version 330 core
+// Variants: SKINNED skins with the palette in SkinUniforms, through
+// shaders/skinning.glsl, otherwise the vertices are drawn as they are,
+// static or already skinned by SkinCache.
+// TEXTURED samples the material's layer of texture0.
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 layout (location = 2) in vec3 aNormal;
-layout (location = 3) in ivec4 aJoints;
-layout (location = 4) in vec4 aWeights;
-
-const int MAX_BONES = 100;
-const int MAX_BONE_INFLUENCE = 4;
 
+#ifdef TEXTURED
 out vec2 fragTexCoords;
+#endif
 
-uniform mat4 u_Model;
-uniform mat4 u_ViewProjection;
+layout (std140) uniform FrameUniforms {
+    mat4 u_ViewProjection;
+    int u_skinning;
+};
 
-uniform mat4 u_Joints[MAX_BONES];
+layout (std140) uniform DrawUniforms {
+    mat4 u_Model;
+    vec4 u_baseColor;
+    // Scale in xy and offset in zw into the layer, atlased textures clamp
+    vec4 u_uvRect;
+    // -1 when the material has no texture
+    int u_layer;
+};
 
 out vec3 fragNormal;
 
+// Must match the same variant of shaders/depth.glsl bit for bit, the main
+// pass tests GL_EQUAL
+invariant gl_Position;
+
 void main() {
     fragNormal = aNormal;
+#ifdef TEXTURED
     fragTexCoords = aTexCoords;
+#endif
 
-    // vec4 totalLocalPos = vec4(0.0);
-
-    // vec4 vertexPos = vec4(aPos, 1.0);
-    // for (int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
-    //     mat4 jointTransform = u_Joints[aJoints[i]];
-    //     vec4 posePosition = jointTransform * vertexPos;
-    //     totalLocalPos += posePosition * aWeights[i];
-    // }
-    
-    mat4 skinMat = aWeights.x * u_Joints[aJoints.x] + 
-                   aWeights.y * u_Joints[aJoints.y] +    
-                   aWeights.z * u_Joints[aJoints.z] +
-                   aWeights.w * u_Joints[aJoints.w];
-
-    vec4 worldPos = skinMat * vec4(aPos, 1.0);
-                    
-    gl_Position = u_ViewProjection * u_Model * worldPos;
+#ifdef SKINNED
+    vec3 skinnedPos = u_skinning == SKINNING_DUAL_QUATERNION ? SkinDualQuaternion(aPos) : SkinLinear(aPos);
+    gl_Position = u_ViewProjection * u_Model * vec4(skinnedPos, 1.0);
+#else
+    gl_Position = u_ViewProjection * u_Model * vec4(aPos, 1.0);
+#endif
 }
 #SPLIT
 #version 330 core
 out vec4 fragColor;
 
-in vec2 fragTexCoords;
 in vec3 fragNormal;
 
-uniform sampler2D texture0;
-uniform vec4 u_baseColor;
+layout (std140) uniform DrawUniforms {
+    mat4 u_Model;
+    vec4 u_baseColor;
+    vec4 u_uvRect;
+    int u_layer;
+};
+
+#ifdef TEXTURED
+in vec2 fragTexCoords;
+
+uniform sampler2DArray texture0;
+#endif
 
 void main() {
-    vec4 textureColor = texture(texture0, fragTexCoords);    
-    if (textureColor.xyz != vec3(0.0)) {
-        fragColor = textureColor * u_baseColor;
-    } else {
-        fragColor = u_baseColor;
+#ifdef TEXTURED
+    vec2 uv = fragTexCoords;
+    if (u_uvRect.xy != vec2(1.0)) {
+        uv = clamp(uv, vec2(0.0), vec2(1.0));
     }
+    uv = uv * u_uvRect.xy + u_uvRect.zw;
+
+    fragColor = texture(texture0, vec3(uv, float(u_layer))) * u_baseColor;
+#else
+    fragColor = u_baseColor;
+#endif
 }
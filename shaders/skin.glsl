@@ -0,0 +1,28 @@
+#version 330 core
+// Vertex stage only, loaded SKINNED for shaders/skinning.glsl. Run with
+// GL_RASTERIZER_DISCARD, skinnedPos and skinnedNormal are captured into
+// transform feedback bindings 0 and 1.
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec3 aNormal;
+
+layout (std140) uniform FrameUniforms {
+    mat4 u_ViewProjection;
+    int u_skinning;
+};
+
+out vec3 skinnedPos;
+out vec3 skinnedNormal;
+
+void main() {
+    if (u_skinning == SKINNING_DUAL_QUATERNION) {
+        vec4 real;
+        vec4 dual;
+        BlendDualQuaternions(real, dual);
+        skinnedPos = Rotate(real, aPos) + DualQuaternionTranslation(real, dual);
+        skinnedNormal = Rotate(real, aNormal);
+    } else {
+        mat3x4 skinRows = BlendBoneRows();
+        skinnedPos = vec4(aPos, 1.0) * skinRows;
+        skinnedNormal = normalize(vec4(aNormal, 0.0) * skinRows);
+    }
+}
@@ -0,0 +1,69 @@
+// Skinning shared by every skinned vertex stage. Shader::LoadShader puts
+// this after the defines of SKINNED variants, LoadFeedbackShader when asked
+// for SKINNED, so there is no #version here and it must not be loaded on
+// its own. SkinPalette.h matches the constants and the SkinUniforms layout.
+layout (location = 3) in ivec4 aJoints;
+layout (location = 4) in vec4 aWeights;
+
+const int MAX_BONES = 100;
+const int MAX_BONE_INFLUENCE = 4;
+
+const int SKINNING_LINEAR = 0;
+const int SKINNING_DUAL_QUATERNION = 1;
+
+// Linear: three rows of an affine matrix per bone.
+// Dual quaternion: real then dual part per bone, the rest is unused.
+layout (std140) uniform SkinUniforms {
+    vec4 u_Bones[MAX_BONES * 3];
+};
+
+mat3x4 BoneRows(int bone) {
+    return mat3x4(u_Bones[bone * 3], u_Bones[bone * 3 + 1], u_Bones[bone * 3 + 2]);
+}
+
+// Transforms with vec4(v, 1.0) * rows for points, vec4(v, 0.0) for normals
+mat3x4 BlendBoneRows() {
+    return aWeights.x * BoneRows(aJoints.x) +
+           aWeights.y * BoneRows(aJoints.y) +
+           aWeights.z * BoneRows(aJoints.z) +
+           aWeights.w * BoneRows(aJoints.w);
+}
+
+// Normalized, the real part rotates and the dual part holds the translation
+void BlendDualQuaternions(out vec4 real, out vec4 dual) {
+    vec4 real0 = u_Bones[aJoints.x * 2];
+
+    real = vec4(0.0);
+    dual = vec4(0.0);
+    for (int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+        vec4 r = u_Bones[aJoints[i] * 2];
+        vec4 d = u_Bones[aJoints[i] * 2 + 1];
+        // q and -q are the same rotation, blend along the shorter arc
+        float weight = dot(real0, r) < 0.0 ? -aWeights[i] : aWeights[i];
+        real += weight * r;
+        dual += weight * d;
+    }
+
+    float len = length(real);
+    real /= len;
+    dual /= len;
+}
+
+vec3 Rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+vec3 DualQuaternionTranslation(vec4 real, vec4 dual) {
+    return 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+}
+
+vec3 SkinLinear(vec3 pos) {
+    return vec4(pos, 1.0) * BlendBoneRows();
+}
+
+vec3 SkinDualQuaternion(vec3 pos) {
+    vec4 real;
+    vec4 dual;
+    BlendDualQuaternions(real, dual);
+    return Rotate(real, pos) + DualQuaternionTranslation(real, dual);
+}
@@ -0,0 +1,50 @@
+#version 330 core
+// One triangle covering the screen, corners come from gl_VertexID
+out vec2 fragUv;
+
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    fragUv = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+#SPLIT
+#version 330 core
+// Stretches the part of the source drawn this frame over the target and
+// sharpens it, contrast adaptive in the style of AMD's CAS: the negative
+// lobe shrinks where the neighbourhood is already close to black or white,
+// so edges don't ring.
+out vec4 fragColor;
+
+in vec2 fragUv;
+
+uniform sampler2D u_source;
+// Drawn size in xy and one texel in zw, both in uv
+uniform vec4 u_sourceRect;
+// 0 to 1
+uniform float u_sharpness;
+
+vec3 Tap(vec2 uv) {
+    // Bilinear taps stay half a texel inside what was drawn this frame
+    vec2 texel = u_sourceRect.zw;
+    return texture(u_source, clamp(uv, 0.5 * texel, u_sourceRect.xy - 0.5 * texel)).rgb;
+}
+
+void main() {
+    vec2 texel = u_sourceRect.zw;
+    vec2 uv = fragUv * u_sourceRect.xy;
+
+    vec3 center = Tap(uv);
+    vec3 north = Tap(uv + vec2(0.0, texel.y));
+    vec3 south = Tap(uv - vec2(0.0, texel.y));
+    vec3 east = Tap(uv + vec2(texel.x, 0.0));
+    vec3 west = Tap(uv - vec2(texel.x, 0.0));
+
+    vec3 low = min(center, min(min(north, south), min(east, west)));
+    vec3 high = max(center, max(max(north, south), max(east, west)));
+
+    vec3 amplitude = sqrt(clamp(min(low, 1.0 - high) / max(high, vec3(1.0e-4)), 0.0, 1.0));
+    vec3 weight = -amplitude / mix(8.0, 5.0, u_sharpness);
+
+    vec3 color = (center + weight * (north + south + east + west)) / (1.0 + 4.0 * weight);
+    fragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}